@@ -0,0 +1,250 @@
+// Mixes synthetic looping voices of every supported sample format at several
+// sample rates with `audioEngineMix`, without audio output, and reports mixer
+// throughput and 99th percentile of mix call duration (from the same
+// statistics audio engine logs on exit).
+//
+// Every mixed call is checked against straightforward per-frame reference mix
+// (linear interpolation at 16.16 fixed point, voices summed, then clamped to
+// 16-bit), which catches errors in block splitting, voice limit and SIMD
+// packing. The benchmark also fails when not every requested voice could be
+// created.
+
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+#include <SDL.h>
+
+#include "audio_engine.h"
+
+namespace fallout {
+
+// Normally defined by the game loop, mixer outputs silence when inactive.
+bool gProgramIsActive = true;
+
+} // namespace fallout
+
+using namespace fallout;
+
+// Number of mix calls and output frames per call (device buffer size).
+#define BENCHMARK_MIX_CALLS 400
+#define BENCHMARK_MIX_FRAMES 1024
+
+typedef struct VoiceFormat {
+    int bitsPerSample;
+    int channels;
+} VoiceFormat;
+
+static const VoiceFormat kFormats[] = {
+    { 8, 1 },
+    { 8, 2 },
+    { 16, 1 },
+    { 16, 2 },
+};
+
+static const int kRates[] = {
+    11025,
+    22050,
+    44100,
+};
+
+static const int kVoices[] = {
+    1,
+    2,
+    4,
+    8,
+    16,
+    32,
+    64,
+};
+
+typedef struct Voice {
+    int soundBuffer;
+    int bitsPerSample;
+    int channels;
+    std::vector<unsigned char> data;
+    unsigned int frameCount;
+    unsigned int step;
+
+    // Position of reference mix.
+    unsigned int frame;
+    unsigned int frac;
+} Voice;
+
+// Creates looping sound buffer with one second of triangle wave. Data is kept
+// in `voice` for reference mix.
+static bool createVoice(const VoiceFormat& format, int rate, int index, Voice* voice)
+{
+    unsigned int size = rate * format.channels * (format.bitsPerSample / 8);
+    int soundBuffer = audioEngineCreateSoundBuffer(size, format.bitsPerSample, format.channels, rate);
+    if (soundBuffer == -1) {
+        return false;
+    }
+
+    voice->soundBuffer = soundBuffer;
+    voice->bitsPerSample = format.bitsPerSample;
+    voice->channels = format.channels;
+    voice->data.resize(size);
+    voice->frameCount = rate;
+    voice->frame = 0;
+    voice->frac = 0;
+
+    int period = 50 + index * 7;
+    int samples = size / (format.bitsPerSample / 8);
+    for (int sample = 0; sample < samples; sample++) {
+        int phase = (sample / format.channels) % period;
+        int value = (phase < period / 2 ? phase : period - phase) * 2 * 32767 / period - 16384;
+        if (format.bitsPerSample == 16) {
+            reinterpret_cast<Sint16*>(voice->data.data())[sample] = static_cast<Sint16>(value);
+        } else {
+            reinterpret_cast<Sint8*>(voice->data.data())[sample] = static_cast<Sint8>(value >> 8);
+        }
+    }
+
+    void* audioPtr;
+    unsigned int audioBytes;
+    audioEngineSoundBufferLock(soundBuffer, 0, size, &audioPtr, &audioBytes, nullptr, nullptr, AUDIO_ENGINE_SOUND_BUFFER_LOCK_ENTIRE_BUFFER);
+    memcpy(audioPtr, voice->data.data(), audioBytes);
+    audioEngineSoundBufferUnlock(soundBuffer, audioPtr, audioBytes, nullptr, 0);
+    audioEngineSoundBufferPlay(soundBuffer, AUDIO_ENGINE_SOUND_BUFFER_PLAY_LOOPING);
+
+    return true;
+}
+
+// Reads frame as 16-bit stereo.
+static void readFrame(const Voice& voice, unsigned int frame, int* left, int* right)
+{
+    if (voice.bitsPerSample == 16) {
+        const Sint16* samples = reinterpret_cast<const Sint16*>(voice.data.data()) + frame * voice.channels;
+        *left = samples[0];
+        *right = samples[voice.channels - 1];
+    } else {
+        const Sint8* samples = reinterpret_cast<const Sint8*>(voice.data.data()) + frame * voice.channels;
+        *left = samples[0] * 256;
+        *right = samples[voice.channels - 1] * 256;
+    }
+}
+
+// Mixes `frames` frames of looping voices at full volume one output frame at a
+// time and returns number of samples which differ from `output`.
+static int referenceMix(std::vector<Voice>& voices, const Sint16* output, int frames)
+{
+    int mismatches = 0;
+    for (int index = 0; index < frames; index++) {
+        int left = 0;
+        int right = 0;
+        for (Voice& voice : voices) {
+            unsigned int next = (voice.frame + 1) % voice.frameCount;
+
+            int left0;
+            int right0;
+            readFrame(voice, voice.frame, &left0, &right0);
+
+            int left1;
+            int right1;
+            readFrame(voice, next, &left1, &right1);
+
+            left += left0 + static_cast<int>((static_cast<long long>(left1 - left0) * voice.frac) >> 16);
+            right += right0 + static_cast<int>((static_cast<long long>(right1 - right0) * voice.frac) >> 16);
+
+            voice.frac += voice.step;
+            voice.frame = (voice.frame + (voice.frac >> 16)) % voice.frameCount;
+            voice.frac &= 0xFFFF;
+        }
+
+        if (output[index * 2] != std::min(std::max(left, -32768), 32767)) {
+            mismatches++;
+        }
+
+        if (output[index * 2 + 1] != std::min(std::max(right, -32768), 32767)) {
+            mismatches++;
+        }
+    }
+    return mismatches;
+}
+
+int main(int argc, char* argv[])
+{
+    SDL_SetHint(SDL_HINT_AUDIODRIVER, "dummy");
+    if (SDL_InitSubSystem(SDL_INIT_AUDIO) != 0) {
+        fprintf(stderr, "SDL_InitSubSystem failed: %s\n", SDL_GetError());
+        return 1;
+    }
+
+    if (!audioEngineInit()) {
+        fprintf(stderr, "audioEngineInit failed: %s\n", SDL_GetError());
+        return 1;
+    }
+
+    // Mixer is driven by the benchmark instead of audio device.
+    audioEnginePause();
+    audioEngineSetVoiceLimit(kVoices[sizeof(kVoices) / sizeof(kVoices[0]) - 1]);
+
+    static Sint16 output[BENCHMARK_MIX_FRAMES * 2];
+
+    AudioEngineMixStats stats;
+    audioEngineGetMixStats(&stats);
+    int outputRate = stats.rate;
+
+    int failures = 0;
+
+    printf("%-6s %-8s %-6s %-6s %16s %10s\n", "bits", "channels", "rate", "voices", "Msamples/CPU s", "p99 us");
+
+    for (const VoiceFormat& format : kFormats) {
+        for (int rate : kRates) {
+            for (int voicesLength : kVoices) {
+                std::vector<Voice> voices(voicesLength);
+                int createdVoices = 0;
+                while (createdVoices < voicesLength) {
+                    Voice* voice = &(voices[createdVoices]);
+                    if (!createVoice(format, rate, createdVoices, voice)) {
+                        break;
+                    }
+                    voice->step = static_cast<unsigned int>((static_cast<unsigned long long>(rate) << 16) / outputRate);
+                    createdVoices++;
+                }
+                voices.resize(createdVoices);
+
+                audioEngineResetMixStats();
+
+                int mismatches = 0;
+                for (int call = 0; call < BENCHMARK_MIX_CALLS; call++) {
+                    audioEngineMix(reinterpret_cast<unsigned char*>(output), sizeof(output));
+                    mismatches += referenceMix(voices, output, BENCHMARK_MIX_FRAMES);
+                }
+
+                audioEngineGetMixStats(&stats);
+
+                // Source samples consumed by all voices.
+                double samples = static_cast<double>(stats.frames) * rate / stats.rate * format.channels * createdVoices;
+                double seconds = stats.time / 1000000.0;
+
+                bool passed = createdVoices == voicesLength && mismatches == 0;
+
+                printf("%-6d %-8d %-6d %-6d %16.1f %10u%s\n",
+                    format.bitsPerSample,
+                    format.channels,
+                    rate,
+                    createdVoices,
+                    seconds > 0 ? samples / seconds / 1000000.0 : 0.0,
+                    stats.p99Time,
+                    passed ? "" : "  MISMATCH");
+
+                if (!passed) {
+                    failures++;
+                }
+
+                for (const Voice& voice : voices) {
+                    audioEngineSoundBufferRelease(voice.soundBuffer);
+                }
+            }
+        }
+    }
+
+    audioEngineExit();
+    SDL_QuitSubSystem(SDL_INIT_AUDIO);
+
+    return failures != 0 ? 1 : 0;
+}
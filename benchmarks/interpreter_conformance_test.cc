@@ -0,0 +1,409 @@
+// Runs random bytecode programs with `_interpret` and checks interpreter state
+// after every burst (instruction pointer, flags, frame pointers and top of
+// both stacks) together with reported errors against checksum produced by the
+// original interpreter.
+//
+// Programs mix pushes, arithmetic, logic, comparisons, jumps and conditional
+// jumps into arbitrary addresses (including addresses inside instructions),
+// invalid and undefined opcodes. Two instances of every program are
+// interleaved with random burst sizes.
+//
+// Game side of the interpreter (file system, exported variables, script
+// library) is replaced with stubs below.
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "db.h"
+#include "debug.h"
+#include "export.h"
+#include "input.h"
+#include "interpreter.h"
+#include "interpreter_lib.h"
+#include "sfall_global_scripts.h"
+
+#define CONFORMANCE_PROGRAMS 2000
+#define CONFORMANCE_STEPS 3000
+#define CONFORMANCE_STACK_VALUES 8
+
+// Checksum is FNV-1a hash of traces produced by the interpreter as of 4fa4157
+// (before pre-decoded instruction stream).
+#define CONFORMANCE_CHECKSUM 0x6c5f818ee94f8619ULL
+
+namespace fallout {
+
+static std::string gTrace;
+static const std::vector<unsigned char>* gProgramData;
+
+int debugPrint(const char* format, ...)
+{
+    // Load-time verification reports are not part of execution trace.
+    if (strstr(format, "Script verification") != nullptr) {
+        return 0;
+    }
+
+    char string[1024];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(string, sizeof(string), format, args);
+    va_end(args);
+
+    gTrace += string;
+
+    return length;
+}
+
+unsigned int getTicks()
+{
+    return 0;
+}
+
+File* fileOpen(const char* filePath, const char* mode)
+{
+    return reinterpret_cast<File*>(const_cast<std::vector<unsigned char>*>(gProgramData));
+}
+
+int fileGetSize(File* stream)
+{
+    return static_cast<int>(gProgramData->size());
+}
+
+size_t fileRead(void* buf, size_t size, size_t count, File* stream)
+{
+    memcpy(buf, gProgramData->data(), size * count);
+    return count;
+}
+
+int fileClose(File* stream)
+{
+    return 0;
+}
+
+void intLibInit()
+{
+}
+
+void intLibExit()
+{
+}
+
+void intLibUpdate()
+{
+}
+
+void intLibRemoveProgramReferences(Program* program)
+{
+}
+
+void _initExport()
+{
+}
+
+void externalVariablesClear()
+{
+}
+
+int externalVariableCreate(Program* program, const char* identifier)
+{
+    return 0;
+}
+
+int externalVariableGetValue(Program* program, const char* name, ProgramValue& value)
+{
+    return -1;
+}
+
+int externalVariableSetValue(Program* program, const char* identifier, ProgramValue& value)
+{
+    return -1;
+}
+
+int externalProcedureCreate(Program* program, const char* identifier, int address, int argumentCount)
+{
+    return 0;
+}
+
+Program* externalProcedureGetProgram(const char* identifier, int* addressPtr, int* argumentCountPtr)
+{
+    return nullptr;
+}
+
+void sfall_gl_scr_update(int burstSize)
+{
+}
+
+} // namespace fallout
+
+using namespace fallout;
+
+// Offsets in program header.
+#define PROGRAM_PROCEDURES_OFFSET 42
+#define PROGRAM_PROCEDURE_SIZE 24
+
+static const opcode_t kBinaryOpcodes[] = {
+    OPCODE_EQUAL,
+    OPCODE_NOT_EQUAL,
+    OPCODE_LESS_THAN_EQUAL,
+    OPCODE_GREATER_THAN_EQUAL,
+    OPCODE_LESS_THAN,
+    OPCODE_GREATER_THAN,
+    OPCODE_ADD,
+    OPCODE_SUB,
+    OPCODE_MUL,
+    OPCODE_DIV,
+    OPCODE_MOD,
+    OPCODE_AND,
+    OPCODE_OR,
+    OPCODE_BITWISE_AND,
+    OPCODE_BITWISE_OR,
+    OPCODE_BITWISE_XOR,
+};
+
+static const opcode_t kUnaryOpcodes[] = {
+    OPCODE_BITWISE_NOT,
+    OPCODE_FLOOR,
+    OPCODE_NOT,
+    OPCODE_NEGATE,
+    OPCODE_SWAP,
+    OPCODE_POP,
+    OPCODE_DUP,
+    OPCODE_NOOP,
+    OPCODE_END_CRITICAL,
+    OPCODE_LEAVE_CRITICAL_SECTION,
+    OPCODE_NOOP,
+    OPCODE_NOOP,
+};
+
+static unsigned int gSeed = 1;
+
+static unsigned int nextRandom()
+{
+    gSeed = gSeed * 1103515245 + 12345;
+    return (gSeed >> 16) & 0x7FFF;
+}
+
+static void writeInt16(std::vector<unsigned char>& data, int value)
+{
+    data.push_back((value >> 8) & 0xFF);
+    data.push_back(value & 0xFF);
+}
+
+static void writeInt32(std::vector<unsigned char>& data, int value)
+{
+    writeInt16(data, (value >> 16) & 0xFFFF);
+    writeInt16(data, value & 0xFFFF);
+}
+
+static void putInt32(std::vector<unsigned char>& data, size_t pos, int value)
+{
+    data[pos] = (value >> 24) & 0xFF;
+    data[pos + 1] = (value >> 16) & 0xFF;
+    data[pos + 2] = (value >> 8) & 0xFF;
+    data[pos + 3] = value & 0xFF;
+}
+
+static void writePush(std::vector<unsigned char>& data, opcode_t opcode, int value)
+{
+    writeInt16(data, opcode);
+    writeInt32(data, value);
+}
+
+// Builds program with a bootstrap jump to random code followed by procedure
+// table (procedures point into code), identifiers with one name, empty static
+// strings and the code itself.
+static std::vector<unsigned char> buildProgram()
+{
+    int proceduresLength = nextRandom() % 4;
+    size_t codeStart = PROGRAM_PROCEDURES_OFFSET + 4 + PROGRAM_PROCEDURE_SIZE * proceduresLength + 4 + 8 + 4;
+
+    std::vector<unsigned char> code;
+    std::vector<size_t> jumpOperands;
+    std::vector<size_t> procedureOffsets;
+    std::vector<size_t> targets;
+
+    size_t codeLength = 20 + nextRandom() % 400;
+    while (code.size() < codeLength) {
+        if (proceduresLength != 0 && nextRandom() % 60 == 0 && procedureOffsets.size() < static_cast<size_t>(proceduresLength)) {
+            procedureOffsets.push_back(code.size());
+        }
+
+        targets.push_back(code.size());
+
+        int kind = nextRandom() % 100;
+        if (kind < 30) {
+            // Some jumps land inside push operands.
+            if (nextRandom() % 4 == 0) {
+                targets.push_back(code.size() + 2 + nextRandom() % 4);
+            }
+            writePush(code, VALUE_TYPE_INT, nextRandom() % 26);
+        } else if (kind < 34) {
+            float value = static_cast<float>(static_cast<int>(nextRandom() % 200) - 100) / 8.0f;
+            int bits;
+            memcpy(&bits, &value, sizeof(bits));
+            writePush(code, VALUE_TYPE_FLOAT, bits);
+        } else if (kind < 52) {
+            writeInt16(code, kBinaryOpcodes[nextRandom() % 16]);
+        } else if (kind < 62) {
+            writeInt16(code, kUnaryOpcodes[nextRandom() % 12]);
+        } else if (kind < 70) {
+            jumpOperands.push_back(code.size() + 2);
+            writePush(code, VALUE_TYPE_INT, 0);
+            writeInt16(code, OPCODE_JUMP);
+        } else if (kind < 80) {
+            jumpOperands.push_back(code.size() + 2);
+            writePush(code, VALUE_TYPE_INT, 0);
+            writePush(code, VALUE_TYPE_INT, nextRandom() % 2);
+            writeInt16(code, nextRandom() % 2 != 0 ? OPCODE_IF : OPCODE_WHILE);
+        } else if (kind < 85) {
+            writeInt16(code, OPCODE_EXIT_PROGRAM);
+        } else if (kind < 86) {
+            // Bad (high bit not set) or undefined opcode.
+            writeInt16(code, nextRandom() % 2 != 0 ? nextRandom() & 0x7FFF : 0x8000 | (0x200 + nextRandom() % 0x100));
+        } else {
+            writePush(code, VALUE_TYPE_INT, nextRandom() % 6);
+        }
+    }
+
+    for (size_t pos : jumpOperands) {
+        putInt32(code, pos, static_cast<int>(codeStart + targets[nextRandom() % targets.size()]));
+    }
+
+    for (int index = 0; index < 4; index++) {
+        writeInt16(code, OPCODE_EXIT_PROGRAM);
+    }
+
+    std::vector<unsigned char> data;
+    writePush(data, VALUE_TYPE_INT, static_cast<int>(codeStart));
+    writeInt16(data, OPCODE_JUMP);
+    data.resize(PROGRAM_PROCEDURES_OFFSET, 0);
+
+    writeInt32(data, proceduresLength);
+    for (int index = 0; index < proceduresLength; index++) {
+        size_t offset = index < static_cast<int>(procedureOffsets.size()) ? procedureOffsets[index] : nextRandom() % code.size();
+        writeInt32(data, 4); // name
+        writeInt32(data, 0); // flags
+        writeInt32(data, 0); // time
+        writeInt32(data, 0); // condition
+        writeInt32(data, static_cast<int>(codeStart + offset)); // body
+        writeInt32(data, 0); // arguments
+    }
+
+    // Identifiers: one name at offset 4 of the block.
+    writeInt32(data, 8);
+    data.insert(data.end(), { 'p', 'r', 'o', 'c', '\0', 0, 0, 0 });
+
+    // Static strings terminator.
+    writeInt32(data, 0);
+
+    data.insert(data.end(), code.begin(), code.end());
+
+    return data;
+}
+
+// Appends depth and topmost values of program stack, deeper values are
+// checked when they are popped.
+static void appendProgramStack(std::string& trace, ProgramStack* stack)
+{
+    char string[32];
+    snprintf(string, sizeof(string), " %zu:", stack->size());
+    trace += string;
+
+    size_t start = stack->size() > CONFORMANCE_STACK_VALUES ? stack->size() - CONFORMANCE_STACK_VALUES : 0;
+    for (size_t index = start; index < stack->size(); index++) {
+        const ProgramValue& value = stack->at(index);
+        snprintf(string, sizeof(string), " %x:%x", value.opcode, value.integerValue);
+        trace += string;
+    }
+}
+
+static void appendProgramState(std::string& trace, Program* program)
+{
+    char string[128];
+    snprintf(string, sizeof(string), "ip=%d fl=%x ex=%d fp=%d bp=%d |",
+        program->instructionPointer,
+        program->flags,
+        program->exited ? 1 : 0,
+        program->framePointer,
+        program->basePointer);
+    trace += string;
+
+    appendProgramStack(trace, program->stackValues);
+    trace += " |";
+    appendProgramStack(trace, program->returnStackValues);
+    trace += "\n";
+}
+
+// Runs two instances of program, returns trace of their states followed by
+// messages reported by interpreter.
+static std::string runProgram(const std::vector<unsigned char>& data, unsigned int seed)
+{
+    gProgramData = &data;
+    gTrace.clear();
+
+    std::string trace;
+    char path[] = "test.int";
+    Program* programs[2] = { programCreateByPath(path), programCreateByPath(path) };
+    if (programs[0] == nullptr || programs[1] == nullptr) {
+        return "load failed\n";
+    }
+
+    for (int step = 0; step < CONFORMANCE_STEPS; step++) {
+        seed = seed * 1103515245 + 12345;
+        int burst = 1 + (seed >> 16) % 4;
+        Program* program = programs[(seed >> 20) & 1];
+        _interpret(program, burst);
+        appendProgramState(trace, program);
+
+        if ((programs[0]->flags & PROGRAM_FLAG_EXITED) != 0 && (programs[1]->flags & PROGRAM_FLAG_EXITED) != 0) {
+            break;
+        }
+    }
+
+    programFree(programs[1]);
+    programFree(programs[0]);
+
+    return trace + gTrace;
+}
+
+int main(int argc, char* argv[])
+{
+    interpreterRegisterOpcodeHandlers();
+
+    unsigned long long checksum = 14695981039346656037ULL;
+    size_t traceLines = 0;
+    double elapsed = 0.0;
+
+    for (int index = 0; index < CONFORMANCE_PROGRAMS; index++) {
+        std::vector<unsigned char> data = buildProgram();
+        unsigned int seed = (nextRandom() << 15) | nextRandom();
+
+        auto start = std::chrono::steady_clock::now();
+        std::string trace = runProgram(data, seed);
+        elapsed += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        for (char ch : trace) {
+            checksum ^= static_cast<unsigned char>(ch);
+            checksum *= 1099511628211ULL;
+
+            if (ch == '\n') {
+                traceLines++;
+            }
+        }
+    }
+
+    bool matches = checksum == CONFORMANCE_CHECKSUM;
+
+    printf("%d programs, %zu trace lines, checksum %016llx, %.1f ms%s\n",
+        CONFORMANCE_PROGRAMS,
+        traceLines,
+        checksum,
+        elapsed * 1000.0,
+        matches ? "" : "  MISMATCH");
+
+    return matches ? 0 : 1;
+}
@@ -0,0 +1,405 @@
+// Decodes synthetic MVE movies, checks shown frames and palettes against
+// checksums produced by the original decoder and reports decoding speed with
+// and without decoding ahead.
+//
+// Movies consist of random video opcodes (every opcode and pattern variant),
+// random partial palette updates, frames without shown pixels and records
+// with more than one frame.
+//
+// Shown frames are also stretched by a scale factor the way movie window
+// does it, to account for presentation cost decoding ahead overlaps with.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <vector>
+
+#include "movie_lib.h"
+
+namespace fallout {
+
+// Normally defined by the game loop, used by audio engine (movies have no
+// audio here).
+bool gProgramIsActive = true;
+
+} // namespace fallout
+
+using namespace fallout;
+
+// Random motion vectors can point outside of frame buffers (decoder does not
+// clip them), allocations are padded so such reads stay in bounds.
+#define MOVIE_BENCHMARK_ALLOCATION_PADDING (1 << 20)
+
+typedef struct MovieBenchmarkCase {
+    const char* name;
+    int movies;
+
+    // Size in 8x8 blocks, random sizes are used when 0. Records (up to two
+    // frames of video data) must fit into 64 KB.
+    int width;
+    int height;
+
+    // Number of frames, random when 0.
+    int frames;
+
+    unsigned long long checksum;
+} MovieBenchmarkCase;
+
+// Checksums are FNV-1a hashes of shown frames and palettes produced by the
+// decoder as of 4fa4157 (before decode-ahead thread and SIMD changes).
+static MovieBenchmarkCase kCases[] = {
+    { "random", 300, 0, 0, 0, 0x3a1b11efab5e4b12ULL },
+    { "240x160", 20, 30, 20, 100, 0x7ac15644f8abd948ULL },
+};
+
+// Scale factors shown frames are stretched by.
+static const int kScales[] = { 1, 4 };
+
+static std::vector<unsigned char> gMovieData;
+static size_t gMoviePos;
+static unsigned long long gMovieHash;
+static int gMovieShownFrames;
+static int gMovieScale;
+static std::vector<unsigned char> gMovieScaledPixels;
+static unsigned int gSeed;
+
+static unsigned int nextRandom()
+{
+    gSeed = gSeed * 1103515245 + 12345;
+    return (gSeed >> 16) & 0x7FFF;
+}
+
+static void hashBytes(const unsigned char* data, size_t size)
+{
+    for (size_t index = 0; index < size; index++) {
+        gMovieHash ^= data[index];
+        gMovieHash *= 1099511628211ULL;
+    }
+}
+
+static void hashInt(int value)
+{
+    unsigned char bytes[4];
+    for (int index = 0; index < 4; index++) {
+        bytes[index] = (value >> (8 * index)) & 0xFF;
+    }
+    hashBytes(bytes, sizeof(bytes));
+}
+
+static void* movieMalloc(size_t size)
+{
+    unsigned char* ptr = static_cast<unsigned char*>(calloc(1, size + 2 * MOVIE_BENCHMARK_ALLOCATION_PADDING));
+    return ptr != nullptr ? ptr + MOVIE_BENCHMARK_ALLOCATION_PADDING : nullptr;
+}
+
+static void movieFree(void* ptr)
+{
+    free(static_cast<unsigned char*>(ptr) - MOVIE_BENCHMARK_ALLOCATION_PADDING);
+}
+
+static bool movieRead(void* handle, void* buffer, int count)
+{
+    if (gMoviePos + count > gMovieData.size()) {
+        return false;
+    }
+
+    memcpy(buffer, gMovieData.data() + gMoviePos, count);
+    gMoviePos += count;
+    return true;
+}
+
+static void movieShowFrame(unsigned char* pixels, int srcWidth, int srcHeight, int srcX, int srcY, int destWidth, int destHeight, int destX, int destY)
+{
+    hashInt(srcWidth);
+    hashInt(srcHeight);
+    hashInt(destX);
+    hashInt(destY);
+    hashBytes(pixels, srcWidth * srcHeight);
+    gMovieShownFrames++;
+
+    int scaledWidth = srcWidth * gMovieScale;
+    int scaledHeight = srcHeight * gMovieScale;
+    gMovieScaledPixels.resize(scaledWidth * scaledHeight);
+
+    unsigned char* dest = gMovieScaledPixels.data();
+    for (int y = 0; y < scaledHeight; y++) {
+        const unsigned char* src = pixels + (y / gMovieScale) * srcWidth;
+        for (int x = 0; x < scaledWidth; x++) {
+            *dest++ = src[x / gMovieScale];
+        }
+    }
+}
+
+static void movieSetPalette(unsigned char* palette, int start, int count)
+{
+    hashInt(start);
+    hashInt(count);
+    hashBytes(palette, count * 3);
+}
+
+static void writeShort(std::vector<unsigned char>& data, int value)
+{
+    data.push_back(value & 0xFF);
+    data.push_back((value >> 8) & 0xFF);
+}
+
+static void writeChunk(std::vector<unsigned char>& data, int type, int version, const std::vector<unsigned char>& payload)
+{
+    writeShort(data, static_cast<int>(payload.size()));
+    data.push_back(type);
+    data.push_back(version);
+    data.insert(data.end(), payload.begin(), payload.end());
+}
+
+static void writePalette(std::vector<unsigned char>& record, int start, int count)
+{
+    std::vector<unsigned char> payload;
+    writeShort(payload, start);
+    writeShort(payload, count);
+    for (int index = 0; index < count * 3; index++) {
+        payload.push_back(nextRandom() & 0x3F);
+    }
+    writeChunk(record, 12, 0, payload);
+}
+
+// Builds opcode map (chunk 15) and video data (chunk 17) of one frame. First
+// frame uses no copy opcodes since there is nothing to copy from.
+static void buildFrame(int width, int height, bool first, std::vector<unsigned char>& map, std::vector<unsigned char>& video)
+{
+    static const int kOpcodes[] = { 0, 1, 2, 3, 4, 5, 7, 8, 9, 10, 11, 12, 13, 14, 15 };
+
+    std::vector<unsigned char> data;
+    for (int block = 0; block < width * height; block += 2) {
+        int opcodes[2];
+        for (int index = 0; index < 2; index++) {
+            int opcode = kOpcodes[nextRandom() % 15];
+            if (first && opcode <= 5) {
+                opcode = 11;
+            }
+            opcodes[index] = opcode;
+
+            unsigned char bytes[64];
+            for (int byte = 0; byte < 64; byte++) {
+                bytes[byte] = nextRandom() & 0xFF;
+            }
+
+            // Length of block data, pattern opcodes select variant by
+            // ordering of their first colors.
+            int length = 0;
+            switch (opcode) {
+            case 2:
+            case 3:
+            case 4:
+            case 14:
+                length = 1;
+                break;
+            case 5:
+            case 15:
+                length = 2;
+                break;
+            case 7:
+                length = bytes[0] > bytes[1] ? 4 : 10;
+                break;
+            case 8:
+                length = bytes[0] > bytes[1] ? 12 : 16;
+                break;
+            case 9:
+                length = bytes[0] > bytes[1] ? 12 : (bytes[2] > bytes[3] ? 8 : 20);
+                break;
+            case 10:
+                length = bytes[0] > bytes[1] ? 24 : 32;
+                break;
+            case 11:
+                length = 64;
+                break;
+            case 12:
+                length = 16;
+                break;
+            case 13:
+                length = 4;
+                break;
+            }
+            data.insert(data.end(), bytes, bytes + length);
+        }
+        map.push_back(opcodes[0] | (opcodes[1] << 4));
+    }
+
+    writeShort(video, 0);
+    writeShort(video, 0);
+    writeShort(video, 0);
+    writeShort(video, 0);
+    writeShort(video, width);
+    writeShort(video, height);
+    writeShort(video, nextRandom() % 2);
+    video.insert(video.end(), data.begin(), data.end());
+}
+
+static void buildMovie(const MovieBenchmarkCase& benchmarkCase)
+{
+    std::vector<std::vector<unsigned char>> records;
+
+    int width = benchmarkCase.width != 0 ? benchmarkCase.width : 4 + nextRandom() % 6;
+    int height = benchmarkCase.height != 0 ? benchmarkCase.height : 3 + nextRandom() % 5;
+    int frames = benchmarkCase.frames != 0 ? benchmarkCase.frames : 5 + nextRandom() % 40;
+
+    // Video mode, full palette and end of record.
+    {
+        std::vector<unsigned char> record;
+        std::vector<unsigned char> payload;
+        writeShort(payload, width);
+        writeShort(payload, height);
+        writeShort(payload, 1);
+        writeChunk(record, 5, 1, payload);
+        writePalette(record, 0, 256);
+        writeChunk(record, 1, 0, {});
+        records.push_back(record);
+    }
+
+    for (int frame = 0; frame < frames; frame++) {
+        std::vector<unsigned char> record;
+
+        if (nextRandom() % 3 == 0) {
+            int start = nextRandom() % 200;
+            int count = 1 + nextRandom() % 50;
+            writePalette(record, start, count);
+        }
+
+        if (nextRandom() % 5 == 0) {
+            std::vector<unsigned char> payload;
+            writeShort(payload, 0);
+            writeShort(payload, 0);
+            writeShort(payload, 0);
+            writeChunk(record, 14, 0, payload);
+        }
+
+        std::vector<unsigned char> map;
+        std::vector<unsigned char> video;
+        buildFrame(width, height, frame == 0, map, video);
+        writeChunk(record, 15, 0, map);
+        writeChunk(record, 17, 3, video);
+
+        std::vector<unsigned char> show;
+        writeShort(show, 0);
+        writeShort(show, nextRandom() % 4 == 0 ? 1 + nextRandom() % 20 : 0);
+        writeChunk(record, 7, 0, show);
+
+        // Some records contain the same frame twice.
+        if (nextRandom() % 2 == 0 && frame != frames - 1) {
+            std::vector<unsigned char> showAgain;
+            writeShort(showAgain, 0);
+            writeShort(showAgain, 0);
+            writeChunk(record, 15, 0, map);
+            writeChunk(record, 17, 3, video);
+            writeChunk(record, 7, 0, showAgain);
+        }
+
+        writeChunk(record, 1, 0, {});
+        records.push_back(record);
+    }
+
+    {
+        std::vector<unsigned char> record;
+        writeChunk(record, 0, 0, {});
+        records.push_back(record);
+    }
+
+    gMovieData.clear();
+
+    const char* signature = "Interplay MVE File\x1A";
+    gMovieData.insert(gMovieData.end(), signature, signature + 20);
+    writeShort(gMovieData, 26);
+    writeShort(gMovieData, 256);
+    writeShort(gMovieData, 4659 - 256);
+
+    // Every record is preceded by its size (16 bits) and 16 unused bits.
+    for (size_t index = 0; index <= records.size(); index++) {
+        writeShort(gMovieData, index < records.size() ? static_cast<int>(records[index].size()) : 0);
+        writeShort(gMovieData, 0);
+
+        if (index < records.size()) {
+            gMovieData.insert(gMovieData.end(), records[index].begin(), records[index].end());
+        }
+    }
+}
+
+// Plays movies of benchmark case, returns checksum of everything shown and
+// time spent in movie library (including presentation).
+static unsigned long long playMovies(const MovieBenchmarkCase& benchmarkCase, double* elapsedPtr)
+{
+    gSeed = 1;
+    gMovieHash = 14695981039346656037ULL;
+    gMovieShownFrames = 0;
+
+    double elapsed = 0.0;
+    for (int movie = 0; movie < benchmarkCase.movies; movie++) {
+        buildMovie(benchmarkCase);
+        gMoviePos = 0;
+
+        auto start = std::chrono::steady_clock::now();
+
+        int rc = MVE_rmPrepMovie(nullptr, 0, 0, 0);
+        for (int step = 0; rc == 0 && step < 1000; step++) {
+            rc = _MVE_rmStepMovie();
+        }
+
+        int frame;
+        int dropped;
+        MVE_rmFrameCounts(&frame, &dropped);
+
+        MVE_rmEndMovie();
+        MVE_ReleaseMem();
+
+        elapsed += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        hashInt(rc);
+        hashInt(frame);
+    }
+
+    *elapsedPtr = elapsed;
+
+    return gMovieHash;
+}
+
+int main(int argc, char* argv[])
+{
+    MveSetMemory(movieMalloc, movieFree);
+    MveSetIO(movieRead);
+    MveSetScreenSize(640, 480);
+    MveSetShowFrame(movieShowFrame);
+    MveSetPalette(movieSetPalette);
+
+    int failures = 0;
+
+    printf("%-8s %6s %6s %6s %8s %18s %10s\n", "case", "ahead", "scale", "movies", "frames", "checksum", "frames/s");
+
+    for (const MovieBenchmarkCase& benchmarkCase : kCases) {
+        for (int scale : kScales) {
+            for (bool decodeAhead : { false, true }) {
+                gMovieScale = scale;
+                MveSetDecodeAhead(decodeAhead);
+
+                double elapsed;
+                unsigned long long checksum = playMovies(benchmarkCase, &elapsed);
+                bool matches = checksum == benchmarkCase.checksum;
+
+                printf("%-8s %6s %6d %6d %8d   %016llx %10.1f%s\n",
+                    benchmarkCase.name,
+                    decodeAhead ? "on" : "off",
+                    scale,
+                    benchmarkCase.movies,
+                    gMovieShownFrames,
+                    checksum,
+                    elapsed > 0.0 ? gMovieShownFrames / elapsed : 0.0,
+                    matches ? "" : "  MISMATCH");
+
+                if (!matches) {
+                    failures++;
+                }
+            }
+        }
+    }
+
+    return failures != 0 ? 1 : 0;
+}
@@ -0,0 +1,145 @@
+// Compares expansion of 8-bit frames into 32-bit texture pixels done by
+// `renderPresent` against the former path (`SDL_BlitSurface` from 8-bit
+// surface into intermediate RGB888 surface), checking both produce the same
+// colors and reporting throughput of each.
+//
+// Texture upload is not included, the benchmark runs without a renderer.
+
+#include <stdio.h>
+#include <string.h>
+
+#include <chrono>
+#include <vector>
+
+#include <SDL.h>
+
+#include "palette_expand.h"
+
+using namespace fallout;
+
+#define BENCHMARK_FRAMES 200
+
+typedef struct BenchmarkSize {
+    int width;
+    int height;
+} BenchmarkSize;
+
+static const BenchmarkSize kSizes[] = {
+    { 640, 480 },
+    { 1280, 720 },
+    { 1920, 1080 },
+};
+
+static unsigned int gSeed = 1;
+
+static unsigned int nextRandom()
+{
+    gSeed = gSeed * 1103515245 + 12345;
+    return gSeed >> 16;
+}
+
+static double elapsedSeconds(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char* argv[])
+{
+    const Uint32 format = SDL_PIXELFORMAT_RGB888;
+
+    SDL_PixelFormat* pixelFormat = SDL_AllocFormat(format);
+    if (pixelFormat == nullptr) {
+        fprintf(stderr, "SDL_AllocFormat failed: %s\n", SDL_GetError());
+        return 1;
+    }
+
+    Uint32 colorMask = pixelFormat->Rmask | pixelFormat->Gmask | pixelFormat->Bmask;
+    PaletteExpandProc* expandProc = paletteExpandGetProc();
+    int failures = 0;
+
+    printf("%-10s %12s %12s %12s\n", "size", "blit Mpx/s", "scalar Mpx/s", "best Mpx/s");
+
+    for (const BenchmarkSize& size : kSizes) {
+        SDL_Surface* src = SDL_CreateRGBSurface(0, size.width, size.height, 8, 0, 0, 0, 0);
+        SDL_Surface* dest = SDL_CreateRGBSurfaceWithFormat(0, size.width, size.height, SDL_BITSPERPIXEL(format), format);
+        if (src == nullptr || dest == nullptr) {
+            fprintf(stderr, "SDL_CreateRGBSurface failed: %s\n", SDL_GetError());
+            return 1;
+        }
+
+        SDL_Color colors[256];
+        PaletteExpandTable table;
+        for (int index = 0; index < 256; index++) {
+            colors[index].r = nextRandom() & 0xFF;
+            colors[index].g = nextRandom() & 0xFF;
+            colors[index].b = nextRandom() & 0xFF;
+            colors[index].a = 255;
+            paletteExpandTableSetColor(&table, index, SDL_MapRGB(pixelFormat, colors[index].r, colors[index].g, colors[index].b));
+        }
+        SDL_SetPaletteColors(src->format->palette, colors, 0, 256);
+
+        for (int y = 0; y < size.height; y++) {
+            unsigned char* row = static_cast<unsigned char*>(src->pixels) + src->pitch * y;
+            for (int x = 0; x < size.width; x++) {
+                row[x] = nextRandom() & 0xFF;
+            }
+        }
+
+        int pitch = size.width * 4;
+        std::vector<unsigned char> scalarPixels(pitch * size.height);
+        std::vector<unsigned char> bestPixels(pitch * size.height);
+
+        auto start = std::chrono::steady_clock::now();
+        for (int frame = 0; frame < BENCHMARK_FRAMES; frame++) {
+            SDL_BlitSurface(src, nullptr, dest, nullptr);
+        }
+        double blitTime = elapsedSeconds(start);
+
+        start = std::chrono::steady_clock::now();
+        for (int frame = 0; frame < BENCHMARK_FRAMES; frame++) {
+            paletteExpandScalar(&table, static_cast<unsigned char*>(src->pixels), src->pitch, scalarPixels.data(), pitch, size.width, size.height);
+        }
+        double scalarTime = elapsedSeconds(start);
+
+        start = std::chrono::steady_clock::now();
+        for (int frame = 0; frame < BENCHMARK_FRAMES; frame++) {
+            expandProc(&table, static_cast<unsigned char*>(src->pixels), src->pitch, bestPixels.data(), pitch, size.width, size.height);
+        }
+        double bestTime = elapsedSeconds(start);
+
+        // Unused bits of RGB888 pixels are not compared.
+        int mismatches = 0;
+        for (int y = 0; y < size.height; y++) {
+            const Uint32* blitRow = reinterpret_cast<const Uint32*>(static_cast<unsigned char*>(dest->pixels) + dest->pitch * y);
+            const Uint32* scalarRow = reinterpret_cast<const Uint32*>(scalarPixels.data() + pitch * y);
+            const Uint32* bestRow = reinterpret_cast<const Uint32*>(bestPixels.data() + pitch * y);
+            for (int x = 0; x < size.width; x++) {
+                if ((blitRow[x] & colorMask) != (scalarRow[x] & colorMask) || scalarRow[x] != bestRow[x]) {
+                    mismatches++;
+                }
+            }
+        }
+
+        double megapixels = static_cast<double>(size.width) * size.height * BENCHMARK_FRAMES / 1000000.0;
+
+        char sizeName[16];
+        snprintf(sizeName, sizeof(sizeName), "%dx%d", size.width, size.height);
+        printf("%-10s %12.1f %12.1f %12.1f%s\n",
+            sizeName,
+            megapixels / blitTime,
+            megapixels / scalarTime,
+            megapixels / bestTime,
+            mismatches != 0 ? "  MISMATCH" : "");
+
+        if (mismatches != 0) {
+            failures++;
+        }
+
+        SDL_FreeSurface(dest);
+        SDL_FreeSurface(src);
+    }
+
+    SDL_FreeFormat(pixelFormat);
+
+    return failures != 0 ? 1 : 0;
+}
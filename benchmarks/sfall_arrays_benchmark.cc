@@ -0,0 +1,321 @@
+// Fills associative arrays of 10000 int, float and string keys, then looks
+// up, overwrites, iterates and removes keys, checking values, length and
+// insertion order along the way and reporting time spent in every phase.
+//
+// String keys are dynamic strings of a program created from minimal bytecode,
+// the way scripts pass them. Game side of the interpreter (file system,
+// exported variables, script library) is replaced with stubs below.
+
+#include <stdio.h>
+#include <string.h>
+
+#include <chrono>
+#include <vector>
+
+#include "db.h"
+#include "debug.h"
+#include "export.h"
+#include "input.h"
+#include "interpreter.h"
+#include "interpreter_lib.h"
+#include "sfall_arrays.h"
+#include "sfall_global_scripts.h"
+#include "sfall_lists.h"
+
+#define BENCHMARK_ENTRIES 10000
+#define BENCHMARK_LOOKUP_ROUNDS 10
+
+namespace fallout {
+
+static std::vector<unsigned char> gProgramData;
+
+int debugPrint(const char* format, ...)
+{
+    return 0;
+}
+
+unsigned int getTicks()
+{
+    return 0;
+}
+
+File* fileOpen(const char* filePath, const char* mode)
+{
+    return reinterpret_cast<File*>(&gProgramData);
+}
+
+int fileGetSize(File* stream)
+{
+    return static_cast<int>(gProgramData.size());
+}
+
+size_t fileRead(void* buf, size_t size, size_t count, File* stream)
+{
+    memcpy(buf, gProgramData.data(), size * count);
+    return count;
+}
+
+int fileClose(File* stream)
+{
+    return 0;
+}
+
+void intLibInit()
+{
+}
+
+void intLibExit()
+{
+}
+
+void intLibUpdate()
+{
+}
+
+void intLibRemoveProgramReferences(Program* program)
+{
+}
+
+void _initExport()
+{
+}
+
+void externalVariablesClear()
+{
+}
+
+int externalVariableCreate(Program* program, const char* identifier)
+{
+    return 0;
+}
+
+int externalVariableGetValue(Program* program, const char* name, ProgramValue& value)
+{
+    return -1;
+}
+
+int externalVariableSetValue(Program* program, const char* identifier, ProgramValue& value)
+{
+    return -1;
+}
+
+int externalProcedureCreate(Program* program, const char* identifier, int address, int argumentCount)
+{
+    return 0;
+}
+
+Program* externalProcedureGetProgram(const char* identifier, int* addressPtr, int* argumentCountPtr)
+{
+    return nullptr;
+}
+
+void sfall_gl_scr_update(int burstSize)
+{
+}
+
+void sfall_lists_fill(int type, std::vector<Object*>& objects)
+{
+}
+
+} // namespace fallout
+
+using namespace fallout;
+
+typedef enum KeyType {
+    KEY_TYPE_INT,
+    KEY_TYPE_FLOAT,
+    KEY_TYPE_STRING,
+    KEY_TYPE_COUNT,
+} KeyType;
+
+static const char* kKeyTypeNames[KEY_TYPE_COUNT] = {
+    "int",
+    "float",
+    "string",
+};
+
+static Program* gProgram;
+static int gFailures;
+
+static double elapsedMilliseconds(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Builds program without procedures which only serves as owner of dynamic
+// strings.
+static Program* createProgram()
+{
+    gProgramData.assign(42, 0);
+
+    // Procedures.
+    gProgramData.insert(gProgramData.end(), { 0, 0, 0, 0 });
+
+    // Identifiers.
+    gProgramData.insert(gProgramData.end(), { 0, 0, 0, 8, 'n', 'o', 'n', 'e', 0, 0, 0, 0 });
+
+    // Static strings.
+    gProgramData.insert(gProgramData.end(), { 0, 0, 0, 0 });
+
+    // Code.
+    gProgramData.insert(gProgramData.end(), { OPCODE_EXIT_PROGRAM >> 8, OPCODE_EXIT_PROGRAM & 0xFF });
+
+    char path[] = "benchmark.int";
+    return programCreateByPath(path);
+}
+
+// Keys are spread out so that neither key values nor their hashes are
+// sequential.
+static ProgramValue makeKey(KeyType keyType, int index)
+{
+    ProgramValue value;
+    switch (keyType) {
+    case KEY_TYPE_INT:
+        value.opcode = VALUE_TYPE_INT;
+        value.integerValue = index * 7919;
+        break;
+    case KEY_TYPE_FLOAT:
+        value.opcode = VALUE_TYPE_FLOAT;
+        value.floatValue = static_cast<float>(index) * 0.5f + 0.25f;
+        break;
+    case KEY_TYPE_STRING: {
+        char string[32];
+        snprintf(string, sizeof(string), "item_%d", index);
+        value.opcode = VALUE_TYPE_DYNAMIC_STRING;
+        value.integerValue = programPushString(gProgram, string);
+        break;
+    }
+    default:
+        break;
+    }
+    return value;
+}
+
+static bool keysEqual(const ProgramValue& key, const ProgramValue& other)
+{
+    if (key.opcode != other.opcode) {
+        return false;
+    }
+
+    if (key.opcode == VALUE_TYPE_DYNAMIC_STRING) {
+        return strcmp(programGetString(gProgram, key.opcode, key.integerValue), programGetString(gProgram, other.opcode, other.integerValue)) == 0;
+    }
+
+    return key.integerValue == other.integerValue;
+}
+
+static void check(bool condition, KeyType keyType, const char* message)
+{
+    if (!condition) {
+        printf("%s keys: %s\n", kKeyTypeNames[keyType], message);
+        gFailures++;
+    }
+}
+
+static void runBenchmark(KeyType keyType)
+{
+    std::vector<ProgramValue> keys;
+    for (int index = 0; index < BENCHMARK_ENTRIES; index++) {
+        keys.push_back(makeKey(keyType, index));
+    }
+
+    ArrayId arrayId = CreateArray(-1, 0);
+
+    auto start = std::chrono::steady_clock::now();
+    for (int index = 0; index < BENCHMARK_ENTRIES; index++) {
+        SetArray(arrayId, keys[index], ProgramValue(index + 1), true, gProgram);
+    }
+    double fillTime = elapsedMilliseconds(start);
+
+    check(LenArray(arrayId) == BENCHMARK_ENTRIES, keyType, "wrong length after fill");
+
+    bool lookupsMatch = true;
+    start = std::chrono::steady_clock::now();
+    for (int round = 0; round < BENCHMARK_LOOKUP_ROUNDS; round++) {
+        for (int index = 0; index < BENCHMARK_ENTRIES; index++) {
+            int keyIndex = (index * 31 + round) % BENCHMARK_ENTRIES;
+            if (GetArray(arrayId, keys[keyIndex], gProgram).integerValue != keyIndex + 1) {
+                lookupsMatch = false;
+            }
+        }
+    }
+    double lookupTime = elapsedMilliseconds(start);
+
+    check(lookupsMatch, keyType, "wrong value found");
+
+    start = std::chrono::steady_clock::now();
+    for (int index = BENCHMARK_ENTRIES - 1; index >= 0; index--) {
+        SetArray(arrayId, keys[index], ProgramValue(-index - 1), true, gProgram);
+    }
+    double updateTime = elapsedMilliseconds(start);
+
+    check(LenArray(arrayId) == BENCHMARK_ENTRIES, keyType, "wrong length after update");
+
+    // Overwriting must keep insertion order.
+    bool orderMatches = true;
+    start = std::chrono::steady_clock::now();
+    for (int index = 0; index < BENCHMARK_ENTRIES; index++) {
+        if (!keysEqual(GetArrayKey(arrayId, index, gProgram), keys[index])) {
+            orderMatches = false;
+        }
+    }
+    double iterateTime = elapsedMilliseconds(start);
+
+    check(orderMatches, keyType, "wrong order after update");
+
+    // Setting zero with `allowUnset` removes even entries.
+    start = std::chrono::steady_clock::now();
+    for (int index = 0; index < BENCHMARK_ENTRIES; index += 2) {
+        SetArray(arrayId, keys[index], ProgramValue(0), true, gProgram);
+    }
+    double removeTime = elapsedMilliseconds(start);
+
+    check(LenArray(arrayId) == BENCHMARK_ENTRIES / 2, keyType, "wrong length after remove");
+
+    bool remainingMatch = true;
+    for (int index = 0; index < BENCHMARK_ENTRIES / 2; index++) {
+        int keyIndex = index * 2 + 1;
+        if (!keysEqual(GetArrayKey(arrayId, index, gProgram), keys[keyIndex])
+            || GetArray(arrayId, keys[keyIndex], gProgram).integerValue != -keyIndex - 1
+            || GetArray(arrayId, keys[keyIndex - 1], gProgram).integerValue != 0) {
+            remainingMatch = false;
+        }
+    }
+
+    check(remainingMatch, keyType, "wrong entries after remove");
+
+    FreeArray(arrayId);
+
+    printf("%-8s %10.2f %10.2f %10.2f %10.2f %10.2f\n",
+        kKeyTypeNames[keyType],
+        fillTime,
+        lookupTime,
+        updateTime,
+        iterateTime,
+        removeTime);
+}
+
+int main(int argc, char* argv[])
+{
+    interpreterRegisterOpcodeHandlers();
+
+    gProgram = createProgram();
+    if (gProgram == nullptr) {
+        printf("programCreateByPath failed\n");
+        return 1;
+    }
+
+    sfallArraysInit();
+
+    printf("%d entries, time in ms (lookup is %d rounds)\n", BENCHMARK_ENTRIES, BENCHMARK_LOOKUP_ROUNDS);
+    printf("%-8s %10s %10s %10s %10s %10s\n", "keys", "fill", "lookup", "update", "iterate", "remove");
+
+    for (int keyType = 0; keyType < KEY_TYPE_COUNT; keyType++) {
+        runBenchmark(static_cast<KeyType>(keyType));
+    }
+
+    sfallArraysExit();
+    programFree(gProgram);
+
+    return gFailures != 0 ? 1 : 0;
+}
@@ -0,0 +1,176 @@
+// Decodes synthetic ACM streams with `soundDecoderDecode`, checks decoded
+// samples against checksums produced by the original (non-SIMD) decoder and
+// reports decoding throughput.
+//
+// Streams are random bitstreams behind valid ACM headers, which exercises
+// every packing mode and subband configuration (see `buildStream`). Each stream is decoded in
+// 4096 byte chunks (as sound buffers do) and in small odd-sized chunks.
+
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include "sound_decoder.h"
+
+using namespace fallout;
+
+#define BENCHMARK_REPEATS 20
+
+typedef struct DecoderBenchmarkStream {
+    int levels;
+    int samplesPerSubband;
+    int channels;
+    int sampleCount;
+    int payloadSize;
+    unsigned int checksum;
+} DecoderBenchmarkStream;
+
+typedef struct DecoderBenchmarkInput {
+    const std::vector<unsigned char>* data;
+    size_t pos;
+} DecoderBenchmarkInput;
+
+// Checksums are FNV-1a hashes of decoded stream produced by the decoder as of
+// 4fa4157 (before SIMD and buffering changes).
+static DecoderBenchmarkStream kStreams[] = {
+    { 0, 2, 1, 20000, 8000, 0x0aab93e9 },
+    { 3, 64, 1, 100000, 30000, 0x41f20a31 },
+    { 5, 32, 1, 150000, 40000, 0x043443c7 },
+    { 7, 16, 1, 200000, 60000, 0xa4c1d949 },
+    { 7, 16, 2, 400000, 60000, 0xa35d56e6 },
+    { 6, 1022, 1, 150000, 50000, 0x15c4d1b7 },
+};
+
+static unsigned int gSeed = 1;
+
+static unsigned int nextRandom()
+{
+    gSeed = gSeed * 1103515245 + 12345;
+    return gSeed >> 16;
+}
+
+static void writeInt(std::vector<unsigned char>& data, unsigned int value, int size)
+{
+    for (int index = 0; index < size; index++) {
+        data.push_back((value >> (8 * index)) & 0xFF);
+    }
+}
+
+// Builds stream with random block data. The first block is crafted to make
+// output of random subsequent blocks deterministic: it has maximum scale
+// exponent to initialize entire scale table (later blocks with packing modes
+// wider than their scale exponent read entries outside of the range they set
+// up) and all subbands zero-filled (packing mode 0, subsequent blocks with
+// invalid packing modes repeat samples of the previous block).
+static std::vector<unsigned char> buildStream(const DecoderBenchmarkStream& stream)
+{
+    std::vector<unsigned char> data;
+    writeInt(data, 0x01032897, 4);
+    writeInt(data, stream.sampleCount, 4);
+    writeInt(data, stream.channels, 2);
+    writeInt(data, 22050, 2);
+    writeInt(data, stream.levels | (stream.samplesPerSubband << 4), 2);
+
+    // Scale exponent and scale (4 + 16 bits) followed by 5 bits of packing
+    // mode per subband.
+    int firstBlockBits = 20 + 5 * (1 << stream.levels);
+    unsigned int header = 0x0F | ((nextRandom() & 0xFFFF) << 4);
+    for (int bit = 0; bit < firstBlockBits; bit += 8) {
+        data.push_back(bit < 20 ? (header >> bit) & 0xFF : 0);
+    }
+
+    for (int index = 0; index < stream.payloadSize; index++) {
+        data.push_back(nextRandom() & 0xFF);
+    }
+
+    return data;
+}
+
+static int readStream(void* data, void* buffer, unsigned int size)
+{
+    DecoderBenchmarkInput* input = static_cast<DecoderBenchmarkInput*>(data);
+    size_t bytesRead = std::min(static_cast<size_t>(size), input->data->size() - input->pos);
+    memcpy(buffer, input->data->data() + input->pos, bytesRead);
+    input->pos += bytesRead;
+    return static_cast<int>(bytesRead);
+}
+
+// Decodes entire stream, returns FNV-1a hash of decoded bytes.
+static unsigned int decodeStream(const std::vector<unsigned char>& data, size_t chunkSize, size_t* decodedSizePtr)
+{
+    DecoderBenchmarkInput input = { &data, 0 };
+    int channels;
+    int sampleRate;
+    int sampleCount;
+    SoundDecoder* soundDecoder = soundDecoderInit(readStream, &input, &channels, &sampleRate, &sampleCount);
+    if (soundDecoder == nullptr) {
+        *decodedSizePtr = 0;
+        return 0;
+    }
+
+    // Odd sizes are rounded up to entire samples.
+    std::vector<unsigned char> buffer(chunkSize + 1);
+    unsigned int hash = 2166136261U;
+    size_t decodedSize = 0;
+    while (true) {
+        size_t bytesDecoded = soundDecoderDecode(soundDecoder, buffer.data(), chunkSize);
+        for (size_t index = 0; index < bytesDecoded; index++) {
+            hash ^= buffer[index];
+            hash *= 16777619U;
+        }
+        decodedSize += bytesDecoded;
+
+        if (bytesDecoded < chunkSize) {
+            break;
+        }
+    }
+
+    soundDecoderFree(soundDecoder);
+
+    *decodedSizePtr = decodedSize;
+    return hash;
+}
+
+int main(int argc, char* argv[])
+{
+    int failures = 0;
+
+    printf("%-6s %-6s %-8s %-9s %10s %12s\n", "levels", "spsb", "channels", "samples", "checksum", "Msamples/s");
+
+    for (const DecoderBenchmarkStream& stream : kStreams) {
+        std::vector<unsigned char> data = buildStream(stream);
+
+        size_t decodedSize;
+        unsigned int checksum = decodeStream(data, 4096, &decodedSize);
+
+        size_t oddDecodedSize;
+        unsigned int oddChecksum = decodeStream(data, 97, &oddDecodedSize);
+
+        bool matches = checksum == stream.checksum && oddChecksum == stream.checksum;
+
+        auto start = std::chrono::steady_clock::now();
+        for (int repeat = 0; repeat < BENCHMARK_REPEATS; repeat++) {
+            decodeStream(data, 4096, &decodedSize);
+        }
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        double samples = static_cast<double>(decodedSize / 2) * BENCHMARK_REPEATS;
+        printf("%-6d %-6d %-8d %-9d %08x %12.1f%s\n",
+            stream.levels,
+            stream.samplesPerSubband,
+            stream.channels,
+            stream.sampleCount,
+            checksum,
+            samples / elapsed / 1000000.0,
+            matches ? "" : "  MISMATCH");
+
+        if (!matches) {
+            failures++;
+        }
+    }
+
+    return failures != 0 ? 1 : 0;
+}
@@ -0,0 +1,323 @@
+// Plays synthetic ACM sound effects through the sound effects cache with
+// decoded (PCM) cache disabled and enabled, checks data read with
+// `soundEffectsCacheFileRead` against the same effects decoded directly and
+// reports time spent per mode.
+//
+// Effects are opened in a skewed order (a few effects are played most of the
+// time, the way gunfire and footsteps are) and read in 4096 byte chunks, as
+// sound buffers do. Several long effects do not fit into decoded cache and
+// are always read from compressed cache. Effects list and file system are
+// replaced with stubs below.
+
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include "db.h"
+#include "debug.h"
+#include "memory.h"
+#include "settings.h"
+#include "sound.h"
+#include "sound_decoder.h"
+#include "sound_effects_cache.h"
+#include "sound_effects_list.h"
+
+#define BENCHMARK_EFFECTS 32
+#define BENCHMARK_LONG_EFFECTS 4
+#define BENCHMARK_OPENS 400
+#define BENCHMARK_READ_SIZE 4096
+
+// Size of compressed effects cache.
+#define BENCHMARK_CACHE_SIZE (1 << 20)
+
+typedef struct BenchmarkEffect {
+    std::vector<unsigned char> data;
+    int sampleCount;
+    unsigned int checksum;
+} BenchmarkEffect;
+
+static std::vector<BenchmarkEffect> gEffects;
+
+namespace fallout {
+
+Settings settings;
+
+int debugPrint(const char* format, ...)
+{
+    return 0;
+}
+
+void soundContinueAll()
+{
+}
+
+static bool effectTagToIndex(int tag, int* indexPtr)
+{
+    int index = tag / 2 - 1;
+    if (tag % 2 != 0 || index < 0 || index >= static_cast<int>(gEffects.size())) {
+        return false;
+    }
+
+    *indexPtr = index;
+    return true;
+}
+
+bool soundEffectsListIsValidTag(int tag)
+{
+    int index;
+    return effectTagToIndex(tag, &index);
+}
+
+int soundEffectsListInit(const char* soundEffectsPath, int a2, int debugLevel)
+{
+    return SFXL_OK;
+}
+
+void soundEffectsListExit()
+{
+}
+
+int soundEffectsListGetTag(char* name, int* tagPtr)
+{
+    int index;
+    if (sscanf(name, "EFFECT%d.ACM", &index) != 1) {
+        return SFXL_ERR;
+    }
+
+    *tagPtr = 2 * index + 2;
+    return soundEffectsListIsValidTag(*tagPtr) ? SFXL_OK : SFXL_ERR;
+}
+
+int soundEffectsListGetFilePath(int tag, char** pathPtr)
+{
+    int index;
+    if (!effectTagToIndex(tag, &index)) {
+        return SFXL_ERR_TAG_INVALID;
+    }
+
+    char path[32];
+    snprintf(path, sizeof(path), "EFFECT%d.ACM", index);
+    *pathPtr = internal_strdup(path);
+    return SFXL_OK;
+}
+
+int soundEffectsListGetDataSize(int tag, int* sizePtr)
+{
+    int index;
+    if (!effectTagToIndex(tag, &index)) {
+        return SFXL_ERR_TAG_INVALID;
+    }
+
+    *sizePtr = 2 * gEffects[index].sampleCount;
+    return SFXL_OK;
+}
+
+int soundEffectsListGetFileSize(int tag, int* sizePtr)
+{
+    int index;
+    if (!effectTagToIndex(tag, &index)) {
+        return SFXL_ERR_TAG_INVALID;
+    }
+
+    *sizePtr = static_cast<int>(gEffects[index].data.size());
+    return SFXL_OK;
+}
+
+int dbGetFileContents(const char* filePath, void* ptr)
+{
+    int index;
+    if (sscanf(filePath, "EFFECT%d.ACM", &index) != 1) {
+        return -1;
+    }
+
+    memcpy(ptr, gEffects[index].data.data(), gEffects[index].data.size());
+    return 0;
+}
+
+} // namespace fallout
+
+using namespace fallout;
+
+typedef struct DecoderInput {
+    const std::vector<unsigned char>* data;
+    size_t pos;
+} DecoderInput;
+
+static unsigned int gSeed = 1;
+
+static unsigned int nextRandom()
+{
+    gSeed = gSeed * 1103515245 + 12345;
+    return gSeed >> 16;
+}
+
+static unsigned int hashBytes(unsigned int hash, const unsigned char* data, size_t size)
+{
+    for (size_t index = 0; index < size; index++) {
+        hash ^= data[index];
+        hash *= 16777619U;
+    }
+    return hash;
+}
+
+static void writeInt(std::vector<unsigned char>& data, unsigned int value, int size)
+{
+    for (int index = 0; index < size; index++) {
+        data.push_back((value >> (8 * index)) & 0xFF);
+    }
+}
+
+// Builds stream with random block data after the first block, which has
+// maximum scale exponent and all subbands zero-filled to make decoding of
+// random blocks deterministic (see sound decoder benchmark).
+static std::vector<unsigned char> buildStream(int levels, int samplesPerSubband, int channels, int sampleCount, int payloadSize)
+{
+    std::vector<unsigned char> data;
+    writeInt(data, 0x01032897, 4);
+    writeInt(data, sampleCount, 4);
+    writeInt(data, channels, 2);
+    writeInt(data, 22050, 2);
+    writeInt(data, levels | (samplesPerSubband << 4), 2);
+
+    int firstBlockBits = 20 + 5 * (1 << levels);
+    unsigned int header = 0x0F | ((nextRandom() & 0xFFFF) << 4);
+    for (int bit = 0; bit < firstBlockBits; bit += 8) {
+        data.push_back(bit < 20 ? (header >> bit) & 0xFF : 0);
+    }
+
+    for (int index = 0; index < payloadSize; index++) {
+        data.push_back(nextRandom() & 0xFF);
+    }
+
+    return data;
+}
+
+static int readStream(void* data, void* buffer, unsigned int size)
+{
+    DecoderInput* input = static_cast<DecoderInput*>(data);
+    size_t bytesRead = std::min(static_cast<size_t>(size), input->data->size() - input->pos);
+    memcpy(buffer, input->data->data() + input->pos, bytesRead);
+    input->pos += bytesRead;
+    return static_cast<int>(bytesRead);
+}
+
+// Builds effects and computes checksums of their entire decoded data.
+static void buildEffects()
+{
+    for (int index = 0; index < BENCHMARK_EFFECTS; index++) {
+        BenchmarkEffect effect;
+        bool isLong = index >= BENCHMARK_EFFECTS - BENCHMARK_LONG_EFFECTS;
+        effect.sampleCount = isLong ? 150000 + nextRandom() % 50000 : 2000 + nextRandom() % 40000;
+        effect.data = buildStream(7, 16, 1 + nextRandom() % 2, effect.sampleCount, effect.sampleCount / 3);
+
+        DecoderInput input = { &(effect.data), 0 };
+        int channels;
+        int sampleRate;
+        int sampleCount;
+        SoundDecoder* soundDecoder = soundDecoderInit(readStream, &input, &channels, &sampleRate, &sampleCount);
+
+        std::vector<unsigned char> decoded(2 * effect.sampleCount);
+        size_t decodedSize = soundDecoderDecode(soundDecoder, decoded.data(), decoded.size());
+        soundDecoderFree(soundDecoder);
+
+        effect.checksum = hashBytes(2166136261U, decoded.data(), decodedSize);
+        gEffects.push_back(effect);
+    }
+}
+
+// Opens, reads and closes effects in the same order every run, returns number
+// of effects which were read incorrectly.
+static int playEffects(double* elapsedPtr, size_t* bytesPtr)
+{
+    unsigned char buffer[BENCHMARK_READ_SIZE];
+    int failures = 0;
+    size_t bytes = 0;
+
+    gSeed = 1;
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (int open = 0; open < BENCHMARK_OPENS; open++) {
+        int index = nextRandom() % 4 != 0 ? nextRandom() % 6 : nextRandom() % BENCHMARK_EFFECTS;
+
+        char name[32];
+        snprintf(name, sizeof(name), "EFFECT%d.ACM", index);
+
+        int sampleRate;
+        int handle = soundEffectsCacheFileOpen(name, &sampleRate);
+        if (handle == -1) {
+            failures++;
+            continue;
+        }
+
+        unsigned int hash = 2166136261U;
+        size_t size = 0;
+        while (true) {
+            int bytesRead = soundEffectsCacheFileRead(handle, buffer, sizeof(buffer));
+            if (bytesRead <= 0) {
+                break;
+            }
+
+            hash = hashBytes(hash, buffer, bytesRead);
+            size += bytesRead;
+        }
+
+        soundEffectsCacheFileClose(handle);
+
+        if (hash != gEffects[index].checksum || size != static_cast<size_t>(2 * gEffects[index].sampleCount)) {
+            failures++;
+        }
+
+        bytes += size;
+    }
+
+    *elapsedPtr = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    *bytesPtr = bytes;
+
+    return failures;
+}
+
+int main(int argc, char* argv[])
+{
+    buildEffects();
+
+    static const int kPcmCacheSizes[] = { 0, 2048 };
+
+    int failures = 0;
+
+    printf("%-10s %6s %10s %10s %8s\n", "pcm cache", "opens", "ms", "MB/s", "errors");
+
+    for (int pcmCacheSize : kPcmCacheSizes) {
+        settings.sound.pcm_cache_size = pcmCacheSize;
+
+        if (soundEffectsCacheInit(BENCHMARK_CACHE_SIZE, "") != 0) {
+            printf("soundEffectsCacheInit failed\n");
+            return 1;
+        }
+
+        double elapsed;
+        size_t bytes;
+        int errors = playEffects(&elapsed, &bytes);
+
+        char stats[200];
+        soundEffectsCachePrintStats(stats, sizeof(stats));
+
+        soundEffectsCacheExit();
+
+        printf("%-10d %6d %10.1f %10.1f %8d%s\n",
+            pcmCacheSize,
+            BENCHMARK_OPENS,
+            elapsed * 1000.0,
+            elapsed > 0.0 ? bytes / elapsed / 1000000.0 : 0.0,
+            errors,
+            errors == 0 ? "" : "  MISMATCH");
+        printf("%s", stats);
+
+        failures += errors;
+    }
+
+    return failures != 0 ? 1 : 0;
+}
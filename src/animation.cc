@@ -23,6 +23,7 @@
 #include "object.h"
 #include "party_member.h"
 #include "perk.h"
+#include "profiler.h"
 #include "proto.h"
 #include "proto_instance.h"
 #include "random.h"
@@ -492,7 +493,9 @@ int reg_anim_end()
     gAnimationSequenceCurrentIndex = -1;
 
     if (!(animationSequence->flags & ANIM_SEQ_0x10)) {
+        objectLightBatchBegin();
         _anim_set_continue(index, 1);
+        objectLightBatchEnd();
     }
 
     return 0;
@@ -1443,7 +1446,7 @@ static int animationRunSequence(int animationSequenceIndex)
         case ANIM_KIND_SET_FLAG:
             if (animationDescription->objectFlag == OBJECT_LIGHTING) {
                 if (_obj_turn_on_light(animationDescription->owner, &rect) == 0) {
-                    tileWindowRefreshRect(&rect, animationDescription->owner->elevation);
+                    objectLightRefreshRect(&rect, animationDescription->owner->elevation);
                 }
             } else if (animationDescription->objectFlag == OBJECT_HIDDEN) {
                 if (objectHide(animationDescription->owner, &rect) == 0) {
@@ -1458,7 +1461,7 @@ static int animationRunSequence(int animationSequenceIndex)
         case ANIM_KIND_UNSET_FLAG:
             if (animationDescription->objectFlag == OBJECT_LIGHTING) {
                 if (_obj_turn_off_light(animationDescription->owner, &rect) == 0) {
-                    tileWindowRefreshRect(&rect, animationDescription->owner->elevation);
+                    objectLightRefreshRect(&rect, animationDescription->owner->elevation);
                 }
             } else if (animationDescription->objectFlag == OBJECT_HIDDEN) {
                 if (objectShow(animationDescription->owner, &rect) == 0) {
@@ -1484,12 +1487,12 @@ static int animationRunSequence(int animationSequenceIndex)
             break;
         case ANIM_KIND_SET_LIGHT_DISTANCE:
             objectSetLight(animationDescription->owner, animationDescription->lightDistance, animationDescription->owner->lightIntensity, &rect);
-            tileWindowRefreshRect(&rect, animationDescription->owner->elevation);
+            objectLightRefreshRect(&rect, animationDescription->owner->elevation);
             rc = _anim_set_continue(animationSequenceIndex, 0);
             break;
         case ANIM_KIND_SET_LIGHT_INTENSITY:
             objectSetLight(animationDescription->owner, animationDescription->lightDistance, animationDescription->lightIntensity, &rect);
-            tileWindowRefreshRect(&rect, animationDescription->owner->elevation);
+            objectLightRefreshRect(&rect, animationDescription->owner->elevation);
             rc = _anim_set_continue(animationSequenceIndex, 0);
             break;
         case ANIM_KIND_MOVE_ON_STAIRS:
@@ -2743,8 +2746,14 @@ void _object_animate()
         return;
     }
 
+    ProfilerScope profilerScope(PROFILER_SECTION_ANIMATION);
+
     _anim_in_bk = true;
 
+    // CE: Lights toggled by animations in this tick (e.g. explosions) are
+    // refreshed at once.
+    objectLightBatchBegin();
+
     for (int index = 0; index < gAnimationCurrentSad; index++) {
         AnimationSad* sad = &(gAnimationSads[index]);
         if (sad->field_20 == -1000) {
@@ -2899,6 +2908,8 @@ void _object_animate()
         }
     }
 
+    objectLightBatchEnd();
+
     _anim_in_bk = 0;
 
     _object_anim_compact();
@@ -2,38 +2,121 @@
 
 #include <string.h>
 
+#include <algorithm>
+#include <atomic>
 #include <mutex>
 
 #include <SDL.h>
 
+#include "histogram.h"
+
+#if defined(__SSE2__)
+#define AUDIO_ENGINE_MIX_SSE2
+#include <emmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#define AUDIO_ENGINE_MIX_NEON
+#include <arm_neon.h>
+#endif
+
 namespace fallout {
 
-#define AUDIO_ENGINE_SOUND_BUFFERS 8
+#define AUDIO_ENGINE_SOUND_BUFFERS 64
+
+// CE: Default number of sound buffers mixed at once, others are virtualized.
+#define AUDIO_ENGINE_DEFAULT_VOICE_LIMIT 8
+
+// CE: Number of output frames mixed at once. Playback state of every sound
+// buffer is sampled once per block.
+#define AUDIO_ENGINE_MIX_BLOCK_FRAMES 512
+
+// CE: Number of callback duration histogram buckets and bucket width (in
+// microseconds). Last bucket collects everything above.
+#define AUDIO_ENGINE_MIX_TIME_BUCKETS 256
+#define AUDIO_ENGINE_MIX_TIME_BUCKET_WIDTH 10
+
+// CE: Output is always 16-bit stereo, SDL converts it to whatever device
+// wants.
+#define AUDIO_ENGINE_OUTPUT_CHANNELS 2
+
+struct AudioEngineSoundBuffer;
+
+typedef bool(AudioEngineMixProc)(AudioEngineSoundBuffer* soundBuffer, int* dest, int frames, unsigned int* framePtr, bool looping, int volume);
 
 struct AudioEngineSoundBuffer {
+    // CE: `active` and buffer properties are changed only while audio device
+    // is locked so that audio thread never sees partially initialized sound
+    // buffer.
     bool active;
     unsigned int size;
     int bitsPerSample;
     int channels;
     int rate;
     void* data;
-    int volume;
-    bool playing;
-    bool looping;
-    unsigned int pos;
-    SDL_AudioStream* stream;
+    int frameSize;
+    unsigned int frameCount;
+
+    // CE: Number of source frames per output frame (16.16 fixed point).
+    unsigned int step;
+
+    // CE: Fractional part of playback position (16.16 fixed point). Owned by
+    // audio thread.
+    unsigned int frac;
+
+    // CE: Position written by audio thread after mixing last block, used to
+    // detect position changes made by game threads. Owned by audio thread.
+    unsigned int mixPos;
+
+    AudioEngineMixProc* mixProc;
+
+    // CE: Playback state is shared with audio thread without locking.
+    std::atomic<int> volume;
+    std::atomic<bool> playing;
+    std::atomic<bool> looping;
+    std::atomic<unsigned int> pos;
+    std::atomic<int> priority;
+
+    // Serializes access from game threads (main thread and sound refresh
+    // timer). Audio thread never takes it.
     std::recursive_mutex mutex;
 };
 
+// CE: Audible sound buffer competing for voice limit in a mix block.
+typedef struct AudioEngineVoice {
+    int soundBuffer;
+    int priority;
+    int volume;
+} AudioEngineVoice;
+
 extern bool gProgramIsActive;
 
 static bool soundBufferIsValid(int soundBufferIndex);
 static void audioEngineMixin(void* userData, Uint8* stream, int length);
+static void audioEngineMixSoundBuffer(AudioEngineSoundBuffer* soundBuffer, int* dest, int frames, bool audible);
+static bool audioEngineSkipFrames(AudioEngineSoundBuffer* soundBuffer, int frames, unsigned int* framePtr, bool looping);
+static bool audioEngineVoiceCompare(const AudioEngineVoice& a, const AudioEngineVoice& b);
+static void audioEngineMixPack(const int* src, Sint16* dest, int samples);
 
 static SDL_AudioSpec gAudioEngineSpec;
 static SDL_AudioDeviceID gAudioEngineDeviceId = -1;
 static AudioEngineSoundBuffer gAudioEngineSoundBuffers[AUDIO_ENGINE_SOUND_BUFFERS];
 
+// CE: Accumulator for mixing sound buffers with enough headroom to clamp
+// only once per block.
+alignas(16) static int gAudioEngineMixBuffer[AUDIO_ENGINE_MIX_BLOCK_FRAMES * AUDIO_ENGINE_OUTPUT_CHANNELS];
+
+// CE: Maximum number of sound buffers mixed at once.
+static std::atomic<int> gAudioEngineVoiceLimit(AUDIO_ENGINE_DEFAULT_VOICE_LIMIT);
+
+// CE: Number of voices mixed and virtualized in the last block.
+static std::atomic<int> gAudioEngineMixedVoices(0);
+static std::atomic<int> gAudioEngineVirtualVoices(0);
+
+// CE: Mixer callback timing, updated by audio thread only.
+static std::atomic<unsigned int> gAudioEngineMixCallbacks(0);
+static std::atomic<unsigned long long> gAudioEngineMixFrames(0);
+static std::atomic<unsigned long long> gAudioEngineMixTime(0);
+static std::atomic<unsigned int> gAudioEngineMixTimeHistogram[AUDIO_ENGINE_MIX_TIME_BUCKETS];
+
 static bool audioEngineIsInitialized()
 {
     return gAudioEngineDeviceId != -1;
@@ -44,65 +127,285 @@ static bool soundBufferIsValid(int soundBufferIndex)
     return soundBufferIndex >= 0 && soundBufferIndex < AUDIO_ENGINE_SOUND_BUFFERS;
 }
 
-static void audioEngineMixin(void* userData, Uint8* stream, int length)
+// Reads frame as 16-bit stereo.
+template <int bitsPerSample, int channels>
+static inline void audioEngineReadFrame(const void* data, unsigned int frame, int* left, int* right)
 {
-    memset(stream, gAudioEngineSpec.silence, length);
-
-    if (!gProgramIsActive) {
-        return;
+    if (bitsPerSample == 16) {
+        const Sint16* samples = (const Sint16*)data + frame * channels;
+        *left = samples[0];
+        *right = samples[channels - 1];
+    } else {
+        const Sint8* samples = (const Sint8*)data + frame * channels;
+        *left = samples[0] * 256;
+        *right = samples[channels - 1] * 256;
     }
+}
 
-    for (int index = 0; index < AUDIO_ENGINE_SOUND_BUFFERS; index++) {
-        AudioEngineSoundBuffer* soundBuffer = &(gAudioEngineSoundBuffers[index]);
-        std::lock_guard<std::recursive_mutex> lock(soundBuffer->mutex);
+// Mixes up to `frames` output frames of sound buffer into `dest` starting at
+// `*framePtr` source frame, resampling with linear interpolation. Returns
+// `false` when non-looping sound buffer reached its end.
+template <int bitsPerSample, int channels>
+static bool audioEngineMixFrames(AudioEngineSoundBuffer* soundBuffer, int* dest, int frames, unsigned int* framePtr, bool looping, int volume)
+{
+    const void* data = soundBuffer->data;
+    unsigned int frameCount = soundBuffer->frameCount;
+    unsigned int step = soundBuffer->step;
+    unsigned int frame = *framePtr;
+    unsigned int frac = soundBuffer->frac;
+    bool playing = true;
+
+    if (step == 0x10000 && frac == 0) {
+        // Same rate - copy source frames in runs up to the end of buffer.
+        while (frames > 0) {
+            int run = std::min(frames, (int)(frameCount - frame));
+            for (int index = 0; index < run; index++) {
+                int left;
+                int right;
+                audioEngineReadFrame<bitsPerSample, channels>(data, frame + index, &left, &right);
+                dest[0] += (left * volume) >> 7;
+                dest[1] += (right * volume) >> 7;
+                dest += 2;
+            }
 
-        if (soundBuffer->active && soundBuffer->playing) {
-            int srcFrameSize = soundBuffer->bitsPerSample / 8 * soundBuffer->channels;
+            frames -= run;
+            frame += run;
 
-            unsigned char buffer[1024];
-            int pos = 0;
-            while (pos < length) {
-                int remaining = length - pos;
-                if (remaining > sizeof(buffer)) {
-                    remaining = sizeof(buffer);
+            if (frame >= frameCount) {
+                if (looping) {
+                    frame = 0;
+                } else {
+                    playing = false;
+                    break;
                 }
+            }
+        }
+    } else {
+        while (frames > 0) {
+            unsigned int next = frame + 1;
+            if (next >= frameCount) {
+                next = looping ? 0 : frame;
+            }
 
-                // TODO: Make something better than frame-by-frame convertion.
-                SDL_AudioStreamPut(soundBuffer->stream, (unsigned char*)soundBuffer->data + soundBuffer->pos, srcFrameSize);
-                soundBuffer->pos += srcFrameSize;
-
-                int bytesRead = SDL_AudioStreamGet(soundBuffer->stream, buffer, remaining);
-                if (bytesRead == -1) {
+            int left0;
+            int right0;
+            audioEngineReadFrame<bitsPerSample, channels>(data, frame, &left0, &right0);
+
+            int left1;
+            int right1;
+            audioEngineReadFrame<bitsPerSample, channels>(data, next, &left1, &right1);
+
+            // Difference of full scale samples times fraction does not fit
+            // into int.
+            int left = left0 + (int)(((long long)(left1 - left0) * frac) >> 16);
+            int right = right0 + (int)(((long long)(right1 - right0) * frac) >> 16);
+            dest[0] += (left * volume) >> 7;
+            dest[1] += (right * volume) >> 7;
+            dest += 2;
+            frames--;
+
+            frac += step;
+            frame += frac >> 16;
+            frac &= 0xFFFF;
+
+            if (frame >= frameCount) {
+                if (looping) {
+                    frame %= frameCount;
+                } else {
+                    frac = 0;
+                    playing = false;
                     break;
                 }
+            }
+        }
+    }
 
-                SDL_MixAudioFormat(stream + pos, buffer, gAudioEngineSpec.format, bytesRead, soundBuffer->volume);
+    *framePtr = frame;
+    soundBuffer->frac = frac;
 
-                if (soundBuffer->pos >= soundBuffer->size) {
-                    if (soundBuffer->looping) {
-                        soundBuffer->pos %= soundBuffer->size;
-                    } else {
-                        soundBuffer->playing = false;
-                        break;
-                    }
-                }
+    return playing;
+}
+
+// Mixes block of sound buffer, or only advances its position when it's not
+// `audible`.
+static void audioEngineMixSoundBuffer(AudioEngineSoundBuffer* soundBuffer, int* dest, int frames, bool audible)
+{
+    unsigned int pos = soundBuffer->pos.load(std::memory_order_acquire);
+    bool looping = soundBuffer->looping.load(std::memory_order_relaxed);
+    int volume = soundBuffer->volume.load(std::memory_order_relaxed);
+
+    if (pos != soundBuffer->mixPos) {
+        soundBuffer->frac = 0;
+    }
+
+    unsigned int frame = pos / soundBuffer->frameSize;
+    bool playing = true;
+
+    if (frame >= soundBuffer->frameCount) {
+        if (looping && soundBuffer->frameCount != 0) {
+            frame %= soundBuffer->frameCount;
+        } else {
+            playing = false;
+        }
+    }
+
+    if (playing) {
+        if (audible) {
+            playing = soundBuffer->mixProc(soundBuffer, dest, frames, &frame, looping, volume);
+        } else {
+            playing = audioEngineSkipFrames(soundBuffer, frames, &frame, looping);
+        }
+    }
+
+    unsigned int newPos = playing ? frame * soundBuffer->frameSize : soundBuffer->size;
+
+    // Position might have been changed by game thread while this block was
+    // mixing, in this case game's position wins.
+    if (soundBuffer->pos.compare_exchange_strong(pos, newPos, std::memory_order_acq_rel)) {
+        soundBuffer->mixPos = newPos;
+
+        if (!playing) {
+            soundBuffer->playing.store(false, std::memory_order_release);
+        }
+    }
+}
+
+// Advances position of virtual voice the same way mixing would.
+static bool audioEngineSkipFrames(AudioEngineSoundBuffer* soundBuffer, int frames, unsigned int* framePtr, bool looping)
+{
+    unsigned long long advance = soundBuffer->frac + (unsigned long long)soundBuffer->step * frames;
+    unsigned long long frame = *framePtr + (advance >> 16);
+    soundBuffer->frac = (unsigned int)(advance & 0xFFFF);
+
+    if (frame >= soundBuffer->frameCount) {
+        if (!looping) {
+            soundBuffer->frac = 0;
+            return false;
+        }
+
+        frame %= soundBuffer->frameCount;
+    }
+
+    *framePtr = (unsigned int)frame;
+
+    return true;
+}
+
+// Orders voices by priority, then by volume.
+static bool audioEngineVoiceCompare(const AudioEngineVoice& a, const AudioEngineVoice& b)
+{
+    if (a.priority != b.priority) {
+        return a.priority > b.priority;
+    }
+
+    return a.volume > b.volume;
+}
+
+// Clamps accumulated samples to 16-bit.
+static void audioEngineMixPack(const int* src, Sint16* dest, int samples)
+{
+    int index = 0;
+
+#if defined(AUDIO_ENGINE_MIX_SSE2)
+    for (; index + 8 <= samples; index += 8) {
+        __m128i lo = _mm_load_si128((const __m128i*)(src + index));
+        __m128i hi = _mm_load_si128((const __m128i*)(src + index + 4));
+        _mm_storeu_si128((__m128i*)(dest + index), _mm_packs_epi32(lo, hi));
+    }
+#elif defined(AUDIO_ENGINE_MIX_NEON)
+    for (; index + 8 <= samples; index += 8) {
+        int16x4_t lo = vqmovn_s32(vld1q_s32(src + index));
+        int16x4_t hi = vqmovn_s32(vld1q_s32(src + index + 4));
+        vst1q_s16(dest + index, vcombine_s16(lo, hi));
+    }
+#endif
+
+    for (; index < samples; index++) {
+        dest[index] = (Sint16)std::min(std::max(src[index], -32768), 32767);
+    }
+}
+
+static void audioEngineMixin(void* userData, Uint8* stream, int length)
+{
+    if (!gProgramIsActive) {
+        memset(stream, gAudioEngineSpec.silence, length);
+        return;
+    }
 
-                pos += bytesRead;
+    Uint64 startTime = SDL_GetPerformanceCounter();
+
+    Sint16* dest = (Sint16*)stream;
+    int frames = length / (int)(sizeof(*dest) * AUDIO_ENGINE_OUTPUT_CHANNELS);
+    int totalFrames = frames;
+
+    while (frames > 0) {
+        int blockFrames = std::min(frames, AUDIO_ENGINE_MIX_BLOCK_FRAMES);
+        int blockSamples = blockFrames * AUDIO_ENGINE_OUTPUT_CHANNELS;
+
+        memset(gAudioEngineMixBuffer, 0, sizeof(*gAudioEngineMixBuffer) * blockSamples);
+
+        // Silent voices are virtual, audible ones compete for voice limit.
+        // Priority and volume are snapshotted once per block, they can be
+        // changed by the main thread while sorting.
+        AudioEngineVoice voices[AUDIO_ENGINE_SOUND_BUFFERS];
+        int voicesLength = 0;
+        int virtualVoices = 0;
+        for (int index = 0; index < AUDIO_ENGINE_SOUND_BUFFERS; index++) {
+            AudioEngineSoundBuffer* soundBuffer = &(gAudioEngineSoundBuffers[index]);
+            if (soundBuffer->active && soundBuffer->playing.load(std::memory_order_acquire)) {
+                int volume = soundBuffer->volume.load(std::memory_order_relaxed);
+                if (volume > 0) {
+                    AudioEngineVoice* voice = &(voices[voicesLength++]);
+                    voice->soundBuffer = index;
+                    voice->priority = soundBuffer->priority.load(std::memory_order_relaxed);
+                    voice->volume = volume;
+                } else {
+                    audioEngineMixSoundBuffer(soundBuffer, gAudioEngineMixBuffer, blockFrames, false);
+                    virtualVoices++;
+                }
             }
         }
+
+        int voiceLimit = gAudioEngineVoiceLimit.load(std::memory_order_relaxed);
+        if (voicesLength > voiceLimit) {
+            std::sort(voices, voices + voicesLength, audioEngineVoiceCompare);
+        } else {
+            voiceLimit = voicesLength;
+        }
+
+        for (int index = 0; index < voicesLength; index++) {
+            audioEngineMixSoundBuffer(&(gAudioEngineSoundBuffers[voices[index].soundBuffer]), gAudioEngineMixBuffer, blockFrames, index < voiceLimit);
+        }
+
+        gAudioEngineMixedVoices.store(voiceLimit, std::memory_order_relaxed);
+        gAudioEngineVirtualVoices.store(virtualVoices + voicesLength - voiceLimit, std::memory_order_relaxed);
+
+        audioEngineMixPack(gAudioEngineMixBuffer, dest, blockSamples);
+
+        dest += blockSamples;
+        frames -= blockFrames;
     }
+
+    Uint64 elapsed = (SDL_GetPerformanceCounter() - startTime) * 1000000 / SDL_GetPerformanceFrequency();
+    int bucket = histogramGetBucket(elapsed, AUDIO_ENGINE_MIX_TIME_BUCKET_WIDTH, AUDIO_ENGINE_MIX_TIME_BUCKETS);
+    gAudioEngineMixTimeHistogram[bucket].fetch_add(1, std::memory_order_relaxed);
+    gAudioEngineMixTime.fetch_add(elapsed, std::memory_order_relaxed);
+    gAudioEngineMixFrames.fetch_add(totalFrames, std::memory_order_relaxed);
+    gAudioEngineMixCallbacks.fetch_add(1, std::memory_order_relaxed);
 }
 
 bool audioEngineInit()
 {
     SDL_AudioSpec desiredSpec;
     desiredSpec.freq = 22050;
-    desiredSpec.format = AUDIO_S16;
-    desiredSpec.channels = 2;
+    desiredSpec.format = AUDIO_S16SYS;
+    desiredSpec.channels = AUDIO_ENGINE_OUTPUT_CHANNELS;
     desiredSpec.samples = 1024;
     desiredSpec.callback = audioEngineMixin;
 
-    gAudioEngineDeviceId = SDL_OpenAudioDevice(nullptr, 0, &desiredSpec, &gAudioEngineSpec, SDL_AUDIO_ALLOW_ANY_CHANGE);
+    // CE: Mixer produces 16-bit stereo only, let SDL convert format and
+    // channels if needed.
+    gAudioEngineDeviceId = SDL_OpenAudioDevice(nullptr, 0, &desiredSpec, &gAudioEngineSpec, SDL_AUDIO_ALLOW_FREQUENCY_CHANGE | SDL_AUDIO_ALLOW_SAMPLES_CHANGE);
     if (gAudioEngineDeviceId == -1) {
         return false;
     }
@@ -134,6 +437,55 @@ void audioEngineResume()
     }
 }
 
+void audioEngineSetVoiceLimit(int limit)
+{
+    gAudioEngineVoiceLimit.store(std::max(limit, 1), std::memory_order_relaxed);
+}
+
+// Returns number of voices mixed and virtualized in the last mixed block.
+void audioEngineGetVoiceStats(int* mixedPtr, int* virtualPtr)
+{
+    *mixedPtr = gAudioEngineMixedVoices.load(std::memory_order_relaxed);
+    *virtualPtr = gAudioEngineVirtualVoices.load(std::memory_order_relaxed);
+}
+
+// Returns mixer callback statistics accumulated since audio engine was
+// initialized. Callback times are in microseconds, p99 is rounded up to
+// histogram bucket width.
+void audioEngineGetMixStats(AudioEngineMixStats* stats)
+{
+    stats->callbacks = gAudioEngineMixCallbacks.load(std::memory_order_relaxed);
+    stats->frames = gAudioEngineMixFrames.load(std::memory_order_relaxed);
+    stats->time = gAudioEngineMixTime.load(std::memory_order_relaxed);
+    stats->rate = gAudioEngineSpec.freq;
+
+    unsigned int histogram[AUDIO_ENGINE_MIX_TIME_BUCKETS];
+    for (int bucket = 0; bucket < AUDIO_ENGINE_MIX_TIME_BUCKETS; bucket++) {
+        histogram[bucket] = gAudioEngineMixTimeHistogram[bucket].load(std::memory_order_relaxed);
+    }
+
+    stats->p99Time = histogramGetPercentile(histogram, AUDIO_ENGINE_MIX_TIME_BUCKETS, AUDIO_ENGINE_MIX_TIME_BUCKET_WIDTH, 99);
+}
+
+// Clears mixer callback statistics.
+void audioEngineResetMixStats()
+{
+    gAudioEngineMixCallbacks.store(0, std::memory_order_relaxed);
+    gAudioEngineMixFrames.store(0, std::memory_order_relaxed);
+    gAudioEngineMixTime.store(0, std::memory_order_relaxed);
+
+    for (int bucket = 0; bucket < AUDIO_ENGINE_MIX_TIME_BUCKETS; bucket++) {
+        gAudioEngineMixTimeHistogram[bucket].store(0, std::memory_order_relaxed);
+    }
+}
+
+// Mixes playing sound buffers into `stream` (16-bit stereo at device rate) the
+// same way audio device callback does. Audio device must be paused.
+void audioEngineMix(unsigned char* stream, int length)
+{
+    audioEngineMixin(nullptr, stream, length);
+}
+
 int audioEngineCreateSoundBuffer(unsigned int size, int bitsPerSample, int channels, int rate)
 {
     if (!audioEngineIsInitialized()) {
@@ -145,17 +497,33 @@ int audioEngineCreateSoundBuffer(unsigned int size, int bitsPerSample, int chann
         std::lock_guard<std::recursive_mutex> lock(soundBuffer->mutex);
 
         if (!soundBuffer->active) {
+            SDL_LockAudioDevice(gAudioEngineDeviceId);
+
             soundBuffer->active = true;
             soundBuffer->size = size;
             soundBuffer->bitsPerSample = bitsPerSample;
             soundBuffer->channels = channels;
             soundBuffer->rate = rate;
             soundBuffer->volume = SDL_MIX_MAXVOLUME;
+            soundBuffer->priority = AUDIO_ENGINE_SOUND_BUFFER_PRIORITY_DEFAULT;
             soundBuffer->playing = false;
             soundBuffer->looping = false;
             soundBuffer->pos = 0;
             soundBuffer->data = malloc(size);
-            soundBuffer->stream = SDL_NewAudioStream(bitsPerSample == 16 ? AUDIO_S16 : AUDIO_S8, channels, rate, gAudioEngineSpec.format, gAudioEngineSpec.channels, gAudioEngineSpec.freq);
+            soundBuffer->frameSize = bitsPerSample / 8 * channels;
+            soundBuffer->frameCount = size / soundBuffer->frameSize;
+            soundBuffer->step = (unsigned int)(((unsigned long long)rate << 16) / gAudioEngineSpec.freq);
+            soundBuffer->frac = 0;
+            soundBuffer->mixPos = 0;
+
+            if (bitsPerSample == 16) {
+                soundBuffer->mixProc = channels == 2 ? audioEngineMixFrames<16, 2> : audioEngineMixFrames<16, 1>;
+            } else {
+                soundBuffer->mixProc = channels == 2 ? audioEngineMixFrames<8, 2> : audioEngineMixFrames<8, 1>;
+            }
+
+            SDL_UnlockAudioDevice(gAudioEngineDeviceId);
+
             return index;
         }
     }
@@ -180,13 +548,14 @@ bool audioEngineSoundBufferRelease(int soundBufferIndex)
         return false;
     }
 
+    SDL_LockAudioDevice(gAudioEngineDeviceId);
+
     soundBuffer->active = false;
 
     free(soundBuffer->data);
     soundBuffer->data = nullptr;
 
-    SDL_FreeAudioStream(soundBuffer->stream);
-    soundBuffer->stream = nullptr;
+    SDL_UnlockAudioDevice(gAudioEngineDeviceId);
 
     return true;
 }
@@ -480,4 +849,26 @@ bool audioEngineSoundBufferGetStatus(int soundBufferIndex, unsigned int* statusP
     return true;
 }
 
+bool audioEngineSoundBufferSetPriority(int soundBufferIndex, int priority)
+{
+    if (!audioEngineIsInitialized()) {
+        return false;
+    }
+
+    if (!soundBufferIsValid(soundBufferIndex)) {
+        return false;
+    }
+
+    AudioEngineSoundBuffer* soundBuffer = &(gAudioEngineSoundBuffers[soundBufferIndex]);
+    std::lock_guard<std::recursive_mutex> lock(soundBuffer->mutex);
+
+    if (!soundBuffer->active) {
+        return false;
+    }
+
+    soundBuffer->priority = priority;
+
+    return true;
+}
+
 } // namespace fallout
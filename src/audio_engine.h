@@ -11,10 +11,29 @@ namespace fallout {
 #define AUDIO_ENGINE_SOUND_BUFFER_STATUS_PLAYING 0x00000001
 #define AUDIO_ENGINE_SOUND_BUFFER_STATUS_LOOPING 0x00000004
 
+// CE: Priority of sound buffers created without explicit priority. When more
+// sound buffers are playing than voice limit allows, the ones with higher
+// priority (then louder ones) are mixed, the rest keep playing silently.
+#define AUDIO_ENGINE_SOUND_BUFFER_PRIORITY_DEFAULT 0
+
+// CE: Mixer callback statistics.
+typedef struct AudioEngineMixStats {
+    unsigned int callbacks;
+    unsigned long long frames;
+    unsigned long long time;
+    unsigned int p99Time;
+    int rate;
+} AudioEngineMixStats;
+
 bool audioEngineInit();
 void audioEngineExit();
 void audioEnginePause();
 void audioEngineResume();
+void audioEngineSetVoiceLimit(int limit);
+void audioEngineGetVoiceStats(int* mixedPtr, int* virtualPtr);
+void audioEngineGetMixStats(AudioEngineMixStats* stats);
+void audioEngineResetMixStats();
+void audioEngineMix(unsigned char* stream, int length);
 int audioEngineCreateSoundBuffer(unsigned int size, int bitsPerSample, int channels, int rate);
 bool audioEngineSoundBufferRelease(int soundBufferIndex);
 bool audioEngineSoundBufferSetVolume(int soundBufferIndex, int volume);
@@ -27,6 +46,7 @@ bool audioEngineSoundBufferSetCurrentPosition(int soundBufferIndex, unsigned int
 bool audioEngineSoundBufferLock(int soundBufferIndex, unsigned int writePos, unsigned int writeBytes, void** audioPtr1, unsigned int* audioBytes1, void** audioPtr2, unsigned int* audioBytes2, unsigned int flags);
 bool audioEngineSoundBufferUnlock(int soundBufferIndex, void* audioPtr1, unsigned int audioBytes1, void* audioPtr2, unsigned int audioBytes2);
 bool audioEngineSoundBufferGetStatus(int soundBufferIndex, unsigned int* status);
+bool audioEngineSoundBufferSetPriority(int soundBufferIndex, int priority);
 
 } // namespace fallout
 
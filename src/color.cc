@@ -11,9 +11,29 @@
 
 namespace fallout {
 
+// CE: Number of derived color tables sets kept in memory, palette is switched
+// back and forth when playing movies, showing help and death screens.
+#define COLOR_TABLES_CACHE_CAPACITY 4
+
+// CE: Colors tables derived from palette and `_colorTable`.
+typedef struct ColorTablesCacheEntry {
+    unsigned char cmap[768];
+    unsigned char mappedColor[256];
+    unsigned long long colorTableHash;
+    unsigned int lastUsed;
+    Color intensityColorTable[256][256];
+    Color colorMixAddTable[256][256];
+    Color colorMixMulTable[256][256];
+} ColorTablesCacheEntry;
+
 static void _setIntensityTableColor(int a1);
 static void _setIntensityTables();
 static void _setMixTableColor(int a1);
+static void colorComponentsInit();
+static unsigned long long colorTableHash();
+static bool colorTablesCacheLoad(unsigned long long hash);
+static void colorTablesCacheSave(unsigned long long hash);
+static void colorTablesCacheFree();
 static void _buildBlendTable(unsigned char* ptr, unsigned char ch);
 static void _rebuildColorBlendTables();
 
@@ -73,6 +93,15 @@ Color colorMixMulTable[256][256];
 // 0x6A38D0
 unsigned char _colorTable[32768];
 
+// CE: 5-bit components of `_cmap` colors (as returned by `Color2RGB`),
+// prepared once per palette for building derived tables.
+static int gColorR[256];
+static int gColorG[256];
+static int gColorB[256];
+
+static ColorTablesCacheEntry* gColorTablesCache[COLOR_TABLES_CACHE_CAPACITY];
+static unsigned int gColorTablesCacheTimestamp = 0;
+
 // 0x4C72B4
 int _calculateColor(int intensity, Color color)
 {
@@ -167,26 +196,29 @@ void _setSystemPaletteEntries(unsigned char* palette, int start, int end)
 // 0x4C7550
 static void _setIntensityTableColor(int cc)
 {
-    int shift = 0;
+    int r = gColorR[cc];
+    int g = gColorG[cc];
+    int b = gColorB[cc];
 
+    // CE: Indexes into `_colorTable` are computed in a separate branchless
+    // loop which compiler vectorizes, lookups are done in a second pass.
+    int colorIndexes[256];
     for (int index = 0; index < 128; index++) {
-        int r = (Color2RGB(cc) & 0x7C00) >> 10;
-        int g = (Color2RGB(cc) & 0x3E0) >> 5;
-        int b = (Color2RGB(cc) & 0x1F);
+        int shift = index * 512;
 
         int darkerR = ((r * shift) >> 16);
         int darkerG = ((g * shift) >> 16);
         int darkerB = ((b * shift) >> 16);
-        int darkerColor = (darkerR << 10) | (darkerG << 5) | darkerB;
-        intensityColorTable[cc][index] = _colorTable[darkerColor];
+        colorIndexes[index] = (darkerR << 10) | (darkerG << 5) | darkerB;
 
         int lighterR = r + (((0x1F - r) * shift) >> 16);
         int lighterG = g + (((0x1F - g) * shift) >> 16);
         int lighterB = b + (((0x1F - b) * shift) >> 16);
-        int lighterColor = (lighterR << 10) | (lighterG << 5) | lighterB;
-        intensityColorTable[cc][128 + index] = _colorTable[lighterColor];
+        colorIndexes[128 + index] = (lighterR << 10) | (lighterG << 5) | lighterB;
+    }
 
-        shift += 512;
+    for (int index = 0; index < 256; index++) {
+        intensityColorTable[cc][index] = _colorTable[colorIndexes[index]];
     }
 }
 
@@ -205,87 +237,147 @@ static void _setIntensityTables()
 // 0x4C769C
 static void _setMixTableColor(int a1)
 {
-    int i;
-    int v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15, v16, v17, v18, v19;
-    int v20, v21, v22, v23, v24, v25, v26, v27, v28, v29;
-
-    for (i = 0; i < 256; i++) {
-        if (_mappedColor[a1] && _mappedColor[i]) {
-            v2 = (Color2RGB(a1) & 0x7C00) >> 10;
-            v3 = (Color2RGB(a1) & 0x3E0) >> 5;
-            v4 = (Color2RGB(a1) & 0x1F);
-
-            v5 = (Color2RGB(i) & 0x7C00) >> 10;
-            v6 = (Color2RGB(i) & 0x3E0) >> 5;
-            v7 = (Color2RGB(i) & 0x1F);
-
-            v8 = v2 + v5;
-            v9 = v3 + v6;
-            v10 = v4 + v7;
-
-            v11 = v8;
+    // CE: Mixing with unmapped color keeps the other color (or `a1` when both
+    // are unmapped).
+    if (!_mappedColor[a1]) {
+        for (int i = 0; i < 256; i++) {
+            int color = _mappedColor[i] ? i : a1;
+            colorMixAddTable[a1][i] = color;
+            colorMixMulTable[a1][i] = color;
+        }
+        return;
+    }
 
-            if (v9 > v11) {
-                v11 = v9;
-            }
+    // CE: Components of `a1` are the same for entire row.
+    int r = gColorR[a1];
+    int g = gColorG[a1];
+    int b = gColorB[a1];
+
+    // CE: Indexes into `_colorTable` for entire row are computed first in a
+    // branchless loop which compiler vectorizes, lookups are done in a second
+    // pass. Sums exceeding 0x1F are scaled down by the excess of the largest
+    // component and brightened back by the excess via intensity table.
+    int addIndexes[256];
+    int addExcesses[256];
+    int mulIndexes[256];
+    for (int i = 0; i < 256; i++) {
+        int addR = r + gColorR[i];
+        int addG = g + gColorG[i];
+        int addB = b + gColorB[i];
+
+        int excess = std::max(std::max(std::max(addR, addG), addB) - 0x1F, 0);
+        addR = std::max(addR - excess, 0);
+        addG = std::max(addG - excess, 0);
+        addB = std::max(addB - excess, 0);
+
+        addIndexes[i] = (addR << 10) | (addG << 5) | addB;
+        addExcesses[i] = excess;
+
+        int mulR = (r * gColorR[i]) >> 5;
+        int mulG = (g * gColorG[i]) >> 5;
+        int mulB = (b * gColorB[i]) >> 5;
+        mulIndexes[i] = (mulR << 10) | (mulG << 5) | mulB;
+    }
 
-            if (v10 > v11) {
-                v11 = v10;
+    for (int i = 0; i < 256; i++) {
+        if (_mappedColor[i]) {
+            int color = _colorTable[addIndexes[i]];
+            if (addExcesses[i] != 0) {
+                // CE: Original code uses floating point math, this is exact
+                // equivalent of `((v11 - 31) / 128 + 1) * 65536`.
+                color = _calculateColor(65536 + addExcesses[i] * 512, color);
             }
 
-            if (v11 <= 0x1F) {
-                int paletteIndex = (v8 << 10) | (v9 << 5) | v10;
-                v12 = _colorTable[paletteIndex];
-            } else {
-                v13 = v11 - 0x1F;
-
-                v14 = v8 - v13;
-                v15 = v9 - v13;
-                v16 = v10 - v13;
+            colorMixAddTable[a1][i] = color;
+            colorMixMulTable[a1][i] = _colorTable[mulIndexes[i]];
+        } else {
+            colorMixAddTable[a1][i] = a1;
+            colorMixMulTable[a1][i] = a1;
+        }
+    }
+}
 
-                if (v14 < 0) {
-                    v14 = 0;
-                }
+static void colorComponentsInit()
+{
+    for (int index = 0; index < 256; index++) {
+        int rgb = Color2RGB(index);
+        gColorR[index] = (rgb & 0x7C00) >> 10;
+        gColorG[index] = (rgb & 0x3E0) >> 5;
+        gColorB[index] = (rgb & 0x1F);
+    }
+}
 
-                if (v15 < 0) {
-                    v15 = 0;
-                }
+// Calculates FNV-1a hash of `_colorTable`.
+static unsigned long long colorTableHash()
+{
+    unsigned long long hash = 14695981039346656037ULL;
+    for (size_t index = 0; index < sizeof(_colorTable); index++) {
+        hash ^= _colorTable[index];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
 
-                if (v16 < 0) {
-                    v16 = 0;
-                }
+// Restores derived tables for current palette and `_colorTable` from cache.
+static bool colorTablesCacheLoad(unsigned long long hash)
+{
+    for (int index = 0; index < COLOR_TABLES_CACHE_CAPACITY; index++) {
+        ColorTablesCacheEntry* entry = gColorTablesCache[index];
+        if (entry != nullptr
+            && entry->colorTableHash == hash
+            && memcmp(entry->cmap, _cmap, sizeof(_cmap)) == 0
+            && memcmp(entry->mappedColor, _mappedColor, sizeof(_mappedColor)) == 0) {
+            memcpy(intensityColorTable, entry->intensityColorTable, sizeof(intensityColorTable));
+            memcpy(colorMixAddTable, entry->colorMixAddTable, sizeof(colorMixAddTable));
+            memcpy(colorMixMulTable, entry->colorMixMulTable, sizeof(colorMixMulTable));
+            entry->lastUsed = ++gColorTablesCacheTimestamp;
+            return true;
+        }
+    }
 
-                v17 = (v14 << 10) | (v15 << 5) | v16;
-                v18 = _colorTable[v17];
+    return false;
+}
 
-                v19 = (int)((((double)v11 + (-31.0)) * 0.0078125 + 1.0) * 65536.0);
-                v12 = _calculateColor(v19, v18);
-            }
+// Saves derived tables in cache evicting least recently used entry if needed.
+static void colorTablesCacheSave(unsigned long long hash)
+{
+    int entryIndex = 0;
+    for (int index = 0; index < COLOR_TABLES_CACHE_CAPACITY; index++) {
+        if (gColorTablesCache[index] == nullptr) {
+            entryIndex = index;
+            break;
+        }
 
-            colorMixAddTable[a1][i] = v12;
+        if (gColorTablesCache[index]->lastUsed < gColorTablesCache[entryIndex]->lastUsed) {
+            entryIndex = index;
+        }
+    }
 
-            v20 = (Color2RGB(a1) & 0x7C00) >> 10;
-            v21 = (Color2RGB(a1) & 0x3E0) >> 5;
-            v22 = (Color2RGB(a1) & 0x1F);
+    ColorTablesCacheEntry* entry = gColorTablesCache[entryIndex];
+    if (entry == nullptr) {
+        entry = (ColorTablesCacheEntry*)internal_malloc(sizeof(*entry));
+        if (entry == nullptr) {
+            return;
+        }
 
-            v23 = (Color2RGB(i) & 0x7C00) >> 10;
-            v24 = (Color2RGB(i) & 0x3E0) >> 5;
-            v25 = (Color2RGB(i) & 0x1F);
+        gColorTablesCache[entryIndex] = entry;
+    }
 
-            v26 = (v20 * v23) >> 5;
-            v27 = (v21 * v24) >> 5;
-            v28 = (v22 * v25) >> 5;
+    memcpy(entry->cmap, _cmap, sizeof(_cmap));
+    memcpy(entry->mappedColor, _mappedColor, sizeof(_mappedColor));
+    entry->colorTableHash = hash;
+    entry->lastUsed = ++gColorTablesCacheTimestamp;
+    memcpy(entry->intensityColorTable, intensityColorTable, sizeof(intensityColorTable));
+    memcpy(entry->colorMixAddTable, colorMixAddTable, sizeof(colorMixAddTable));
+    memcpy(entry->colorMixMulTable, colorMixMulTable, sizeof(colorMixMulTable));
+}
 
-            v29 = (v26 << 10) | (v27 << 5) | v28;
-            colorMixMulTable[a1][i] = _colorTable[v29];
-        } else {
-            if (_mappedColor[i]) {
-                colorMixAddTable[a1][i] = i;
-                colorMixMulTable[a1][i] = i;
-            } else {
-                colorMixAddTable[a1][i] = a1;
-                colorMixMulTable[a1][i] = a1;
-            }
+static void colorTablesCacheFree()
+{
+    for (int index = 0; index < COLOR_TABLES_CACHE_CAPACITY; index++) {
+        if (gColorTablesCache[index] != nullptr) {
+            internal_free(gColorTablesCache[index]);
+            gColorTablesCache[index] = nullptr;
         }
     }
 }
@@ -334,6 +426,8 @@ bool colorPaletteLoad(const char* path)
     // NOTE: Uninline.
     fileRead(_colorTable, 0x8000, 1, stream);
 
+    colorComponentsInit();
+
     unsigned int type;
     // NOTE: Uninline.
     fileRead(&type, sizeof(type), 1, stream);
@@ -350,10 +444,17 @@ bool colorPaletteLoad(const char* path)
         // NOTE: Uninline.
         fileRead(colorMixMulTable, sizeof(colorMixMulTable), 1, stream);
     } else {
-        _setIntensityTables();
+        // CE: Derived tables depend only on palette and `_colorTable`, reuse
+        // them when the same palette is loaded again.
+        unsigned long long hash = colorTableHash();
+        if (!colorTablesCacheLoad(hash)) {
+            _setIntensityTables();
+
+            for (int index = 0; index < 256; index++) {
+                _setMixTableColor(index);
+            }
 
-        for (int index = 0; index < 256; index++) {
-            _setMixTableColor(index);
+            colorTablesCacheSave(hash);
         }
     }
 
@@ -381,9 +482,9 @@ static void _buildBlendTable(unsigned char* ptr, unsigned char ch)
 
     beg = ptr;
 
-    r = (Color2RGB(ch) & 0x7C00) >> 10;
-    g = (Color2RGB(ch) & 0x3E0) >> 5;
-    b = (Color2RGB(ch) & 0x1F);
+    r = gColorR[ch];
+    g = gColorG[ch];
+    b = gColorB[ch];
 
     for (i = 0; i < 256; i++) {
         ptr[i] = i;
@@ -402,9 +503,9 @@ static void _buildBlendTable(unsigned char* ptr, unsigned char ch)
 
     for (j = 0; j < 7; j++) {
         for (i = 0; i < 256; i++) {
-            v12 = (Color2RGB(i) & 0x7C00) >> 10;
-            v14 = (Color2RGB(i) & 0x3E0) >> 5;
-            v16 = (Color2RGB(i) & 0x1F);
+            v12 = gColorR[i];
+            v14 = gColorG[i];
+            v16 = gColorB[i];
             int index = 0;
             index |= (r_2 + v12 * v31) / 7 << 10;
             index |= (g_2 + v14 * v31) / 7 << 5;
@@ -514,6 +615,8 @@ void _colorsClose()
     for (int index = 0; index < 256; index++) {
         _freeColorBlendTable(index);
     }
+
+    colorTablesCacheFree();
 }
 
 } // namespace fallout
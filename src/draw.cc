@@ -2,11 +2,42 @@
 
 #include <string.h>
 
+#include <vector>
+
 #include "color.h"
 #include "svga.h"
 
+#if defined(__SSE2__)
+#define DRAW_SSE2
+#include <emmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#define DRAW_NEON
+#include <arm_neon.h>
+#endif
+
 namespace fallout {
 
+// CE: Number of cached column maps used by stretch blitters.
+#define STRETCH_COLUMN_MAP_CACHE_CAPACITY 4
+
+// CE: Maps every destination column to source column for a given pair of
+// widths. `length` is the number of destination columns covered by stretch
+// (which might be less than destination width due to rounding).
+typedef struct StretchColumnMap {
+    int srcWidth;
+    int destWidth;
+    int length;
+    std::vector<int> columns;
+} StretchColumnMap;
+
+static StretchColumnMap* stretchColumnMapGet(int srcWidth, int destWidth);
+static void stretchRow(unsigned char* dest, const unsigned char* src, int srcWidth, const StretchColumnMap* columnMap);
+static void stretchRowTrans(unsigned char* dest, const unsigned char* src, int width);
+
+static StretchColumnMap gStretchColumnMaps[STRETCH_COLUMN_MAP_CACHE_CAPACITY];
+static int gStretchColumnMapsNext = 0;
+static std::vector<unsigned char> gStretchRowBuffer;
+
 // 0x4D2FC0
 void bufferDrawLine(unsigned char* buf, int pitch, int x1, int y1, int x2, int y2, int color)
 {
@@ -151,26 +182,24 @@ void bufferDrawRectShadowed(unsigned char* buf, int pitch, int left, int top, in
 // 0x4D33F0
 void blitBufferToBufferStretch(unsigned char* src, int srcWidth, int srcHeight, int srcPitch, unsigned char* dest, int destWidth, int destHeight, int destPitch)
 {
-    int stepX = (destWidth << 16) / srcWidth;
     int stepY = (destHeight << 16) / srcHeight;
 
+    // CE: Every source row is stretched once into its first destination row,
+    // which is then duplicated.
+    StretchColumnMap* columnMap = stretchColumnMapGet(srcWidth, destWidth);
+
     for (int srcY = 0; srcY < srcHeight; srcY += 1) {
         int startDestY = (srcY * stepY) >> 16;
         int endDestY = ((srcY + 1) * stepY) >> 16;
+        if (startDestY == endDestY) {
+            continue;
+        }
 
-        unsigned char* currSrc = src + srcPitch * srcY;
-        for (int srcX = 0; srcX < srcWidth; srcX += 1) {
-            int startDestX = (srcX * stepX) >> 16;
-            int endDestX = ((srcX + 1) * stepX) >> 16;
-
-            for (int destY = startDestY; destY < endDestY; destY += 1) {
-                unsigned char* currDest = dest + destPitch * destY + startDestX;
-                for (int destX = startDestX; destX < endDestX; destX += 1) {
-                    *currDest++ = *currSrc;
-                }
-            }
+        unsigned char* currDest = dest + destPitch * startDestY;
+        stretchRow(currDest, src + srcPitch * srcY, srcWidth, columnMap);
 
-            currSrc++;
+        for (int destY = startDestY + 1; destY < endDestY; destY += 1) {
+            memcpy(dest + destPitch * destY, currDest, columnMap->length);
         }
     }
 }
@@ -178,28 +207,28 @@ void blitBufferToBufferStretch(unsigned char* src, int srcWidth, int srcHeight,
 // 0x4D3560
 void blitBufferToBufferStretchTrans(unsigned char* src, int srcWidth, int srcHeight, int srcPitch, unsigned char* dest, int destWidth, int destHeight, int destPitch)
 {
-    int stepX = (destWidth << 16) / srcWidth;
     int stepY = (destHeight << 16) / srcHeight;
 
+    // CE: Every source row is stretched once into temporary row, which is
+    // then copied to all its destination rows skipping transparent pixels.
+    StretchColumnMap* columnMap = stretchColumnMapGet(srcWidth, destWidth);
+    if (gStretchRowBuffer.size() < (size_t)columnMap->length) {
+        gStretchRowBuffer.resize(columnMap->length);
+    }
+
+    unsigned char* row = gStretchRowBuffer.data();
+
     for (int srcY = 0; srcY < srcHeight; srcY += 1) {
         int startDestY = (srcY * stepY) >> 16;
         int endDestY = ((srcY + 1) * stepY) >> 16;
+        if (startDestY == endDestY) {
+            continue;
+        }
 
-        unsigned char* currSrc = src + srcPitch * srcY;
-        for (int srcX = 0; srcX < srcWidth; srcX += 1) {
-            int startDestX = (srcX * stepX) >> 16;
-            int endDestX = ((srcX + 1) * stepX) >> 16;
+        stretchRow(row, src + srcPitch * srcY, srcWidth, columnMap);
 
-            if (*currSrc != 0) {
-                for (int destY = startDestY; destY < endDestY; destY += 1) {
-                    unsigned char* currDest = dest + destPitch * destY + startDestX;
-                    for (int destX = startDestX; destX < endDestX; destX += 1) {
-                        *currDest++ = *currSrc;
-                    }
-                }
-            }
-
-            currSrc++;
+        for (int destY = startDestY; destY < endDestY; destY += 1) {
+            stretchRowTrans(dest + destPitch * destY, row, columnMap->length);
         }
     }
 }
@@ -339,4 +368,163 @@ void transSrcCopy(unsigned char* dest, int destPitch, unsigned char* src, int sr
     }
 }
 
+// Returns column map for stretching `srcWidth` to `destWidth`, building it
+// if needed.
+static StretchColumnMap* stretchColumnMapGet(int srcWidth, int destWidth)
+{
+    for (int index = 0; index < STRETCH_COLUMN_MAP_CACHE_CAPACITY; index++) {
+        StretchColumnMap* columnMap = &(gStretchColumnMaps[index]);
+        if (columnMap->srcWidth == srcWidth && columnMap->destWidth == destWidth) {
+            return columnMap;
+        }
+    }
+
+    StretchColumnMap* columnMap = &(gStretchColumnMaps[gStretchColumnMapsNext]);
+    gStretchColumnMapsNext = (gStretchColumnMapsNext + 1) % STRETCH_COLUMN_MAP_CACHE_CAPACITY;
+
+    // Same fixed-point ranges as the original per-pixel loops.
+    int stepX = (destWidth << 16) / srcWidth;
+
+    columnMap->srcWidth = srcWidth;
+    columnMap->destWidth = destWidth;
+    columnMap->length = (srcWidth * stepX) >> 16;
+    columnMap->columns.resize(columnMap->length);
+
+    for (int srcX = 0; srcX < srcWidth; srcX += 1) {
+        int startDestX = (srcX * stepX) >> 16;
+        int endDestX = ((srcX + 1) * stepX) >> 16;
+        for (int destX = startDestX; destX < endDestX; destX += 1) {
+            columnMap->columns[destX] = srcX;
+        }
+    }
+
+    return columnMap;
+}
+
+// Stretches one row using column map, with fast paths for 1x, 2x, 3x and 4x
+// integer ratios.
+static void stretchRow(unsigned char* dest, const unsigned char* src, int srcWidth, const StretchColumnMap* columnMap)
+{
+    int ratio = columnMap->length == columnMap->destWidth && columnMap->destWidth % srcWidth == 0
+        ? columnMap->destWidth / srcWidth
+        : 0;
+
+    int srcX = 0;
+
+    switch (ratio) {
+    case 1:
+        memcpy(dest, src, srcWidth);
+        return;
+    case 2:
+#if defined(DRAW_SSE2)
+        for (; srcX + 16 <= srcWidth; srcX += 16) {
+            __m128i pixels = _mm_loadu_si128((const __m128i*)(src + srcX));
+            _mm_storeu_si128((__m128i*)(dest + srcX * 2), _mm_unpacklo_epi8(pixels, pixels));
+            _mm_storeu_si128((__m128i*)(dest + srcX * 2 + 16), _mm_unpackhi_epi8(pixels, pixels));
+        }
+#elif defined(DRAW_NEON)
+        for (; srcX + 16 <= srcWidth; srcX += 16) {
+            uint8x16_t pixels = vld1q_u8(src + srcX);
+            uint8x16x2_t pairs = { { pixels, pixels } };
+            vst2q_u8(dest + srcX * 2, pairs);
+        }
+#endif
+        for (; srcX < srcWidth; srcX++) {
+            dest[srcX * 2] = src[srcX];
+            dest[srcX * 2 + 1] = src[srcX];
+        }
+        return;
+    case 3:
+#if defined(DRAW_NEON)
+        for (; srcX + 16 <= srcWidth; srcX += 16) {
+            uint8x16_t pixels = vld1q_u8(src + srcX);
+            uint8x16x3_t triples = { { pixels, pixels, pixels } };
+            vst3q_u8(dest + srcX * 3, triples);
+        }
+#else
+        // Four source pixels make three 32-bit words.
+        for (; srcX + 4 <= srcWidth; srcX += 4) {
+            unsigned int p0 = src[srcX];
+            unsigned int p1 = src[srcX + 1];
+            unsigned int p2 = src[srcX + 2];
+            unsigned int p3 = src[srcX + 3];
+            unsigned char words[12] = {
+                (unsigned char)p0,
+                (unsigned char)p0,
+                (unsigned char)p0,
+                (unsigned char)p1,
+                (unsigned char)p1,
+                (unsigned char)p1,
+                (unsigned char)p2,
+                (unsigned char)p2,
+                (unsigned char)p2,
+                (unsigned char)p3,
+                (unsigned char)p3,
+                (unsigned char)p3,
+            };
+            memcpy(dest + srcX * 3, words, 12);
+        }
+#endif
+        for (; srcX < srcWidth; srcX++) {
+            memset(dest + srcX * 3, src[srcX], 3);
+        }
+        return;
+    case 4:
+#if defined(DRAW_SSE2)
+        for (; srcX + 16 <= srcWidth; srcX += 16) {
+            __m128i pixels = _mm_loadu_si128((const __m128i*)(src + srcX));
+            __m128i lo = _mm_unpacklo_epi8(pixels, pixels);
+            __m128i hi = _mm_unpackhi_epi8(pixels, pixels);
+            _mm_storeu_si128((__m128i*)(dest + srcX * 4), _mm_unpacklo_epi16(lo, lo));
+            _mm_storeu_si128((__m128i*)(dest + srcX * 4 + 16), _mm_unpackhi_epi16(lo, lo));
+            _mm_storeu_si128((__m128i*)(dest + srcX * 4 + 32), _mm_unpacklo_epi16(hi, hi));
+            _mm_storeu_si128((__m128i*)(dest + srcX * 4 + 48), _mm_unpackhi_epi16(hi, hi));
+        }
+#elif defined(DRAW_NEON)
+        for (; srcX + 16 <= srcWidth; srcX += 16) {
+            uint8x16_t pixels = vld1q_u8(src + srcX);
+            uint8x16x4_t quads = { { pixels, pixels, pixels, pixels } };
+            vst4q_u8(dest + srcX * 4, quads);
+        }
+#endif
+        for (; srcX < srcWidth; srcX++) {
+            memset(dest + srcX * 4, src[srcX], 4);
+        }
+        return;
+    }
+
+    const int* columns = columnMap->columns.data();
+    for (int destX = 0; destX < columnMap->length; destX++) {
+        dest[destX] = src[columns[destX]];
+    }
+}
+
+// Copies row skipping transparent (zero) pixels.
+static void stretchRowTrans(unsigned char* dest, const unsigned char* src, int width)
+{
+    int x = 0;
+
+#if defined(DRAW_SSE2)
+    __m128i zero = _mm_setzero_si128();
+    for (; x + 16 <= width; x += 16) {
+        __m128i pixels = _mm_loadu_si128((const __m128i*)(src + x));
+        __m128i mask = _mm_cmpeq_epi8(pixels, zero);
+        __m128i background = _mm_loadu_si128((const __m128i*)(dest + x));
+        _mm_storeu_si128((__m128i*)(dest + x), _mm_or_si128(_mm_and_si128(mask, background), _mm_andnot_si128(mask, pixels)));
+    }
+#elif defined(DRAW_NEON)
+    for (; x + 16 <= width; x += 16) {
+        uint8x16_t pixels = vld1q_u8(src + x);
+        uint8x16_t mask = vceqq_u8(pixels, vdupq_n_u8(0));
+        vst1q_u8(dest + x, vbslq_u8(mask, vld1q_u8(dest + x), pixels));
+    }
+#endif
+
+    for (; x < width; x++) {
+        if (src[x] != 0) {
+            dest[x] = src[x];
+        }
+    }
+}
+
 } // namespace fallout
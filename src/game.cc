@@ -28,6 +28,7 @@
 #include "game_sound.h"
 #include "input.h"
 #include "interface.h"
+#include "interpreter.h"
 #include "inventory.h"
 #include "item.h"
 #include "kb.h"
@@ -45,6 +46,7 @@
 #include "pipboy.h"
 #include "platform_compat.h"
 #include "preferences.h"
+#include "profiler.h"
 #include "proto.h"
 #include "queue.h"
 #include "random.h"
@@ -183,6 +185,14 @@ int gameInitWithOptions(const char* windowTitle, bool isMapper, int font, int a4
         _debug_register_func(_win_debug);
     }
 
+    // CE: Frame profiler (configured in `debug` section).
+    profilerInit();
+
+    // CE: Scripts scheduling and CPU accounting.
+    interpreterSetTimeBudget(settings.system.script_time_budget);
+    interpreterSetStatsEnabled(settings.debug.script_stats);
+    interpreterSetProfilerEnabled(settings.debug.script_profiler);
+
     interfaceFontsInit();
     fontManagerAdd(&gModernFontManager);
     fontSetCurrent(font);
@@ -435,6 +445,19 @@ void gameExit()
 {
     debugPrint("\nGame Exit\n");
 
+    profilerExit();
+
+    if (settings.debug.script_stats) {
+        interpreterDumpStats();
+    }
+
+    if (settings.debug.script_profiler) {
+        const char* path = settings.debug.script_profiler_output.c_str();
+        if (!interpreterWriteProfile(path)) {
+            debugPrint("Script profiler: failed to write %s\n", path);
+        }
+    }
+
     // SFALL
     sfall_gl_scr_exit();
     sfallArraysExit();
@@ -941,6 +964,14 @@ int gameHandleKey(int eventCode, bool isInCombatMode)
     case KEY_ARROW_DOWN:
         mapScroll(0, 1);
         break;
+    case KEY_CTRL_F11:
+        // CE: Dump script CPU times to debug log.
+        interpreterDumpStats();
+        break;
+    case KEY_CTRL_F12:
+        // CE: Toggle frame profiler overlay.
+        profilerToggleOverlay();
+        break;
     }
 
     return 0;
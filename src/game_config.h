@@ -29,6 +29,12 @@ namespace fallout {
 #define GAME_CONFIG_SPLASH_KEY "splash"
 #define GAME_CONFIG_FREE_SPACE_KEY "free_space"
 #define GAME_CONFIG_TIMES_RUN_KEY "times_run"
+#define GAME_CONFIG_SCRIPT_TIME_BUDGET_KEY "script_time_budget"
+#define GAME_CONFIG_CRITTER_PROC_QUOTA_KEY "critter_proc_quota"
+#define GAME_CONFIG_CRITTER_PROC_PRIORITY_KEY "critter_proc_priority"
+#define GAME_CONFIG_CRITTER_PROC_MAX_DISTANCE_KEY "critter_proc_max_distance"
+#define GAME_CONFIG_MAP_UPDATE_FRAMES_KEY "map_update_frames"
+#define GAME_CONFIG_MOVIE_DECODE_AHEAD_KEY "movie_decode_ahead"
 #define GAME_CONFIG_GAME_DIFFICULTY_KEY "game_difficulty"
 #define GAME_CONFIG_RUNNING_BURNING_GUY_KEY "running_burning_guy"
 #define GAME_CONFIG_COMBAT_DIFFICULTY_KEY "combat_difficulty"
@@ -60,6 +66,8 @@ namespace fallout {
 #define GAME_CONFIG_SNDFX_VOLUME_KEY "sndfx_volume"
 #define GAME_CONFIG_SPEECH_VOLUME_KEY "speech_volume"
 #define GAME_CONFIG_CACHE_SIZE_KEY "cache_size"
+#define GAME_CONFIG_PCM_CACHE_SIZE_KEY "pcm_cache_size"
+#define GAME_CONFIG_MAX_VOICES_KEY "max_voices"
 #define GAME_CONFIG_MUSIC_PATH1_KEY "music_path1"
 #define GAME_CONFIG_MUSIC_PATH2_KEY "music_path2"
 #define GAME_CONFIG_DEBUG_SFXC_KEY "debug_sfxc"
@@ -68,6 +76,11 @@ namespace fallout {
 #define GAME_CONFIG_SHOW_SCRIPT_MESSAGES_KEY "show_script_messages"
 #define GAME_CONFIG_SHOW_LOAD_INFO_KEY "show_load_info"
 #define GAME_CONFIG_OUTPUT_MAP_DATA_INFO_KEY "output_map_data_info"
+#define GAME_CONFIG_PROFILER_KEY "profiler"
+#define GAME_CONFIG_PROFILER_OUTPUT_KEY "profiler_output"
+#define GAME_CONFIG_SCRIPT_STATS_KEY "script_stats"
+#define GAME_CONFIG_SCRIPT_PROFILER_KEY "script_profiler"
+#define GAME_CONFIG_SCRIPT_PROFILER_OUTPUT_KEY "script_profiler_output"
 #define GAME_CONFIG_EXECUTABLE_KEY "executable"
 #define GAME_CONFIG_OVERRIDE_LIBRARIAN_KEY "override_librarian"
 #define GAME_CONFIG_LIBRARIAN_KEY "librarian"
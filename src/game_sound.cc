@@ -6,6 +6,7 @@
 #include "animation.h"
 #include "art.h"
 #include "audio.h"
+#include "audio_engine.h"
 #include "audio_file.h"
 #include "combat.h"
 #include "debug.h"
@@ -233,6 +234,9 @@ int gameSoundInit()
         return -1;
     }
 
+    // CE: Bound number of sounds mixed at once.
+    audioEngineSetVoiceLimit(settings.sound.max_voices);
+
     if (gGameSoundDebugEnabled) {
         debugPrint("success.\n");
     }
@@ -628,6 +632,8 @@ int backgroundSoundLoad(const char* fileName, int a2, int a3, int a4)
         return -1;
     }
 
+    soundSetPriority(gBackgroundSound, GAME_SOUND_PRIORITY_MUSIC);
+
     rc = soundSetFileIO(gBackgroundSound, audioFileOpen, audioFileClose, audioFileRead, nullptr, audioFileSeek, gameSoundFileTellNotImplemented, audioFileGetSize);
     if (rc != 0) {
         if (gGameSoundDebugEnabled) {
@@ -640,6 +646,10 @@ int backgroundSoundLoad(const char* fileName, int a2, int a3, int a4)
         return -1;
     }
 
+    // CE: Music is read with stdio (not database), it can be decoded ahead by
+    // streaming thread.
+    soundSetFileIOThreadSafe(gBackgroundSound, true);
+
     rc = soundSetChannels(gBackgroundSound, 3);
     if (rc != 0) {
         if (gGameSoundDebugEnabled) {
@@ -901,6 +911,8 @@ int speechLoad(const char* fname, int a2, int a3, int a4)
         return -1;
     }
 
+    soundSetPriority(gSpeechSound, GAME_SOUND_PRIORITY_SPEECH);
+
     if (soundSetFileIO(gSpeechSound, audioOpen, audioClose, audioRead, nullptr, audioSeek, gameSoundFileTellNotImplemented, audioGetSize)) {
         if (gGameSoundDebugEnabled) {
             debugPrint("failed because file IO could not be set for compression.\n");
@@ -2028,6 +2040,8 @@ Sound* _gsound_get_sound_ready_for_effect()
         return nullptr;
     }
 
+    soundSetPriority(sound, GAME_SOUND_PRIORITY_EFFECT);
+
     if (soundEffectsCacheInitialized()) {
         rc = soundSetFileIO(sound, soundEffectsCacheFileOpen, soundEffectsCacheFileClose, soundEffectsCacheFileRead, soundEffectsCacheFileWrite, soundEffectsCacheFileSeek, soundEffectsCacheFileTell, soundEffectsCacheFileLength);
     } else {
@@ -32,6 +32,14 @@ typedef enum CharacterSoundEffect {
     CHARACTER_SOUND_EFFECT_CONTACT,
 } CharacterSoundEffect;
 
+// CE: Voice priorities of game sounds. When too many sounds are playing at
+// once the ones with lower priority are virtualized first.
+typedef enum GameSoundPriority {
+    GAME_SOUND_PRIORITY_EFFECT = 0,
+    GAME_SOUND_PRIORITY_MUSIC = 1,
+    GAME_SOUND_PRIORITY_SPEECH = 2,
+} GameSoundPriority;
+
 typedef void(SoundEndCallback)();
 
 extern int gMusicVolume;
@@ -8,17 +8,33 @@
 
 namespace fallout {
 
+// CE: Number of nodes allocated at once when free list is exhausted.
+#define RECT_LIST_BLOCK_SIZE 64
+
+// CE: Rect list nodes are allocated in blocks which are only released in
+// `_GNW_rect_exit`.
+typedef struct RectListBlock {
+    RectListNode nodes[RECT_LIST_BLOCK_SIZE];
+    struct RectListBlock* next;
+} RectListBlock;
+
+static bool rectsCanBeMerged(const Rect* a, const Rect* b, Rect* merged);
+
 // 0x51DEF4
 static RectListNode* _rectList = nullptr;
 
+static RectListBlock* gRectListBlocks = nullptr;
+
 // 0x4C6900
 void _GNW_rect_exit()
 {
-    while (_rectList != nullptr) {
-        RectListNode* next = _rectList->next;
-        internal_free(_rectList);
-        _rectList = next;
+    while (gRectListBlocks != nullptr) {
+        RectListBlock* next = gRectListBlocks->next;
+        internal_free(gRectListBlocks);
+        gRectListBlocks = next;
     }
+
+    _rectList = nullptr;
 }
 
 // 0x4C6924
@@ -167,14 +183,16 @@ RectListNode* rect_clip(Rect* b, Rect* t)
 RectListNode* _rect_malloc()
 {
     if (_rectList == nullptr) {
-        for (int index = 0; index < 10; index++) {
-            RectListNode* rectListNode = (RectListNode*)internal_malloc(sizeof(*rectListNode));
-            if (rectListNode == nullptr) {
-                break;
+        // CE: Original code allocates 10 nodes one by one.
+        RectListBlock* block = (RectListBlock*)internal_malloc(sizeof(*block));
+        if (block != nullptr) {
+            block->next = gRectListBlocks;
+            gRectListBlocks = block;
+
+            for (int index = 0; index < RECT_LIST_BLOCK_SIZE; index++) {
+                // NOTE: Uninline.
+                _rect_free(&(block->nodes[index]));
             }
-
-            // NOTE: Uninline.
-            _rect_free(rectListNode);
         }
     }
 
@@ -195,6 +213,49 @@ void _rect_free(RectListNode* rectListNode)
     _rectList = rectListNode;
 }
 
+// Joins adjacent rectangles in the list which together form a rectangle.
+//
+// Clipping against overlapping windows splits refreshed area into a number of
+// small bands, merging them back reduces number of blits.
+void rectListMerge(RectListNode** rectListNodePtr)
+{
+    bool merged;
+    do {
+        merged = false;
+
+        for (RectListNode* curr = *rectListNodePtr; curr != nullptr; curr = curr->next) {
+            RectListNode** nextPtr = &(curr->next);
+            while (*nextPtr != nullptr) {
+                RectListNode* next = *nextPtr;
+                if (rectsCanBeMerged(&(curr->rect), &(next->rect), &(curr->rect))) {
+                    *nextPtr = next->next;
+                    _rect_free(next);
+                    merged = true;
+                } else {
+                    nextPtr = &(next->next);
+                }
+            }
+        }
+    } while (merged);
+}
+
+static bool rectsCanBeMerged(const Rect* a, const Rect* b, Rect* merged)
+{
+    if (a->top == b->top && a->bottom == b->bottom
+        && (a->right + 1 == b->left || b->right + 1 == a->left)) {
+        rectUnion(a, b, merged);
+        return true;
+    }
+
+    if (a->left == b->left && a->right == b->right
+        && (a->bottom + 1 == b->top || b->bottom + 1 == a->top)) {
+        rectUnion(a, b, merged);
+        return true;
+    }
+
+    return false;
+}
+
 // Calculates a union of two source rectangles and places it into result
 // rectangle.
 //
@@ -30,6 +30,7 @@ void _rect_clip_list(RectListNode** rectListNodePtr, Rect* rect);
 RectListNode* rect_clip(Rect* b, Rect* t);
 RectListNode* _rect_malloc();
 void _rect_free(RectListNode* entry);
+void rectListMerge(RectListNode** rectListNodePtr);
 void rectUnion(const Rect* s1, const Rect* s2, Rect* r);
 int rectIntersection(const Rect* a1, const Rect* a2, Rect* a3);
 
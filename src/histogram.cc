@@ -0,0 +1,41 @@
+#include "histogram.h"
+
+namespace fallout {
+
+// Returns index of the bucket `value` falls into.
+int histogramGetBucket(unsigned long long value, unsigned int bucketWidth, int bucketsLength)
+{
+    unsigned long long bucket = value / bucketWidth;
+    if (bucket >= static_cast<unsigned long long>(bucketsLength)) {
+        return bucketsLength - 1;
+    }
+
+    return static_cast<int>(bucket);
+}
+
+// Returns upper bound of the first bucket at which given percentile of
+// samples is reached, or 0 if histogram is empty.
+unsigned int histogramGetPercentile(const unsigned int* buckets, int bucketsLength, unsigned int bucketWidth, int percentile)
+{
+    unsigned long long total = 0;
+    for (int bucket = 0; bucket < bucketsLength; bucket++) {
+        total += buckets[bucket];
+    }
+
+    if (total == 0) {
+        return 0;
+    }
+
+    unsigned long long threshold = total - total * (100 - percentile) / 100;
+    unsigned long long count = 0;
+    for (int bucket = 0; bucket < bucketsLength; bucket++) {
+        count += buckets[bucket];
+        if (count >= threshold) {
+            return static_cast<unsigned int>(bucket + 1) * bucketWidth;
+        }
+    }
+
+    return static_cast<unsigned int>(bucketsLength) * bucketWidth;
+}
+
+} // namespace fallout
@@ -0,0 +1,13 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+namespace fallout {
+
+// CE: Helpers for histograms of durations with buckets of equal width, the
+// last bucket collects everything above.
+int histogramGetBucket(unsigned long long value, unsigned int bucketWidth, int bucketsLength);
+unsigned int histogramGetPercentile(const unsigned int* buckets, int bucketsLength, unsigned int bucketWidth, int percentile);
+
+} // namespace fallout
+
+#endif /* HISTOGRAM_H */
@@ -10,6 +10,7 @@
 #include "kb.h"
 #include "memory.h"
 #include "mouse.h"
+#include "profiler.h"
 #include "svga.h"
 #include "text_font.h"
 #include "touch.h"
@@ -185,7 +186,10 @@ void _process_bk()
 {
     int v1;
 
-    tickersExecute();
+    {
+        ProfilerScope profilerScope(PROFILER_SECTION_TICKERS);
+        tickersExecute();
+    }
 
     _mouse_info();
 
@@ -1,12 +1,20 @@
 #include "interpreter.h"
 
 #include <assert.h>
+#include <ctype.h>
 #include <limits.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+
 #include "db.h"
 #include "debug.h"
 #include "export.h"
@@ -19,6 +27,206 @@
 
 namespace fallout {
 
+// CE: Maximum number of instructions decoded at once by
+// `programCodeTranslate`.
+#define PROGRAM_CODE_MAX_BLOCK_LENGTH 1024
+
+// CE: Maximum number of problems reported by bytecode verifier per script.
+#define PROGRAM_VERIFY_MAX_REPORTED_ERRORS 8
+
+// CE: Value on bytecode verifier stack which is not known at load time.
+#define PROGRAM_VERIFY_UNKNOWN_VALUE LLONG_MIN
+
+// CE: Dispatch decoded instructions with computed goto where supported.
+#if defined(__GNUC__)
+#define INTERPRETER_COMPUTED_GOTO
+#endif
+
+// CE: Kinds of decoded instructions. Invalid instructions are decoded as well
+// and report errors only when executed, same as the original interpreter.
+typedef enum ProgramInstructionKind {
+    PROGRAM_INSTRUCTION_HANDLER,
+    PROGRAM_INSTRUCTION_PUSH,
+    PROGRAM_INSTRUCTION_BAD_OPCODE,
+    PROGRAM_INSTRUCTION_UNDEFINED_OPCODE,
+    PROGRAM_INSTRUCTION_OUT_OF_RANGE,
+    PROGRAM_INSTRUCTION_KIND_COUNT,
+} ProgramInstructionKind;
+
+// CE: Instruction decoded from big-endian bytecode.
+typedef struct ProgramInstruction {
+    OpcodeHandler* handler;
+
+    // Offsets of this and the following instruction in program data.
+    int address;
+    int nextAddress;
+
+    // Operand of `push`.
+    int operand;
+
+    // Opcode as stored in upper half of program flags.
+    int flags;
+    opcode_t opcode;
+    unsigned char kind;
+} ProgramInstruction;
+
+// CE: Decoded instruction stream of a program.
+//
+// Program data interleaves code with procedure and string tables, so code is
+// decoded in straight-line blocks starting at entry points (the beginning of
+// the data, procedure bodies, and any other address upon first execution).
+// Scripts keep using data offsets as addresses (procedure offsets, jump
+// targets, return addresses), which are mapped to decoded instructions with
+// `addressMap`.
+typedef struct ProgramCode {
+    int size;
+    std::vector<ProgramInstruction> instructions;
+
+    // Index of instruction decoded at given data offset plus one, or zero.
+    std::vector<int> addressMap;
+} ProgramCode;
+
+// CE: Bytecode loaded from script file. Program data is never modified except
+// for procedure table, so it's loaded once and shared by every instance of the
+// script (with each instance having its own copy of procedure table).
+typedef struct ProgramImage {
+    std::string key;
+    unsigned char* data;
+    int size;
+    int refCount;
+    ProgramCode* code;
+
+    // Procedure indexes by lower case procedure name.
+    std::unordered_map<std::string, int> procedureIndexes;
+
+    // Indexes of procedures requested with `programGetProcedureIndexes`.
+    const char* const* procedureTableNames;
+    std::vector<int> procedureTable;
+
+    // Number of problems found in code by `programCodeVerify`.
+    int verificationErrors;
+} ProgramImage;
+
+// CE: Number of free block size classes in dynamic strings heap. Free blocks
+// are classified by the highest bit of their length.
+#define PROGRAM_STRING_HEAP_SIZE_CLASSES 16
+
+// CE: Maximum length of dynamic strings heap block (block length is short).
+#define PROGRAM_STRING_HEAP_MAX_BLOCK_LENGTH 32766
+
+// CE: Initial allocation size of dynamic strings heap.
+#define PROGRAM_STRING_HEAP_INITIAL_CAPACITY 256
+
+// CE: Maximum number of too small free blocks examined in the first size
+// class before falling back to larger size classes.
+#define PROGRAM_STRING_HEAP_FIRST_CLASS_LOOKUP_LIMIT 16
+
+#define PROGRAM_STRING_HEAP_ENTRY_EMPTY (-1)
+#define PROGRAM_STRING_HEAP_ENTRY_DELETED (-2)
+
+typedef struct ProgramStringHeapEntry {
+    // Offset of block or one of `PROGRAM_STRING_HEAP_ENTRY_*`.
+    int offset;
+    unsigned int hash;
+} ProgramStringHeapEntry;
+
+// CE: Bookkeeping of program dynamic strings heap.
+//
+// The heap layout is unchanged: a sequence of blocks (length, reference
+// count, string) terminated with 0x8000 length, free blocks have negative
+// length. Offsets below are offsets of block headers from the beginning of
+// the heap, string offsets handed to scripts are 4 bytes further. Blocks never
+// move, so handed offsets stay valid while referenced.
+typedef struct ProgramStringHeap {
+    // Allocated size of `dynamicStrings`.
+    int capacity;
+
+    // Open addressing hash table of allocated blocks by string contents.
+    std::vector<ProgramStringHeapEntry> entries;
+    int entriesCount;
+    int deletedEntriesCount;
+
+    // Free blocks by size class. Blocks can be merged or reused after being
+    // added, so entries are validated when taken.
+    std::vector<int> freeLists[PROGRAM_STRING_HEAP_SIZE_CLASSES];
+    size_t freeListLimits[PROGRAM_STRING_HEAP_SIZE_CLASSES];
+
+    // Marks beginnings of blocks (by offset / 2).
+    std::vector<unsigned char> blockStarts;
+
+    // Blocks allocated or released by last reference since the last
+    // `programMarkHeap`.
+    std::vector<int> unreferencedBlocks;
+} ProgramStringHeap;
+
+// CE: Maximum depth of nested `_interpret` calls tracked by CPU accounting.
+#define PROGRAM_STATS_STACK_SIZE 32
+
+// CE: CPU time spent in procedure of a script.
+typedef struct ProgramProcedureStats {
+    unsigned int slices;
+    long long time;
+    long long maxTime;
+
+    // Collected by script profiler (in nanoseconds).
+    unsigned int calls;
+    long long inclusiveTime;
+    long long exclusiveTime;
+} ProgramProcedureStats;
+
+// CE: CPU time spent in a script, accumulated over every instance (and every
+// load) of the script. Times are in microseconds and exclusive (time spent in
+// other scripts called from this one is accounted to them).
+typedef struct ProgramStats {
+    std::string name;
+    unsigned int slices;
+    long long time;
+    long long maxTime;
+
+    // By procedure index, time of slice is accounted to procedure being
+    // executed at the beginning of slice.
+    std::vector<ProgramProcedureStats> procedures;
+    std::vector<std::string> procedureNames;
+} ProgramStats;
+
+// CE: Running `_interpret` call tracked by CPU accounting.
+typedef struct ProgramStatsSlice {
+    ProgramStats* stats;
+    int procedureIndex;
+
+    // Number of script profiler frames when slice began.
+    size_t profilerFrames;
+
+    // Beginning of the last interval executed by this slice (it's paused
+    // while nested slices are running).
+    long long start;
+    long long time;
+} ProgramStatsSlice;
+
+// CE: Procedure activation tracked by script profiler. Activations begin
+// with `_interpret` (procedure being executed at that moment) and script
+// calls, and end with returns (detected by return stack going below its size
+// at the time of call) or end of `_interpret`.
+typedef struct ScriptProfilerFrame {
+    Program* program;
+    ProgramStats* stats;
+    int procedureIndex;
+    size_t returnDepth;
+    int node;
+    long long start;
+    long long childTime;
+} ScriptProfilerFrame;
+
+// CE: Node of script profiler call tree.
+typedef struct ScriptProfilerNode {
+    int parent;
+    ProgramStats* stats;
+    int procedureIndex;
+
+    // Exclusive time (in nanoseconds).
+    long long time;
+} ScriptProfilerNode;
+
 typedef struct ProgramListNode {
     Program* program;
     struct ProgramListNode* next; // next
@@ -44,8 +252,33 @@ static opcode_t programReturnStackPopInt16(Program* program);
 static int programReturnStackPopInt32(Program* program);
 static void _detachProgram(Program* program);
 static void _purgeProgram(Program* program);
-static opcode_t _getOp(Program* program);
+static ProgramImage* programImageAcquire(const char* path);
+static void programImageRelease(ProgramImage* image);
+static int programImageGetProceduresSize(const ProgramImage* image);
+static void programImageIndexProcedures(ProgramImage* image);
+static const char* programImageValidate(unsigned char* data, int size);
+static void programFoldProcedureName(const char* name, std::string& folded);
+static ProgramCode* programCodeCreate(Program* program, int size);
+static int programCodeTranslate(Program* program, int address);
+static int programCodeLookup(Program* program, int address);
+static bool programCodeIsBlockEnd(opcode_t opcode);
+static bool programCodeGetStackEffect(opcode_t opcode, int* popsPtr, int* pushesPtr);
+static long long programCodeVerifyPop(std::vector<long long>& stack);
+static void programCodeVerify(Program* program);
+static void programCodeVerifyError(Program* program, int procedureIndex, const char* format, ...);
+static void programExecute(Program* program, int a2);
 static void programMarkHeap(Program* program);
+static void programStringHeapInit(Program* program);
+static unsigned int programStringHash(const char* string);
+static int programStringHeapGetSizeClass(int length);
+static int programStringHeapFind(Program* program, const char* string, unsigned int hash);
+static void programStringHeapAddEntry(ProgramStringHeap* heap, int offset, unsigned int hash);
+static void programStringHeapRemoveEntry(Program* program, int offset);
+static bool programStringHeapIsFreeBlock(Program* program, int offset);
+static int programStringHeapMergeFreeBlocks(Program* program, int offset);
+static void programStringHeapAddFreeBlock(Program* program, int offset, int length);
+static int programStringHeapAllocate(Program* program, int length);
+static void programStringHeapFree(Program* program, int offset);
 static void opNoop(Program* program);
 static void opPush(Program* program);
 static void opPushBase(Program* program);
@@ -128,6 +361,18 @@ static void _setupExternalCall(Program* program1, Program* program2, int address
 static void _doEvents();
 static void programListNodeFree(ProgramListNode* programListNode);
 static void interpreterPrintStats();
+static long long interpreterGetMicroseconds();
+static bool programIsRunnable(Program* program);
+static void programStatsSliceBegin(Program* program);
+static void programStatsSliceEnd();
+static int programGetProcedureAt(Program* program, int address);
+static long long interpreterGetNanoseconds();
+static void scriptProfilerExecuteHandler(Program* program, OpcodeHandler* handler, opcode_t opcode);
+static void scriptProfilerPushFrame(Program* program);
+static void scriptProfilerPopFrame();
+static const char* scriptProfilerGetScriptName(const ProgramStats* stats);
+static const char* scriptProfilerGetProcedureName(const ProgramStats* stats, int procedureIndex);
+static void scriptProfilerWriteFoldedStack(FILE* stream, int node);
 
 // 0x50942C
 static char _aCouldnTFindPro[] = "<couldn't find proc>";
@@ -166,6 +411,43 @@ static ProgramListNode* gInterpreterProgramListHead;
 // 0x59E794
 static int _suspendEvents;
 
+// CE: Loaded bytecode images by normalized script path.
+static std::unordered_map<std::string, ProgramImage*> gProgramImages;
+
+// CE: Wall time given to scripts per frame (in microseconds), or 0 to run
+// fixed bursts of instructions (original behaviour).
+static long long gInterpreterTimeBudget = 0;
+
+// CE: End of scripts time budget of the current frame.
+static long long gInterpreterTimeBudgetEnd = 0;
+
+// CE: Program to resume with when previous frame ran out of time budget.
+static ProgramListNode* gInterpreterScheduleNext = nullptr;
+
+// CE: Number of frames which ran out of time budget.
+static unsigned int gInterpreterTimeBudgetOverruns = 0;
+
+static bool gProgramStatsEnabled = false;
+
+// CE: Accumulated script CPU times by script name.
+static std::unordered_map<std::string, ProgramStats> gProgramStats;
+
+static ProgramStatsSlice gProgramStatsStack[PROGRAM_STATS_STACK_SIZE];
+static int gProgramStatsStackSize = 0;
+
+static bool gScriptProfilerEnabled = false;
+
+// CE: Number of executions and total time (in nanoseconds, including
+// anything run by handler) by opcode.
+static unsigned long long gScriptProfilerOpcodeCounts[OPCODE_MAX_COUNT];
+static long long gScriptProfilerOpcodeTimes[OPCODE_MAX_COUNT];
+
+static std::vector<ScriptProfilerFrame> gScriptProfilerFrames;
+static std::vector<ScriptProfilerNode> gScriptProfilerNodes;
+
+// CE: Call tree nodes by parent node, script, and procedure.
+static std::map<std::tuple<int, ProgramStats*, int>, int> gScriptProfilerNodeIndexes;
+
 // 0x59E798
 static int _busy;
 
@@ -227,8 +509,12 @@ int _interpretOutput(const char* format, ...)
 // 0x467160
 static char* programGetCurrentProcedureName(Program* program)
 {
-    int procedureCount = stackReadInt32(program->procedures, 0);
-    unsigned char* ptr = program->procedures + 4;
+    // CE: Read procedure table from shared data rather than program copy,
+    // the loop below reads one entry past the end of the table (into
+    // identifiers). Names and body offsets are never updated.
+    unsigned char* procedures = program->data + 42;
+    int procedureCount = stackReadInt32(procedures, 0);
+    unsigned char* ptr = procedures + 4;
 
     int procedureOffset = stackReadInt32(ptr, offsetof(Procedure, bodyOffset));
     int identifierOffset = stackReadInt32(ptr, offsetof(Procedure, nameOffset));
@@ -386,6 +672,12 @@ void _interpretDecStringRef(Program* program, opcode_t opcode, int value)
 
         if (*refcountPtr != 0) {
             *refcountPtr -= 1;
+
+            // CE: Block is released in `programMarkHeap` unless referenced
+            // again.
+            if (*refcountPtr == 0 && program->stringHeap != nullptr) {
+                program->stringHeap->unreferencedBlocks.push_back(value - 4);
+            }
         } else {
             debugPrint("Reference count zero for %s!\n", string);
         }
@@ -446,8 +738,14 @@ void programFree(Program* program)
         internal_free_safe(program->dynamicStrings, __FILE__, __LINE__); // "..\\int\\INTRPRET.C", 429
     }
 
-    if (program->data != nullptr) {
-        internal_free_safe(program->data, __FILE__, __LINE__); // "..\\int\\INTRPRET.C", 430
+    // CE: Program data is owned by shared image, only procedure table is
+    // owned by the program.
+    if (program->procedures != nullptr) {
+        internal_free_safe(program->procedures, __FILE__, __LINE__);
+    }
+
+    if (program->image != nullptr) {
+        programImageRelease(program->image);
     }
 
     if (program->name != nullptr) {
@@ -456,6 +754,7 @@ void programFree(Program* program)
 
     delete program->stackValues;
     delete program->returnStackValues;
+    delete program->stringHeap;
 
     internal_free_safe(program, __FILE__, __LINE__); // "..\\int\\INTRPRET.C", 435
 }
@@ -463,55 +762,568 @@ void programFree(Program* program)
 // 0x467734
 Program* programCreateByPath(const char* path)
 {
-    File* stream = fileOpen(path, "rb");
-    if (stream == nullptr) {
-        char err[260];
-        snprintf(err, sizeof(err), "Couldn't open %s for read\n", path);
-        programFatalError(err);
+    // CE: Bytecode is loaded once and shared by every instance of the script.
+    ProgramImage* image = programImageAcquire(path);
+    if (image == nullptr) {
         return nullptr;
     }
 
-    int fileSize = fileGetSize(stream);
-    unsigned char* data = (unsigned char*)internal_malloc_safe(fileSize, __FILE__, __LINE__); // ..\\int\\INTRPRET.C, 458
-
-    fileRead(data, 1, fileSize, stream);
-    fileClose(stream);
-
     Program* program = (Program*)internal_malloc_safe(sizeof(Program), __FILE__, __LINE__); // ..\\int\\INTRPRET.C, 463
     memset(program, 0, sizeof(Program));
 
     program->name = (char*)internal_malloc_safe(strlen(path) + 1, __FILE__, __LINE__); // ..\\int\\INTRPRET.C, 466
     strcpy(program->name, path);
 
+    // CE: Procedure table is updated by timed and conditional procedure
+    // calls, so every instance gets its own copy.
+    int proceduresSize = programImageGetProceduresSize(image);
+    unsigned char* procedures = (unsigned char*)internal_malloc_safe(proceduresSize, __FILE__, __LINE__);
+    memcpy(procedures, image->data + 42, proceduresSize);
+
     program->child = nullptr;
     program->parent = nullptr;
     program->field_78 = -1;
     program->exited = false;
     program->basePointer = -1;
     program->framePointer = -1;
-    program->data = data;
-    program->procedures = data + 42;
-    program->identifiers = 24 * stackReadInt32(program->procedures, 0) + program->procedures + 4;
+    program->image = image;
+    program->data = image->data;
+    program->procedures = procedures;
+    program->identifiers = image->data + 42 + proceduresSize;
     program->staticStrings = program->identifiers + stackReadInt32(program->identifiers, 0) + 4;
 
     program->stackValues = new ProgramStack();
     program->returnStackValues = new ProgramStack();
 
+    // CE: Decode program entry points up front (once per image).
+    if (image->code == nullptr) {
+        image->code = programCodeCreate(program, image->size);
+        programCodeVerify(program);
+    }
+    program->code = image->code;
+
     return program;
 }
 
-// NOTE: Inlined.
+// CE: Returns bytecode image of given script file, loading it if needed.
+static ProgramImage* programImageAcquire(const char* path)
+{
+    std::string key(path);
+    for (char& ch : key) {
+        ch = tolower(static_cast<unsigned char>(ch));
+        if (ch == '/') {
+            ch = '\\';
+        }
+    }
+
+    auto it = gProgramImages.find(key);
+    if (it != gProgramImages.end()) {
+        it->second->refCount++;
+        return it->second;
+    }
+
+    File* stream = fileOpen(path, "rb");
+    if (stream == nullptr) {
+        char err[260];
+        snprintf(err, sizeof(err), "Couldn't open %s for read\n", path);
+        programFatalError(err);
+        return nullptr;
+    }
+
+    int fileSize = fileGetSize(stream);
+    unsigned char* data = (unsigned char*)internal_malloc_safe(fileSize, __FILE__, __LINE__); // ..\\int\\INTRPRET.C, 458
+
+    fileRead(data, 1, fileSize, stream);
+    fileClose(stream);
+
+    // CE: Reject scripts with tables not fitting in the file, they would be
+    // read out of bounds. Scripts are loaded outside of `_interpret` as well,
+    // so this is not a fatal error (callers handle failed load).
+    const char* problem = programImageValidate(data, fileSize);
+    if (problem != nullptr) {
+        internal_free_safe(data, __FILE__, __LINE__);
+
+        debugPrint("\nMalformed script %s: %s\n", path, problem);
+        return nullptr;
+    }
+
+    ProgramImage* image = new ProgramImage();
+    image->key = key;
+    image->data = data;
+    image->size = fileSize;
+    image->refCount = 1;
+    image->code = nullptr;
+    image->procedureTableNames = nullptr;
+    image->verificationErrors = 0;
+
+    programImageIndexProcedures(image);
+
+    gProgramImages[key] = image;
+
+    return image;
+}
+
+// CE: Releases reference to bytecode image, image is unloaded when the last
+// instance of the script is freed.
+static void programImageRelease(ProgramImage* image)
+{
+    image->refCount--;
+    if (image->refCount > 0) {
+        return;
+    }
+
+    gProgramImages.erase(image->key);
+
+    internal_free_safe(image->data, __FILE__, __LINE__); // "..\\int\\INTRPRET.C", 430
+    delete image->code;
+    delete image;
+}
+
+// CE: Returns size of procedure table (including procedure count).
+static int programImageGetProceduresSize(const ProgramImage* image)
+{
+    return 4 + sizeof(Procedure) * stackReadInt32(image->data, 42);
+}
+
+// CE: Builds procedure name index. When several procedures have the same
+// name, the first one is found (same as the linear search).
+static void programImageIndexProcedures(ProgramImage* image)
+{
+    unsigned char* procedures = image->data + 42;
+    unsigned char* identifiers = procedures + programImageGetProceduresSize(image);
+    int procedureCount = stackReadInt32(procedures, 0);
+
+    std::string name;
+    unsigned char* ptr = procedures + 4;
+    for (int index = 0; index < procedureCount; index++) {
+        int identifierOffset = stackReadInt32(ptr, offsetof(Procedure, nameOffset));
+        programFoldProcedureName((char*)(identifiers + identifierOffset), name);
+        image->procedureIndexes.emplace(name, index);
+
+        ptr += sizeof(Procedure);
+    }
+}
+
+// CE: Checks procedure table and identifiers of script file fit in its data.
+// Returns description of the problem or `nullptr`.
+static const char* programImageValidate(unsigned char* data, int size)
+{
+    if (size < 42 + 4) {
+        return "file is too short";
+    }
+
+    int procedureCount = stackReadInt32(data, 42);
+    long long identifiersOffset = 42 + 4 + static_cast<long long>(sizeof(Procedure)) * procedureCount;
+    if (procedureCount < 0 || identifiersOffset + 4 > size) {
+        return "procedure table is out of bounds";
+    }
+
+    int identifiersLength = stackReadInt32(data, static_cast<int>(identifiersOffset));
+    if (identifiersLength < 0 || identifiersOffset + 4 + identifiersLength > size) {
+        return "identifiers are out of bounds";
+    }
+
+    unsigned char* ptr = data + 42 + 4;
+    for (int index = 0; index < procedureCount; index++) {
+        int nameOffset = stackReadInt32(ptr, offsetof(Procedure, nameOffset));
+        if (nameOffset < 4 || nameOffset >= identifiersLength + 4) {
+            return "procedure name is out of bounds";
+        }
+
+        int nameStart = static_cast<int>(identifiersOffset) + nameOffset;
+        if (memchr(data + nameStart, '\0', size - nameStart) == nullptr) {
+            return "procedure name is not terminated";
+        }
+
+        ptr += sizeof(Procedure);
+    }
+
+    return nullptr;
+}
+
+// CE: Converts procedure name to the form used as procedure index key.
+static void programFoldProcedureName(const char* name, std::string& folded)
+{
+    folded.assign(name);
+    for (char& ch : folded) {
+        ch = tolower(static_cast<unsigned char>(ch));
+    }
+}
+
+// CE: Creates instruction stream for program data of given size and decodes
+// the beginning of the data and bodies of every procedure.
+static ProgramCode* programCodeCreate(Program* program, int size)
+{
+    ProgramCode* code = new ProgramCode();
+    code->size = size;
+    code->addressMap.resize(size);
+    program->code = code;
+
+    if (size > 0) {
+        programCodeLookup(program, 0);
+    }
+
+    int procedureCount = stackReadInt32(program->procedures, 0);
+    unsigned char* ptr = program->procedures + 4;
+    for (int index = 0; index < procedureCount; index++) {
+        int flags = stackReadInt32(ptr, offsetof(Procedure, flags));
+        int bodyOffset = stackReadInt32(ptr, offsetof(Procedure, bodyOffset));
+        if ((flags & PROCEDURE_FLAG_IMPORTED) == 0 && bodyOffset >= 0 && bodyOffset < size) {
+            programCodeLookup(program, bodyOffset);
+        }
+
+        ptr += sizeof(Procedure);
+    }
+
+    return code;
+}
+
+// CE: Decodes instructions starting at given data offset until the end of
+// straight-line code, an invalid instruction, or an already decoded
+// instruction. Returns index of the first decoded instruction.
+static int programCodeTranslate(Program* program, int address)
+{
+    ProgramCode* code = program->code;
+    int first = static_cast<int>(code->instructions.size());
+
+    int pos = address;
+    for (int length = 0; length < PROGRAM_CODE_MAX_BLOCK_LENGTH; length++) {
+        if (pos >= code->size || (length != 0 && code->addressMap[pos] != 0)) {
+            break;
+        }
+
+        ProgramInstruction instruction;
+        instruction.handler = nullptr;
+        instruction.address = pos;
+        instruction.nextAddress = pos + 2;
+        instruction.operand = 0;
+        instruction.flags = 0;
+        instruction.opcode = 0;
+        instruction.kind = PROGRAM_INSTRUCTION_OUT_OF_RANGE;
+
+        if (pos + 2 <= code->size) {
+            opcode_t opcode = stackReadInt16(program->data, pos);
+            instruction.flags = opcode << 16;
+            instruction.opcode = opcode;
+
+            if (!((opcode >> 8) & 0x80)) {
+                instruction.kind = PROGRAM_INSTRUCTION_BAD_OPCODE;
+            } else {
+                unsigned int opcodeIndex = opcode & 0x3FF;
+                OpcodeHandler* handler = opcodeIndex < OPCODE_MAX_COUNT ? gInterpreterOpcodeHandlers[opcodeIndex] : nullptr;
+                if (handler == nullptr) {
+                    instruction.kind = PROGRAM_INSTRUCTION_UNDEFINED_OPCODE;
+                } else if (handler == opPush) {
+                    if (pos + 6 <= code->size) {
+                        instruction.kind = PROGRAM_INSTRUCTION_PUSH;
+                        instruction.operand = stackReadInt32(program->data, pos + 2);
+                        instruction.nextAddress = pos + 6;
+                    }
+                } else {
+                    instruction.kind = PROGRAM_INSTRUCTION_HANDLER;
+                    instruction.handler = handler;
+                }
+            }
+        }
+
+        code->addressMap[pos] = static_cast<int>(code->instructions.size()) + 1;
+        code->instructions.push_back(instruction);
+
+        if (instruction.kind != PROGRAM_INSTRUCTION_HANDLER && instruction.kind != PROGRAM_INSTRUCTION_PUSH) {
+            break;
+        }
+
+        if (programCodeIsBlockEnd(instruction.opcode)) {
+            break;
+        }
+
+        pos = instruction.nextAddress;
+    }
+
+    return first;
+}
+
+// CE: Returns index of instruction at given data offset, decoding it if
+// needed.
+static int programCodeLookup(Program* program, int address)
+{
+    ProgramCode* code = program->code;
+    if (address < 0 || address >= code->size) {
+        programFatalError("Instruction pointer %d out of range.", address);
+    }
+
+    int index = code->addressMap[address];
+    if (index != 0) {
+        return index - 1;
+    }
+
+    return programCodeTranslate(program, address);
+}
+
+// CE: Returns `true` if given opcode never continues to the next instruction.
+static bool programCodeIsBlockEnd(opcode_t opcode)
+{
+    switch (0x8000 | (opcode & 0x3FF)) {
+    case OPCODE_JUMP:
+    case OPCODE_CALL:
+    case OPCODE_EXIT:
+    case OPCODE_EXIT_PROGRAM:
+    case OPCODE_STOP_PROGRAM:
+    case OPCODE_POP_RETURN:
+    case OPCODE_POP_EXIT:
+    case OPCODE_POP_FLAGS_RETURN:
+    case OPCODE_POP_FLAGS_EXIT:
+    case OPCODE_POP_FLAGS_RETURN_EXTERN:
+    case OPCODE_POP_FLAGS_EXIT_EXTERN:
+    case OPCODE_POP_FLAGS_RETURN_VAL_EXTERN:
+    case OPCODE_POP_FLAGS_RETURN_VAL_EXIT:
+    case OPCODE_POP_FLAGS_RETURN_VAL_EXIT_EXTERN:
+        return true;
+    }
+
+    return false;
+}
+
+// CE: Obtains number of values given opcode pops from data stack and pushes
+// back. Returns `false` when it is not known (library functions, opcodes
+// moving values between stacks).
+static bool programCodeGetStackEffect(opcode_t opcode, int* popsPtr, int* pushesPtr)
+{
+    switch (0x8000 | (opcode & 0x3FF)) {
+    case OPCODE_NOOP:
+    case OPCODE_ENTER_CRITICAL_SECTION:
+    case OPCODE_LEAVE_CRITICAL_SECTION:
+    case OPCODE_START_CRITICAL:
+    case OPCODE_END_CRITICAL:
+        *popsPtr = 0;
+        *pushesPtr = 0;
+        return true;
+    case OPCODE_POP:
+        *popsPtr = 1;
+        *pushesPtr = 0;
+        return true;
+    case OPCODE_FETCH_GLOBAL:
+    case OPCODE_FETCH:
+    case OPCODE_FETCH_EXTERNAL:
+    case OPCODE_BITWISE_NOT:
+    case OPCODE_FLOOR:
+    case OPCODE_NOT:
+    case OPCODE_NEGATE:
+        *popsPtr = 1;
+        *pushesPtr = 1;
+        return true;
+    case OPCODE_STORE_GLOBAL:
+    case OPCODE_STORE:
+    case OPCODE_STORE_EXTERNAL:
+        *popsPtr = 2;
+        *pushesPtr = 0;
+        return true;
+    case OPCODE_EQUAL:
+    case OPCODE_NOT_EQUAL:
+    case OPCODE_LESS_THAN_EQUAL:
+    case OPCODE_GREATER_THAN_EQUAL:
+    case OPCODE_LESS_THAN:
+    case OPCODE_GREATER_THAN:
+    case OPCODE_ADD:
+    case OPCODE_SUB:
+    case OPCODE_MUL:
+    case OPCODE_DIV:
+    case OPCODE_MOD:
+    case OPCODE_AND:
+    case OPCODE_OR:
+    case OPCODE_BITWISE_AND:
+    case OPCODE_BITWISE_OR:
+    case OPCODE_BITWISE_XOR:
+        *popsPtr = 2;
+        *pushesPtr = 1;
+        return true;
+    }
+
+    return false;
+}
+
+// CE: Pops value from bytecode verifier stack, values below its bottom are
+// not known.
+static long long programCodeVerifyPop(std::vector<long long>& stack)
+{
+    if (stack.empty()) {
+        return PROGRAM_VERIFY_UNKNOWN_VALUE;
+    }
+
+    long long value = stack.back();
+    stack.pop_back();
+    return value;
+}
+
+// CE: Walks code reachable from program entry points (the beginning of the
+// data, procedure bodies and conditions, and targets of `jump`s, `if`s and
+// `while`s) and reports undefined opcodes, truncated instructions, and jumps
+// and calls out of range or into the middle of an instruction. Walked code is
+// decoded up front.
 //
-// 0x4678BC
-opcode_t _getOp(Program* program)
+// Jump targets and called procedures are followed when they are known at load
+// time. Data stack is tracked from the beginning of every walk through pushes,
+// variable accesses and operators, so targets pushed before a condition are
+// found. Values produced by other opcodes (library functions) are unknown,
+// targets depending on them are not followed.
+//
+// Problems are reported once when script file is loaded, they are left to be
+// handled by the interpreter if the code is actually executed (the original
+// game scripts contain unreachable invalid code, so such scripts can't be
+// rejected).
+static void programCodeVerify(Program* program)
 {
-    int instructionPointer;
+    ProgramCode* code = program->code;
+    int procedureCount = stackReadInt32(program->procedures, 0);
 
-    instructionPointer = program->instructionPointer;
-    program->instructionPointer = instructionPointer + 2;
+    // 0 - not walked, 1 - beginning of instruction, 2 - inside instruction.
+    std::vector<unsigned char> state(code->size, 0);
 
-    // NOTE: Uninline.
-    return stackReadInt16(program->data, instructionPointer);
+    // Addresses to walk and procedures they belong to.
+    std::vector<std::pair<int, int>> pending;
+    pending.push_back(std::make_pair(0, -1));
+
+    unsigned char* ptr = program->procedures + 4;
+    for (int index = 0; index < procedureCount; index++) {
+        int flags = stackReadInt32(ptr, offsetof(Procedure, flags));
+        if ((flags & PROCEDURE_FLAG_IMPORTED) == 0) {
+            pending.push_back(std::make_pair(stackReadInt32(ptr, offsetof(Procedure, bodyOffset)), index));
+
+            if ((flags & PROCEDURE_FLAG_CONDITIONAL) != 0) {
+                pending.push_back(std::make_pair(stackReadInt32(ptr, offsetof(Procedure, conditionOffset)), index));
+            }
+        }
+
+        ptr += sizeof(Procedure);
+    }
+
+    while (!pending.empty()) {
+        int address = pending.back().first;
+        int procedureIndex = pending.back().second;
+        pending.pop_back();
+
+        if (address < 0 || address >= code->size) {
+            programCodeVerifyError(program, procedureIndex, "address %d is out of range", address);
+            continue;
+        }
+
+        std::vector<long long> stack;
+
+        while (state[address] != 1) {
+            if (state[address] == 2) {
+                programCodeVerifyError(program, procedureIndex, "address %d is inside instruction", address);
+                break;
+            }
+
+            ProgramInstruction instruction = code->instructions[programCodeLookup(program, address)];
+
+            state[address] = 1;
+            for (int pos = address + 1; pos < instruction.nextAddress && pos < code->size; pos++) {
+                state[pos] = 2;
+            }
+
+            if (instruction.kind == PROGRAM_INSTRUCTION_BAD_OPCODE) {
+                programCodeVerifyError(program, procedureIndex, "bad opcode %x at %d", instruction.opcode, address);
+                break;
+            }
+
+            if (instruction.kind == PROGRAM_INSTRUCTION_UNDEFINED_OPCODE) {
+                programCodeVerifyError(program, procedureIndex, "undefined opcode %x at %d", instruction.opcode, address);
+                break;
+            }
+
+            if (instruction.kind == PROGRAM_INSTRUCTION_OUT_OF_RANGE) {
+                programCodeVerifyError(program, procedureIndex, "instruction at %d is truncated", address);
+                break;
+            }
+
+            opcode_t opcode = 0x8000 | (instruction.opcode & 0x3FF);
+            long long value;
+            int pops;
+            int pushes;
+
+            if (instruction.kind == PROGRAM_INSTRUCTION_PUSH) {
+                stack.push_back(instruction.operand);
+            } else if (opcode == OPCODE_JUMP) {
+                value = programCodeVerifyPop(stack);
+                if (value != PROGRAM_VERIFY_UNKNOWN_VALUE) {
+                    pending.push_back(std::make_pair(static_cast<int>(value), procedureIndex));
+                }
+            } else if (opcode == OPCODE_CALL) {
+                value = programCodeVerifyPop(stack);
+                if (value != PROGRAM_VERIFY_UNKNOWN_VALUE && (value < 0 || value >= procedureCount)) {
+                    programCodeVerifyError(program, procedureIndex, "call of procedure %d at %d is out of range", static_cast<int>(value), address);
+                }
+            } else if (opcode == OPCODE_IF) {
+                // Pops condition and then address to jump to when it's false.
+                programCodeVerifyPop(stack);
+                value = programCodeVerifyPop(stack);
+                if (value != PROGRAM_VERIFY_UNKNOWN_VALUE) {
+                    pending.push_back(std::make_pair(static_cast<int>(value), procedureIndex));
+                }
+            } else if (opcode == OPCODE_WHILE) {
+                // Address is popped only when condition is false.
+                programCodeVerifyPop(stack);
+                if (!stack.empty() && stack.back() != PROGRAM_VERIFY_UNKNOWN_VALUE) {
+                    pending.push_back(std::make_pair(static_cast<int>(stack.back()), procedureIndex));
+                }
+            } else if (opcode == OPCODE_DUP) {
+                value = programCodeVerifyPop(stack);
+                stack.push_back(value);
+                stack.push_back(value);
+            } else if (opcode == OPCODE_SWAP) {
+                value = programCodeVerifyPop(stack);
+                long long other = programCodeVerifyPop(stack);
+                stack.push_back(value);
+                stack.push_back(other);
+            } else if (programCodeGetStackEffect(opcode, &pops, &pushes)) {
+                for (int index = 0; index < pops; index++) {
+                    programCodeVerifyPop(stack);
+                }
+
+                for (int index = 0; index < pushes; index++) {
+                    stack.push_back(PROGRAM_VERIFY_UNKNOWN_VALUE);
+                }
+            } else {
+                stack.clear();
+            }
+
+            if (programCodeIsBlockEnd(instruction.opcode) || instruction.nextAddress >= code->size) {
+                break;
+            }
+
+            address = instruction.nextAddress;
+        }
+    }
+}
+
+static void programCodeVerifyError(Program* program, int procedureIndex, const char* format, ...)
+{
+    ProgramImage* image = program->image;
+    image->verificationErrors++;
+
+    if (image->verificationErrors > PROGRAM_VERIFY_MAX_REPORTED_ERRORS) {
+        return;
+    }
+
+    char string[260];
+
+    va_list argptr;
+    va_start(argptr, format);
+    vsnprintf(string, sizeof(string), format, argptr);
+    va_end(argptr);
+
+    const char* procedureName = "<start>";
+    if (procedureIndex != -1) {
+        int nameOffset = stackReadInt32(program->procedures + 4 + sizeof(Procedure) * procedureIndex, offsetof(Procedure, nameOffset));
+        procedureName = (char*)(program->identifiers + nameOffset);
+    }
+
+    debugPrint("\nScript verification: %s, procedure %s: %s\n", program->name, procedureName, string);
+
+    if (image->verificationErrors == PROGRAM_VERIFY_MAX_REPORTED_ERRORS) {
+        debugPrint("Script verification: %s, further problems are not reported\n", program->name);
+    }
 }
 
 // 0x4678E0
@@ -545,123 +1357,375 @@ char* programGetIdentifier(Program* program, int offset)
 // - positive block length - check for ref count.
 // - negative block length - block is free, attempt to merge with next block.
 //
+// CE: Only blocks which were allocated or lost their last reference since the
+// previous call are checked. Free blocks are merged when released or reused.
+//
 // 0x4679E0
 static void programMarkHeap(Program* program)
 {
-    unsigned char* ptr;
-    short len;
-    unsigned char* next_ptr;
-    short next_len;
-    short diff;
-
     if (program->dynamicStrings == nullptr) {
         return;
     }
 
-    ptr = program->dynamicStrings + 4;
-    while (*(unsigned short*)ptr != 0x8000) {
-        len = *(short*)ptr;
-        if (len < 0) {
-            len = -len;
-            next_ptr = ptr + len + 4;
-
-            if (*(unsigned short*)next_ptr != 0x8000) {
-                next_len = *(short*)next_ptr;
-                if (next_len < 0) {
-                    diff = 4 - next_len;
-                    if (diff + len < 32766) {
-                        len += diff;
-                        *(short*)ptr += next_len - 4;
-                    } else {
-                        debugPrint("merged string would be too long, size %d %d\n", diff, len);
-                    }
-                }
+    ProgramStringHeap* heap = program->stringHeap;
+    unsigned char* base = program->dynamicStrings + 4;
+    int total = *(int*)(program->dynamicStrings);
+
+    // NOTE: Blocks can be released while iterating, but none are added.
+    for (size_t index = 0; index < heap->unreferencedBlocks.size(); index++) {
+        int offset = heap->unreferencedBlocks[index];
+        if (offset >= 0 && offset < total && heap->blockStarts[offset / 2] != 0) {
+            if (*(short*)(base + offset) >= 0 && *(short*)(base + offset + 2) == 0) {
+                programStringHeapFree(program, offset);
+                total = *(int*)(program->dynamicStrings);
             }
-        } else if (*(short*)(ptr + 2) == 0) {
-            *(short*)ptr = -len;
-            *(short*)(ptr + 2) = 0;
         }
+    }
+
+    heap->unreferencedBlocks.clear();
+}
+
+// CE: Creates empty dynamic strings heap.
+static void programStringHeapInit(Program* program)
+{
+    program->dynamicStrings = (unsigned char*)internal_malloc_safe(PROGRAM_STRING_HEAP_INITIAL_CAPACITY, __FILE__, __LINE__);
+    *(int*)(program->dynamicStrings) = 0;
+    *(unsigned short*)(program->dynamicStrings + 4) = 0x8000;
+    *(short*)(program->dynamicStrings + 6) = 1;
+
+    ProgramStringHeap* heap = new ProgramStringHeap();
+    heap->capacity = PROGRAM_STRING_HEAP_INITIAL_CAPACITY;
+    heap->entriesCount = 0;
+    heap->deletedEntriesCount = 0;
+    heap->blockStarts.resize(PROGRAM_STRING_HEAP_INITIAL_CAPACITY / 2);
 
-        ptr += len + 4;
+    for (int sizeClass = 0; sizeClass < PROGRAM_STRING_HEAP_SIZE_CLASSES; sizeClass++) {
+        heap->freeListLimits[sizeClass] = 64;
     }
+
+    program->stringHeap = heap;
 }
 
-// 0x467A80
-int programPushString(Program* program, char* string)
+// CE: FNV-1a.
+static unsigned int programStringHash(const char* string)
 {
-    int v27;
-    unsigned char* v20;
-    unsigned char* v23;
+    unsigned int hash = 2166136261u;
+    while (*string != '\0') {
+        hash ^= static_cast<unsigned char>(*string++);
+        hash *= 16777619u;
+    }
+    return hash;
+}
 
-    if (program == nullptr) {
-        return 0;
+static int programStringHeapGetSizeClass(int length)
+{
+    int sizeClass = 0;
+    while (sizeClass < PROGRAM_STRING_HEAP_SIZE_CLASSES - 1 && (length >> (sizeClass + 1)) != 0) {
+        sizeClass++;
+    }
+    return sizeClass;
+}
+
+// CE: Returns offset of allocated block with given string, or -1.
+static int programStringHeapFind(Program* program, const char* string, unsigned int hash)
+{
+    ProgramStringHeap* heap = program->stringHeap;
+    if (heap->entries.empty()) {
+        return -1;
     }
 
-    v27 = strlen(string) + 1;
+    unsigned char* base = program->dynamicStrings + 4;
+    size_t mask = heap->entries.size() - 1;
+    for (size_t index = hash & mask;; index = (index + 1) & mask) {
+        const ProgramStringHeapEntry* entry = &(heap->entries[index]);
+        if (entry->offset == PROGRAM_STRING_HEAP_ENTRY_EMPTY) {
+            return -1;
+        }
 
-    // Align memory
-    if (v27 & 1) {
-        v27++;
+        if (entry->offset >= 0 && entry->hash == hash && strcmp((char*)(base + entry->offset + 4), string) == 0) {
+            return entry->offset;
+        }
     }
+}
 
-    if (program->dynamicStrings != nullptr) {
-        // TODO: Needs testing, lots of pointer stuff.
-        unsigned char* heap = program->dynamicStrings + 4;
-        while (*(unsigned short*)heap != 0x8000) {
-            short v2 = *(short*)heap;
-            if (v2 >= 0) {
-                if (v2 == v27) {
-                    if (strcmp(string, (char*)(heap + 4)) == 0) {
-                        return (heap + 4) - (program->dynamicStrings + 4);
-                    }
-                }
-            } else {
-                v2 = -v2;
-                if (v2 > v27) {
-                    if (v2 - v27 <= 4) {
-                        *(short*)heap = v2;
-                    } else {
-                        *(short*)(heap + v27 + 6) = 0;
-                        *(short*)(heap + v27 + 4) = -(v2 - v27 - 4);
-                        *(short*)(heap) = v27;
-                    }
+static void programStringHeapAddEntry(ProgramStringHeap* heap, int offset, unsigned int hash)
+{
+    // Keep at most 3/4 of the table occupied, deleted entries are dropped
+    // when it's rebuilt.
+    if ((heap->entriesCount + heap->deletedEntriesCount + 1) * 4 > static_cast<int>(heap->entries.size()) * 3) {
+        size_t size = 16;
+        while (static_cast<int>(size) < (heap->entriesCount + 1) * 2) {
+            size *= 2;
+        }
 
-                    *(short*)(heap + 2) = 0;
-                    strcpy((char*)(heap + 4), string);
+        std::vector<ProgramStringHeapEntry> entries(size, ProgramStringHeapEntry { PROGRAM_STRING_HEAP_ENTRY_EMPTY, 0 });
+        entries.swap(heap->entries);
 
-                    *(heap + v27 + 3) = '\0';
-                    return (heap + 4) - (program->dynamicStrings + 4);
-                }
+        heap->entriesCount = 0;
+        heap->deletedEntriesCount = 0;
+
+        for (const ProgramStringHeapEntry& entry : entries) {
+            if (entry.offset >= 0) {
+                programStringHeapAddEntry(heap, entry.offset, entry.hash);
             }
-            heap += v2 + 4;
         }
-    } else {
-        program->dynamicStrings = (unsigned char*)internal_malloc_safe(8, __FILE__, __LINE__); // "..\\int\\INTRPRET.C", 631
-        *(int*)(program->dynamicStrings) = 0;
-        *(unsigned short*)(program->dynamicStrings + 4) = 0x8000;
-        *(short*)(program->dynamicStrings + 6) = 1;
     }
 
-    program->dynamicStrings = (unsigned char*)internal_realloc_safe(program->dynamicStrings, *(int*)(program->dynamicStrings) + 8 + 4 + v27, __FILE__, __LINE__); // "..\\int\\INTRPRET.C", 640
+    size_t mask = heap->entries.size() - 1;
+    size_t index = hash & mask;
+    while (heap->entries[index].offset >= 0) {
+        index = (index + 1) & mask;
+    }
 
-    v20 = program->dynamicStrings + *(int*)(program->dynamicStrings) + 4;
-    if ((*(short*)v20 & 0xFFFF) != 0x8000) {
-        programFatalError("Internal consistancy error, string table mangled");
+    if (heap->entries[index].offset == PROGRAM_STRING_HEAP_ENTRY_DELETED) {
+        heap->deletedEntriesCount--;
     }
 
-    *(int*)(program->dynamicStrings) += v27 + 4;
+    heap->entries[index].offset = offset;
+    heap->entries[index].hash = hash;
+    heap->entriesCount++;
+}
 
-    *(short*)(v20) = v27;
-    *(short*)(v20 + 2) = 0;
+static void programStringHeapRemoveEntry(Program* program, int offset)
+{
+    ProgramStringHeap* heap = program->stringHeap;
+    if (heap->entries.empty()) {
+        return;
+    }
+
+    unsigned int hash = programStringHash((char*)(program->dynamicStrings + 4 + offset + 4));
+    size_t mask = heap->entries.size() - 1;
+    for (size_t index = hash & mask;; index = (index + 1) & mask) {
+        ProgramStringHeapEntry* entry = &(heap->entries[index]);
+        if (entry->offset == PROGRAM_STRING_HEAP_ENTRY_EMPTY) {
+            return;
+        }
+
+        if (entry->offset == offset) {
+            entry->offset = PROGRAM_STRING_HEAP_ENTRY_DELETED;
+            heap->entriesCount--;
+            heap->deletedEntriesCount++;
+            return;
+        }
+    }
+}
+
+static bool programStringHeapIsFreeBlock(Program* program, int offset)
+{
+    return offset < *(int*)(program->dynamicStrings)
+        && program->stringHeap->blockStarts[offset / 2] != 0
+        && *(short*)(program->dynamicStrings + 4 + offset) < 0;
+}
+
+// CE: Merges free block with subsequent free blocks, returns its length.
+static int programStringHeapMergeFreeBlocks(Program* program, int offset)
+{
+    ProgramStringHeap* heap = program->stringHeap;
+    unsigned char* base = program->dynamicStrings + 4;
+
+    int length = -*(short*)(base + offset);
+    while (true) {
+        int next = offset + 4 + length;
+        if (*(unsigned short*)(base + next) == 0x8000) {
+            break;
+        }
+
+        short nextLength = *(short*)(base + next);
+        if (nextLength >= 0) {
+            break;
+        }
+
+        if (length + 4 - nextLength >= PROGRAM_STRING_HEAP_MAX_BLOCK_LENGTH) {
+            break;
+        }
+
+        length += 4 - nextLength;
+        heap->blockStarts[next / 2] = 0;
+    }
+
+    *(short*)(base + offset) = -length;
+
+    return length;
+}
+
+static void programStringHeapAddFreeBlock(Program* program, int offset, int length)
+{
+    ProgramStringHeap* heap = program->stringHeap;
+    int sizeClass = programStringHeapGetSizeClass(length);
+    std::vector<int>& freeList = heap->freeLists[sizeClass];
+
+    // Drop outdated and duplicate entries once list grows.
+    if (freeList.size() >= heap->freeListLimits[sizeClass]) {
+        size_t count = 0;
+        for (size_t index = 0; index < freeList.size(); index++) {
+            int freeOffset = freeList[index];
+            if (programStringHeapIsFreeBlock(program, freeOffset) && heap->blockStarts[freeOffset / 2] == 1) {
+                heap->blockStarts[freeOffset / 2] = 2;
+                freeList[count++] = freeOffset;
+            }
+        }
+        freeList.resize(count);
+
+        for (int freeOffset : freeList) {
+            heap->blockStarts[freeOffset / 2] = 1;
+        }
+
+        heap->freeListLimits[sizeClass] = std::max(static_cast<size_t>(64), count * 2);
+    }
+
+    freeList.push_back(offset);
+}
+
+// CE: Allocates block of given length (reusing free blocks when possible)
+// and returns its offset. Allocated block can be larger than requested.
+static int programStringHeapAllocate(Program* program, int length)
+{
+    ProgramStringHeap* heap = program->stringHeap;
+
+    int firstSizeClass = programStringHeapGetSizeClass(length);
+    for (int sizeClass = firstSizeClass; sizeClass < PROGRAM_STRING_HEAP_SIZE_CLASSES; sizeClass++) {
+        std::vector<int>& freeList = heap->freeLists[sizeClass];
+        int skipped = 0;
+
+        size_t index = freeList.size();
+        while (index > 0) {
+            index--;
+
+            int offset = freeList[index];
+            if (!programStringHeapIsFreeBlock(program, offset)) {
+                freeList[index] = freeList.back();
+                freeList.pop_back();
+                continue;
+            }
+
+            int freeLength = programStringHeapMergeFreeBlocks(program, offset);
+            if (freeLength < length) {
+                // Only blocks in the first size class can be too small.
+                if (++skipped >= PROGRAM_STRING_HEAP_FIRST_CLASS_LOOKUP_LIMIT) {
+                    break;
+                }
+                continue;
+            }
+
+            freeList[index] = freeList.back();
+            freeList.pop_back();
+
+            unsigned char* base = program->dynamicStrings + 4;
+            if (freeLength - length <= 4) {
+                length = freeLength;
+            } else {
+                int rest = offset + 4 + length;
+                *(short*)(base + rest) = -(freeLength - length - 4);
+                *(short*)(base + rest + 2) = 0;
+                heap->blockStarts[rest / 2] = 1;
+                programStringHeapAddFreeBlock(program, rest, freeLength - length - 4);
+            }
+
+            *(short*)(base + offset) = length;
+            *(short*)(base + offset + 2) = 0;
+
+            return offset;
+        }
+    }
+
+    int total = *(int*)(program->dynamicStrings);
+    int size = total + 8 + 4 + length;
+    if (size > heap->capacity) {
+        int capacity = std::max(size, heap->capacity * 2);
+        program->dynamicStrings = (unsigned char*)internal_realloc_safe(program->dynamicStrings, capacity, __FILE__, __LINE__); // "..\\int\\INTRPRET.C", 640
+        heap->capacity = capacity;
+        heap->blockStarts.resize(capacity / 2);
+    }
+
+    unsigned char* block = program->dynamicStrings + 4 + total;
+    if ((*(short*)block & 0xFFFF) != 0x8000) {
+        programFatalError("Internal consistancy error, string table mangled");
+    }
+
+    *(int*)(program->dynamicStrings) += length + 4;
+
+    *(short*)(block) = length;
+    *(short*)(block + 2) = 0;
+
+    *(unsigned short*)(block + 4 + length) = 0x8000;
+    *(short*)(block + 4 + length + 2) = 1;
+
+    heap->blockStarts[total / 2] = 1;
+
+    return total;
+}
+
+// CE: Releases allocated block.
+static void programStringHeapFree(Program* program, int offset)
+{
+    ProgramStringHeap* heap = program->stringHeap;
+
+    programStringHeapRemoveEntry(program, offset);
+
+    unsigned char* base = program->dynamicStrings + 4;
+    *(short*)(base + offset) = -*(short*)(base + offset);
+    *(short*)(base + offset + 2) = 0;
+
+    int length = programStringHeapMergeFreeBlocks(program, offset);
+
+    // Free space at the end of the heap is given back.
+    if (*(unsigned short*)(base + offset + 4 + length) == 0x8000) {
+        *(int*)(program->dynamicStrings) = offset;
+        *(unsigned short*)(base + offset) = 0x8000;
+        *(short*)(base + offset + 2) = 1;
+        heap->blockStarts[offset / 2] = 0;
+        return;
+    }
+
+    programStringHeapAddFreeBlock(program, offset, length);
+}
+
+// CE: Strings are deduplicated with hash index of allocated blocks, space is
+// reused from size class free lists instead of scanning the heap.
+//
+// 0x467A80
+int programPushString(Program* program, char* string)
+{
+    int v27;
+
+    if (program == nullptr) {
+        return 0;
+    }
+
+    v27 = strlen(string) + 1;
+
+    // Align memory
+    if (v27 & 1) {
+        v27++;
+    }
+
+    if (v27 > PROGRAM_STRING_HEAP_MAX_BLOCK_LENGTH) {
+        programFatalError("programPushString: String too long.");
+    }
+
+    if (program->dynamicStrings == nullptr) {
+        programStringHeapInit(program);
+    }
 
-    strcpy((char*)(v20 + 4), string);
+    unsigned int hash = programStringHash(string);
 
-    v23 = v20 + v27;
-    *(v23 + 3) = '\0';
-    *(unsigned short*)(v23 + 4) = 0x8000;
-    *(short*)(v23 + 6) = 1;
+    int offset = programStringHeapFind(program, string, hash);
+    if (offset != -1) {
+        return offset + 4;
+    }
+
+    offset = programStringHeapAllocate(program, v27);
+
+    unsigned char* block = program->dynamicStrings + 4 + offset;
+    strcpy((char*)(block + 4), string);
+    *(block + 4 + v27 - 1) = '\0';
+
+    programStringHeapAddEntry(program->stringHeap, offset, hash);
 
-    return v20 + 4 - (program->dynamicStrings + 4);
+    // Released in `programMarkHeap` unless referenced.
+    program->stringHeap->unreferencedBlocks.push_back(offset);
+
+    return offset + 4;
 }
 
 // 0x467C90
@@ -2492,23 +3556,35 @@ static void opCheckProcedureArgumentCount(Program* program)
 static void opLookupStringProc(Program* program)
 {
     const char* procedureNameToLookup = programStackPopString(program);
-    int procedureCount = stackReadInt32(program->procedures, 0);
 
-    // Skip procedure count (4 bytes) and main procedure, which cannot be
-    // looked up.
-    unsigned char* procedurePtr = program->procedures + 4 + sizeof(Procedure);
-
-    // Start with 1 since we've skipped main procedure, which is always at
-    // index 0.
-    for (int index = 1; index < procedureCount; index++) {
-        int offset = stackReadInt32(procedurePtr, offsetof(Procedure, nameOffset));
-        const char* procedureName = programGetIdentifier(program, offset);
-        if (compat_stricmp(procedureName, procedureNameToLookup) == 0) {
-            programStackPushInteger(program, index);
-            return;
-        }
+    // CE: Use procedure name index. It finds main procedure only when it
+    // has the same name as the one we're looking for, in which case the
+    // original search below is used.
+    int procedureIndex = programFindProcedure(program, procedureNameToLookup);
+    if (procedureIndex > 0) {
+        programStackPushInteger(program, procedureIndex);
+        return;
+    }
+
+    if (procedureIndex == 0) {
+        int procedureCount = stackReadInt32(program->procedures, 0);
+
+        // Skip procedure count (4 bytes) and main procedure, which cannot be
+        // looked up.
+        unsigned char* procedurePtr = program->procedures + 4 + sizeof(Procedure);
+
+        // Start with 1 since we've skipped main procedure, which is always at
+        // index 0.
+        for (int index = 1; index < procedureCount; index++) {
+            int offset = stackReadInt32(procedurePtr, offsetof(Procedure, nameOffset));
+            const char* procedureName = programGetIdentifier(program, offset);
+            if (compat_stricmp(procedureName, procedureNameToLookup) == 0) {
+                programStackPushInteger(program, index);
+                return;
+            }
 
-        procedurePtr += sizeof(Procedure);
+            procedurePtr += sizeof(Procedure);
+        }
     }
 
     char err[260];
@@ -2611,39 +3687,24 @@ void _interpretClose()
 }
 
 // 0x46CCA4
-void _interpret(Program* program, int a2)
+// CE: Executes up to `a2` instructions (or until the end of critical section).
+// Extracted from `_interpret`.
+static void programExecute(Program* program, int a2)
 {
     char err[260];
 
-    Program* oldCurrentProgram = gInterpreterCurrentProgram;
+#if defined(INTERPRETER_COMPUTED_GOTO)
+    static void* const dispatchTable[PROGRAM_INSTRUCTION_KIND_COUNT] = {
+        &&executeHandler,
+        &&executePush,
+        &&executeBadOpcode,
+        &&executeUndefinedOpcode,
+        &&executeOutOfRange,
+    };
+#endif
 
-    if (!_Enabled) {
-        return;
-    }
-
-    if (_busy) {
-        return;
-    }
-
-    if (program->exited || (program->flags & PROGRAM_FLAG_0x20) != 0 || (program->flags & PROGRAM_FLAG_0x0100) != 0) {
-        return;
-    }
-
-    if (program->field_78 == -1) {
-        program->field_78 = 1000 * _timerFunc() / _timerTick;
-    }
-
-    gInterpreterCurrentProgram = program;
-
-    if (setjmp(program->env)) {
-        gInterpreterCurrentProgram = oldCurrentProgram;
-        program->flags |= PROGRAM_FLAG_EXITED | PROGRAM_FLAG_0x04;
-        return;
-    }
-
-    if ((program->flags & PROGRAM_FLAG_CRITICAL_SECTION) != 0 && a2 < 3) {
-        a2 = 3;
-    }
+    ProgramCode* code = program->code;
+    int instructionIndex = -1;
 
     while ((program->flags & PROGRAM_FLAG_CRITICAL_SECTION) != 0 || --a2 != -1) {
         if ((program->flags & (PROGRAM_FLAG_EXITED | PROGRAM_FLAG_0x04 | PROGRAM_FLAG_STOPPED | PROGRAM_FLAG_0x20 | PROGRAM_FLAG_0x40 | PROGRAM_FLAG_0x0100)) != 0) {
@@ -2669,28 +3730,135 @@ void _interpret(Program* program, int a2)
             program->flags &= ~PROGRAM_IS_WAITING;
         }
 
-        // NOTE: Uninline.
-        opcode_t opcode = _getOp(program);
+        // CE: Fetch decoded instruction. Instructions are executed in
+        // stream order until handler changes instruction pointer.
+        if (static_cast<size_t>(instructionIndex) >= code->instructions.size()
+            || code->instructions[instructionIndex].address != program->instructionPointer) {
+            instructionIndex = programCodeLookup(program, program->instructionPointer);
+        }
+
+        const ProgramInstruction* instruction = &(code->instructions[instructionIndex]);
+        instructionIndex++;
+
+        program->instructionPointer = instruction->nextAddress;
+
+        opcode_t opcode = instruction->opcode;
 
         // TODO: Replace with field_82 and field_80?
-        program->flags &= 0xFFFF;
-        program->flags |= (opcode << 16);
+        //
+        // CE: Flags are updated with a single full-width store, partial store
+        // of the opcode stalls reading flags on the next iteration.
+        program->flags = (program->flags & 0xFFFF) | instruction->flags;
+
+#if defined(INTERPRETER_COMPUTED_GOTO)
+        goto* dispatchTable[instruction->kind];
+#else
+        switch (instruction->kind) {
+        case PROGRAM_INSTRUCTION_HANDLER:
+            goto executeHandler;
+        case PROGRAM_INSTRUCTION_PUSH:
+            goto executePush;
+        case PROGRAM_INSTRUCTION_BAD_OPCODE:
+            goto executeBadOpcode;
+        case PROGRAM_INSTRUCTION_UNDEFINED_OPCODE:
+            goto executeUndefinedOpcode;
+        default:
+            goto executeOutOfRange;
+        }
+#endif
+
+    executeHandler:
+        if (gScriptProfilerEnabled) {
+            scriptProfilerExecuteHandler(program, instruction->handler, opcode);
+            continue;
+        }
+
+        // NOTE: Decoded instruction can be invalidated by handler (when it
+        // runs other code of this program).
+        instruction->handler(program);
+        continue;
 
-        if (!((opcode >> 8) & 0x80)) {
-            snprintf(err, sizeof(err), "Bad opcode %x %c %d.", opcode, opcode, opcode);
-            programFatalError(err);
+    executePush:
+        if (gScriptProfilerEnabled) {
+            gScriptProfilerOpcodeCounts[opcode & 0x3FF]++;
         }
 
-        unsigned int opcodeIndex = opcode & 0x3FF;
-        OpcodeHandler* handler = gInterpreterOpcodeHandlers[opcodeIndex];
-        if (handler == nullptr) {
-            snprintf(err, sizeof(err), "Undefined opcode %x.", opcode);
-            programFatalError(err);
+        // Same as `opPush` with pre-decoded operand.
+        {
+            ProgramValue value;
+            value.opcode = opcode;
+            value.integerValue = instruction->operand;
+            programStackPushValue(program, value);
+        }
+        continue;
+
+    executeBadOpcode:
+        snprintf(err, sizeof(err), "Bad opcode %x %c %d.", opcode, opcode, opcode);
+        programFatalError(err);
+
+    executeUndefinedOpcode:
+        // Handler might have been registered after decoding.
+        {
+            unsigned int opcodeIndex = opcode & 0x3FF;
+            OpcodeHandler* handler = opcodeIndex < OPCODE_MAX_COUNT ? gInterpreterOpcodeHandlers[opcodeIndex] : nullptr;
+            if (handler == nullptr) {
+                snprintf(err, sizeof(err), "Undefined opcode %x.", opcode);
+                programFatalError(err);
+            }
+
+            handler(program);
+        }
+        continue;
+
+    executeOutOfRange:
+        programFatalError("Instruction pointer %d out of range.", instruction->address);
+    }
+}
+
+void _interpret(Program* program, int a2)
+{
+    Program* oldCurrentProgram = gInterpreterCurrentProgram;
+
+    if (!_Enabled) {
+        return;
+    }
+
+    if (_busy) {
+        return;
+    }
+
+    if (program->exited || (program->flags & PROGRAM_FLAG_0x20) != 0 || (program->flags & PROGRAM_FLAG_0x0100) != 0) {
+        return;
+    }
+
+    if (program->field_78 == -1) {
+        program->field_78 = 1000 * _timerFunc() / _timerTick;
+    }
+
+    gInterpreterCurrentProgram = program;
+
+    if (gProgramStatsEnabled) {
+        programStatsSliceBegin(program);
+    }
+
+    if (setjmp(program->env)) {
+        gInterpreterCurrentProgram = oldCurrentProgram;
+        program->flags |= PROGRAM_FLAG_EXITED | PROGRAM_FLAG_0x04;
+
+        if (gProgramStatsEnabled) {
+            programStatsSliceEnd();
         }
+        return;
+    }
 
-        handler(program);
+    if ((program->flags & PROGRAM_FLAG_CRITICAL_SECTION) != 0 && a2 < 3) {
+        a2 = 3;
     }
 
+    // CE: Instructions are executed in a separate function unaffected by
+    // `setjmp`.
+    programExecute(program, a2);
+
     if ((program->flags & PROGRAM_FLAG_EXITED) != 0) {
         if (program->parent != nullptr) {
             if (program->parent->flags & PROGRAM_FLAG_0x20) {
@@ -2705,6 +3873,10 @@ void _interpret(Program* program, int a2)
     gInterpreterCurrentProgram = oldCurrentProgram;
 
     programMarkHeap(program);
+
+    if (gProgramStatsEnabled) {
+        programStatsSliceEnd();
+    }
 }
 
 // Prepares program stacks for executing proc at [address].
@@ -2830,21 +4002,38 @@ void _executeProc(Program* program, int procedureIndex)
 // procedure exists.
 //
 // 0x46DCD0
+//
+// CE: Uses procedure name index of program image instead of comparing names
+// of every procedure.
 int programFindProcedure(Program* program, const char* name)
 {
-    int procedureCount = stackReadInt32(program->procedures, 0);
+    std::string folded;
+    programFoldProcedureName(name, folded);
 
-    unsigned char* ptr = program->procedures + 4;
-    for (int index = 0; index < procedureCount; index++) {
-        int identifierOffset = stackReadInt32(ptr, offsetof(Procedure, nameOffset));
-        if (compat_stricmp((char*)(program->identifiers + identifierOffset), name) == 0) {
-            return index;
-        }
+    const std::unordered_map<std::string, int>& procedureIndexes = program->image->procedureIndexes;
+    auto it = procedureIndexes.find(folded);
+    if (it == procedureIndexes.end()) {
+        return -1;
+    }
 
-        ptr += sizeof(Procedure);
+    return it->second;
+}
+
+// CE: Returns indexes of given procedures (-1 for missing ones). The table is
+// resolved once per script file and shared by every instance, so `names`
+// must be a static array.
+const int* programGetProcedureIndexes(Program* program, const char* const* names, int count)
+{
+    ProgramImage* image = program->image;
+    if (image->procedureTableNames != names || static_cast<int>(image->procedureTable.size()) != count) {
+        image->procedureTable.resize(count);
+        for (int index = 0; index < count; index++) {
+            image->procedureTable[index] = programFindProcedure(program, names[index]);
+        }
+        image->procedureTableNames = names;
     }
 
-    return -1;
+    return image->procedureTable.data();
 }
 
 // 0x46DD2C
@@ -2973,6 +4162,10 @@ static void programListNodeFree(ProgramListNode* programListNode)
         gInterpreterProgramListHead = programListNode->next;
     }
 
+    if (gInterpreterScheduleNext == programListNode) {
+        gInterpreterScheduleNext = programListNode->next;
+    }
+
     programFree(programListNode->program);
     internal_free_safe(programListNode, __FILE__, __LINE__); // "..\\int\\INTRPRET.C", 2923
 }
@@ -3029,24 +4222,488 @@ void _updatePrograms()
     // non-critical calls scheduled from managed windows). One more thing to
     // note is that global scripts in CE cannot handle conditional/timed procs
     // (which are not used anyway).
+    //
+    // CE: Time budget of the frame covers global scripts, programs, and
+    // critter procs (see `_script_chk_critters`).
+    if (gInterpreterTimeBudget > 0) {
+        gInterpreterTimeBudgetEnd = interpreterGetMicroseconds() + gInterpreterTimeBudget;
+    }
+
     sfall_gl_scr_update(_cpuBurstSize);
 
-    ProgramListNode* curr = gInterpreterProgramListHead;
-    while (curr != nullptr) {
-        ProgramListNode* next = curr->next;
-        if (curr->program != nullptr) {
-            _interpret(curr->program, _cpuBurstSize);
+    if (gInterpreterTimeBudget <= 0) {
+        ProgramListNode* curr = gInterpreterProgramListHead;
+        while (curr != nullptr) {
+            ProgramListNode* next = curr->next;
+            if (curr->program != nullptr) {
+                _interpret(curr->program, _cpuBurstSize);
 
-            if (curr->program->exited) {
-                programListNodeFree(curr);
+                if (curr->program->exited) {
+                    programListNodeFree(curr);
+                }
             }
+            curr = next;
+        }
+    } else {
+        // CE: Programs are given bursts in turns until time budget is spent.
+        // The frame starts with the program which did not get its turn in
+        // the previous frame, and more rounds are made while there are
+        // programs with work to do.
+        ProgramListNode* curr = gInterpreterScheduleNext != nullptr ? gInterpreterScheduleNext : gInterpreterProgramListHead;
+        bool fullRound = curr == gInterpreterProgramListHead;
+        bool runnable = false;
+
+        gInterpreterScheduleNext = nullptr;
+
+        while (true) {
+            if (curr == nullptr) {
+                if (fullRound && !runnable) {
+                    break;
+                }
+
+                curr = gInterpreterProgramListHead;
+                fullRound = true;
+                runnable = false;
+
+                if (curr == nullptr) {
+                    break;
+                }
+            }
+
+            if (!interpreterHasTimeBudget()) {
+                gInterpreterScheduleNext = curr;
+                gInterpreterTimeBudgetOverruns++;
+                break;
+            }
+
+            ProgramListNode* next = curr->next;
+            if (curr->program != nullptr) {
+                if (programIsRunnable(curr->program)) {
+                    runnable = true;
+                }
+
+                _interpret(curr->program, _cpuBurstSize);
+
+                if (curr->program->exited) {
+                    programListNodeFree(curr);
+                }
+            }
+            curr = next;
         }
-        curr = next;
     }
+
     _doEvents();
     intLibUpdate();
 }
 
+// CE: Sets wall time given to scripts per frame. Zero disables the budget,
+// which makes every program run a fixed burst of instructions per frame and
+// only one critter run its `critter_p_proc` (original behaviour).
+void interpreterSetTimeBudget(int milliseconds)
+{
+    gInterpreterTimeBudget = milliseconds > 0 ? static_cast<long long>(milliseconds) * 1000 : 0;
+    gInterpreterScheduleNext = nullptr;
+}
+
+// CE: Returns `true` if scripts time budget is enabled and not spent in the
+// current frame.
+bool interpreterHasTimeBudget()
+{
+    return gInterpreterTimeBudget > 0 && interpreterGetMicroseconds() < gInterpreterTimeBudgetEnd;
+}
+
+static long long interpreterGetMicroseconds()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// CE: Returns `true` if program would execute instructions when interpreted
+// (mirrors checks in `_interpret` and `programExecute`, programs waiting for
+// a condition are not considered runnable).
+static bool programIsRunnable(Program* program)
+{
+    if (program->exited) {
+        return false;
+    }
+
+    if ((program->flags & (PROGRAM_FLAG_EXITED | PROGRAM_FLAG_0x04 | PROGRAM_FLAG_STOPPED | PROGRAM_FLAG_0x20 | PROGRAM_FLAG_0x40 | PROGRAM_FLAG_0x0100 | PROGRAM_IS_WAITING)) != 0) {
+        return false;
+    }
+
+    return true;
+}
+
+// CE: Enables accounting of CPU time spent in scripts.
+void interpreterSetStatsEnabled(bool enabled)
+{
+    // Slices in progress are finished with accounting state they were
+    // started with.
+    if (gProgramStatsStackSize == 0) {
+        gProgramStatsEnabled = enabled;
+    }
+}
+
+static void programStatsSliceBegin(Program* program)
+{
+    long long now = interpreterGetMicroseconds();
+
+    if (program->stats == nullptr) {
+        ProgramStats* stats = &(gProgramStats[program->name]);
+        if (stats->name.empty()) {
+            stats->name = program->name;
+            stats->slices = 0;
+            stats->time = 0;
+            stats->maxTime = 0;
+
+            int procedureCount = stackReadInt32(program->procedures, 0);
+            stats->procedures.resize(procedureCount, ProgramProcedureStats {});
+            for (int index = 0; index < procedureCount; index++) {
+                int identifierOffset = stackReadInt32(program->procedures + 4 + sizeof(Procedure) * index, offsetof(Procedure, nameOffset));
+                stats->procedureNames.push_back(programGetIdentifier(program, identifierOffset));
+            }
+        }
+        program->stats = stats;
+    }
+
+    // Pause enclosing slice.
+    if (gProgramStatsStackSize > 0 && gProgramStatsStackSize <= PROGRAM_STATS_STACK_SIZE) {
+        ProgramStatsSlice* parent = &(gProgramStatsStack[gProgramStatsStackSize - 1]);
+        parent->time += now - parent->start;
+    }
+
+    if (gProgramStatsStackSize < PROGRAM_STATS_STACK_SIZE) {
+        ProgramStatsSlice* slice = &(gProgramStatsStack[gProgramStatsStackSize]);
+        slice->stats = program->stats;
+        slice->procedureIndex = programGetProcedureAt(program, program->instructionPointer);
+        slice->start = now;
+        slice->time = 0;
+        slice->profilerFrames = gScriptProfilerFrames.size();
+
+        if (gScriptProfilerEnabled) {
+            scriptProfilerPushFrame(program);
+        }
+    }
+
+    gProgramStatsStackSize++;
+}
+
+static void programStatsSliceEnd()
+{
+    long long now = interpreterGetMicroseconds();
+
+    gProgramStatsStackSize--;
+
+    if (gProgramStatsStackSize < PROGRAM_STATS_STACK_SIZE) {
+        ProgramStatsSlice* slice = &(gProgramStatsStack[gProgramStatsStackSize]);
+        long long time = slice->time + now - slice->start;
+
+        while (gScriptProfilerFrames.size() > slice->profilerFrames) {
+            scriptProfilerPopFrame();
+        }
+
+        ProgramStats* stats = slice->stats;
+        stats->slices++;
+        stats->time += time;
+        stats->maxTime = std::max(stats->maxTime, time);
+
+        if (slice->procedureIndex >= 0 && slice->procedureIndex < static_cast<int>(stats->procedures.size())) {
+            ProgramProcedureStats* procedureStats = &(stats->procedures[slice->procedureIndex]);
+            procedureStats->slices++;
+            procedureStats->time += time;
+            procedureStats->maxTime = std::max(procedureStats->maxTime, time);
+        }
+    }
+
+    // Resume enclosing slice.
+    if (gProgramStatsStackSize > 0 && gProgramStatsStackSize <= PROGRAM_STATS_STACK_SIZE) {
+        gProgramStatsStack[gProgramStatsStackSize - 1].start = now;
+    }
+}
+
+// CE: Returns index of procedure containing given address (the one with the
+// closest body offset), or -1.
+static int programGetProcedureAt(Program* program, int address)
+{
+    int procedureCount = stackReadInt32(program->procedures, 0);
+    int procedureIndex = -1;
+    int procedureOffset = -1;
+
+    unsigned char* ptr = program->procedures + 4;
+    for (int index = 0; index < procedureCount; index++) {
+        int flags = stackReadInt32(ptr, offsetof(Procedure, flags));
+        int bodyOffset = stackReadInt32(ptr, offsetof(Procedure, bodyOffset));
+        if ((flags & PROCEDURE_FLAG_IMPORTED) == 0 && bodyOffset <= address && bodyOffset > procedureOffset) {
+            procedureIndex = index;
+            procedureOffset = bodyOffset;
+        }
+
+        ptr += sizeof(Procedure);
+    }
+
+    return procedureIndex;
+}
+
+// CE: Prints CPU time accounted to scripts (most expensive first) and
+// scheduler statistics to debug log.
+void interpreterDumpStats()
+{
+    std::vector<const ProgramStats*> programStats;
+    for (const auto& pair : gProgramStats) {
+        programStats.push_back(&(pair.second));
+    }
+
+    std::sort(programStats.begin(), programStats.end(), [](const ProgramStats* a, const ProgramStats* b) {
+        return a->time > b->time;
+    });
+
+    debugPrint("\nScript CPU time (time budget %lld us, overruns %u):\n", gInterpreterTimeBudget, gInterpreterTimeBudgetOverruns);
+    debugPrint("%-32s %10s %12s %10s %10s\n", "script / procedure", "slices", "total us", "avg us", "max us");
+
+    for (const ProgramStats* stats : programStats) {
+        debugPrint("%-32s %10u %12lld %10lld %10lld\n",
+            stats->name.c_str(),
+            stats->slices,
+            stats->time,
+            stats->slices != 0 ? stats->time / stats->slices : 0,
+            stats->maxTime);
+
+        std::vector<int> procedureIndexes;
+        for (int index = 0; index < static_cast<int>(stats->procedures.size()); index++) {
+            if (stats->procedures[index].slices != 0) {
+                procedureIndexes.push_back(index);
+            }
+        }
+
+        std::sort(procedureIndexes.begin(), procedureIndexes.end(), [stats](int a, int b) {
+            return stats->procedures[a].time > stats->procedures[b].time;
+        });
+
+        for (int index : procedureIndexes) {
+            const ProgramProcedureStats* procedureStats = &(stats->procedures[index]);
+            debugPrint("  %-30s %10u %12lld %10lld %10lld\n",
+                stats->procedureNames[index].c_str(),
+                procedureStats->slices,
+                procedureStats->time,
+                procedureStats->time / procedureStats->slices,
+                procedureStats->maxTime);
+        }
+    }
+}
+
+// CE: Enables script profiler (which also enables CPU accounting).
+void interpreterSetProfilerEnabled(bool enabled)
+{
+    if (gProgramStatsStackSize == 0) {
+        gScriptProfilerEnabled = enabled;
+        if (enabled) {
+            gProgramStatsEnabled = true;
+        }
+    }
+}
+
+static long long interpreterGetNanoseconds()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// CE: Executes opcode handler collecting opcode time and tracking script
+// calls and returns.
+static void scriptProfilerExecuteHandler(Program* program, OpcodeHandler* handler, opcode_t opcode)
+{
+    unsigned int opcodeIndex = opcode & 0x3FF;
+
+    long long start = interpreterGetNanoseconds();
+    handler(program);
+    long long end = interpreterGetNanoseconds();
+
+    gScriptProfilerOpcodeCounts[opcodeIndex]++;
+    gScriptProfilerOpcodeTimes[opcodeIndex] += end - start;
+
+    // Only frames started by calls in the current slice are ended by
+    // returns, the first one is ended with the slice.
+    if (gProgramStatsStackSize == 0 || gProgramStatsStackSize > PROGRAM_STATS_STACK_SIZE) {
+        return;
+    }
+
+    size_t sliceFrames = gProgramStatsStack[gProgramStatsStackSize - 1].profilerFrames + 1;
+    while (gScriptProfilerFrames.size() > sliceFrames) {
+        const ScriptProfilerFrame* frame = &(gScriptProfilerFrames.back());
+        if (frame->program != program || program->returnStackValues->size() >= frame->returnDepth) {
+            break;
+        }
+        scriptProfilerPopFrame();
+    }
+
+    if ((0x8000 | opcodeIndex) == OPCODE_CALL) {
+        scriptProfilerPushFrame(program);
+    }
+}
+
+// CE: Begins activation of procedure being executed by program.
+static void scriptProfilerPushFrame(Program* program)
+{
+    ScriptProfilerFrame frame;
+    frame.program = program;
+    frame.stats = program->stats;
+    frame.procedureIndex = programGetProcedureAt(program, program->instructionPointer);
+    frame.returnDepth = program->returnStackValues->size();
+    frame.start = interpreterGetNanoseconds();
+    frame.childTime = 0;
+
+    int parent = gScriptProfilerFrames.empty() ? -1 : gScriptProfilerFrames.back().node;
+    auto key = std::make_tuple(parent, frame.stats, frame.procedureIndex);
+    auto it = gScriptProfilerNodeIndexes.find(key);
+    if (it != gScriptProfilerNodeIndexes.end()) {
+        frame.node = it->second;
+    } else {
+        frame.node = static_cast<int>(gScriptProfilerNodes.size());
+        gScriptProfilerNodes.push_back(ScriptProfilerNode { parent, frame.stats, frame.procedureIndex, 0 });
+        gScriptProfilerNodeIndexes[key] = frame.node;
+    }
+
+    gScriptProfilerFrames.push_back(frame);
+}
+
+// CE: Ends the innermost procedure activation.
+static void scriptProfilerPopFrame()
+{
+    ScriptProfilerFrame frame = gScriptProfilerFrames.back();
+    gScriptProfilerFrames.pop_back();
+
+    long long inclusiveTime = interpreterGetNanoseconds() - frame.start;
+    long long exclusiveTime = inclusiveTime - frame.childTime;
+
+    gScriptProfilerNodes[frame.node].time += exclusiveTime;
+
+    if (!gScriptProfilerFrames.empty()) {
+        gScriptProfilerFrames.back().childTime += inclusiveTime;
+    }
+
+    ProgramStats* stats = frame.stats;
+    if (frame.procedureIndex >= 0 && frame.procedureIndex < static_cast<int>(stats->procedures.size())) {
+        ProgramProcedureStats* procedureStats = &(stats->procedures[frame.procedureIndex]);
+        procedureStats->calls++;
+        procedureStats->exclusiveTime += exclusiveTime;
+
+        // Recursive activations are already included in the outer one.
+        bool recursive = false;
+        for (const ScriptProfilerFrame& other : gScriptProfilerFrames) {
+            if (other.stats == stats && other.procedureIndex == frame.procedureIndex) {
+                recursive = true;
+                break;
+            }
+        }
+
+        if (!recursive) {
+            procedureStats->inclusiveTime += inclusiveTime;
+        }
+    }
+}
+
+static const char* scriptProfilerGetScriptName(const ProgramStats* stats)
+{
+    const char* name = stats->name.c_str();
+    const char* separator = strrchr(name, '\\');
+    if (separator == nullptr) {
+        separator = strrchr(name, '/');
+    }
+    return separator != nullptr ? separator + 1 : name;
+}
+
+static const char* scriptProfilerGetProcedureName(const ProgramStats* stats, int procedureIndex)
+{
+    if (procedureIndex >= 0 && procedureIndex < static_cast<int>(stats->procedureNames.size())) {
+        return stats->procedureNames[procedureIndex].c_str();
+    }
+    return "?";
+}
+
+static void scriptProfilerWriteFoldedStack(FILE* stream, int node)
+{
+    const ScriptProfilerNode* profilerNode = &(gScriptProfilerNodes[node]);
+    if (profilerNode->parent != -1) {
+        scriptProfilerWriteFoldedStack(stream, profilerNode->parent);
+        fputc(';', stream);
+    }
+
+    fprintf(stream, "%s:%s", scriptProfilerGetScriptName(profilerNode->stats), scriptProfilerGetProcedureName(profilerNode->stats, profilerNode->procedureIndex));
+}
+
+// CE: Writes script profiler results. When path ends with `.folded` call
+// stacks are written in folded format (one line per stack with exclusive
+// time in microseconds, suitable for flamegraph tools), otherwise a report of
+// procedures and opcodes sorted by time.
+bool interpreterWriteProfile(const char* path)
+{
+    FILE* stream = compat_fopen(path, "wt");
+    if (stream == nullptr) {
+        return false;
+    }
+
+    const char* extension = strrchr(path, '.');
+    if (extension != nullptr && compat_stricmp(extension, ".folded") == 0) {
+        for (int node = 0; node < static_cast<int>(gScriptProfilerNodes.size()); node++) {
+            long long time = gScriptProfilerNodes[node].time / 1000;
+            if (time > 0) {
+                scriptProfilerWriteFoldedStack(stream, node);
+                fprintf(stream, " %lld\n", time);
+            }
+        }
+
+        fclose(stream);
+        return true;
+    }
+
+    std::vector<std::pair<const ProgramStats*, int>> procedures;
+    for (const auto& pair : gProgramStats) {
+        const ProgramStats* stats = &(pair.second);
+        for (int index = 0; index < static_cast<int>(stats->procedures.size()); index++) {
+            if (stats->procedures[index].calls != 0) {
+                procedures.push_back(std::make_pair(stats, index));
+            }
+        }
+    }
+
+    std::sort(procedures.begin(), procedures.end(), [](const std::pair<const ProgramStats*, int>& a, const std::pair<const ProgramStats*, int>& b) {
+        return a.first->procedures[a.second].exclusiveTime > b.first->procedures[b.second].exclusiveTime;
+    });
+
+    fprintf(stream, "%-16s %-32s %10s %14s %14s\n", "script", "procedure", "calls", "inclusive us", "exclusive us");
+    for (const auto& pair : procedures) {
+        const ProgramProcedureStats* procedureStats = &(pair.first->procedures[pair.second]);
+        fprintf(stream, "%-16s %-32s %10u %14.1f %14.1f\n",
+            scriptProfilerGetScriptName(pair.first),
+            scriptProfilerGetProcedureName(pair.first, pair.second),
+            procedureStats->calls,
+            procedureStats->inclusiveTime / 1000.0,
+            procedureStats->exclusiveTime / 1000.0);
+    }
+
+    std::vector<int> opcodes;
+    for (int index = 0; index < OPCODE_MAX_COUNT; index++) {
+        if (gScriptProfilerOpcodeCounts[index] != 0) {
+            opcodes.push_back(index);
+        }
+    }
+
+    std::sort(opcodes.begin(), opcodes.end(), [](int a, int b) {
+        return gScriptProfilerOpcodeTimes[a] > gScriptProfilerOpcodeTimes[b];
+    });
+
+    // NOTE: Push instructions are counted, but not timed.
+    fprintf(stream, "\n%-8s %14s %14s %10s\n", "opcode", "count", "total us", "avg ns");
+    for (int index : opcodes) {
+        fprintf(stream, "0x%04X   %14llu %14.1f %10lld\n",
+            0x8000 | index,
+            gScriptProfilerOpcodeCounts[index],
+            gScriptProfilerOpcodeTimes[index] / 1000.0,
+            gScriptProfilerOpcodeTimes[index] / static_cast<long long>(gScriptProfilerOpcodeCounts[index]));
+    }
+
+    fclose(stream);
+    return true;
+}
+
 // 0x46E238
 void programListFree()
 {
@@ -3105,6 +4762,32 @@ static void interpreterPrintStats()
 
         programListNode = programListNode->next;
     }
+
+    // CE: Every instance past the first one would have its own copy of data
+    // and decoded instructions, except for procedure table.
+    int programsCount = 0;
+    size_t bytesSaved = 0;
+    for (const auto& pair : gProgramImages) {
+        const ProgramImage* image = pair.second;
+        size_t codeSize = 0;
+        if (image->code != nullptr) {
+            codeSize = image->code->instructions.size() * sizeof(ProgramInstruction) + image->code->addressMap.size() * sizeof(int);
+        }
+
+        programsCount += image->refCount;
+        bytesSaved += (image->refCount - 1) * (image->size + codeSize - programImageGetProceduresSize(image));
+    }
+
+    debugPrint("Bytecode images %d, programs %d, bytes saved %zu\n", static_cast<int>(gProgramImages.size()), programsCount, bytesSaved);
+
+    int invalidImagesCount = 0;
+    for (const auto& pair : gProgramImages) {
+        if (pair.second->verificationErrors != 0) {
+            invalidImagesCount++;
+        }
+    }
+
+    debugPrint("Bytecode images with verification problems %d\n", invalidImagesCount);
 }
 
 void programStackPushValue(Program* program, ProgramValue& programValue)
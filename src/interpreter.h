@@ -168,6 +168,11 @@ typedef std::vector<ProgramValue> ProgramStack;
 typedef struct Program Program;
 typedef int(InterpretCheckWaitFunc)(Program* program);
 
+typedef struct ProgramCode ProgramCode;
+typedef struct ProgramImage ProgramImage;
+typedef struct ProgramStats ProgramStats;
+typedef struct ProgramStringHeap ProgramStringHeap;
+
 // It's size in original code is 144 (0x8C) bytes due to the different
 // size of `jmp_buf`.
 typedef struct Program {
@@ -192,6 +197,19 @@ typedef struct Program {
     bool exited;
     ProgramStack* stackValues;
     ProgramStack* returnStackValues;
+
+    // CE: Pre-decoded instructions of `data`.
+    ProgramCode* code;
+
+    // CE: Bytecode shared with other instances of the same script (owns
+    // `data` and `code`).
+    ProgramImage* image;
+
+    // CE: Index and free lists of `dynamicStrings`.
+    ProgramStringHeap* stringHeap;
+
+    // CE: CPU time accounted to this script (shared by every instance).
+    ProgramStats* stats;
 } Program;
 
 typedef unsigned int(InterpretTimerFunc)();
@@ -214,11 +232,18 @@ void _interpretClose();
 void _interpret(Program* program, int a2);
 void _executeProc(Program* program, int procedureIndex);
 int programFindProcedure(Program* prg, const char* name);
+const int* programGetProcedureIndexes(Program* program, const char* const* names, int count);
 void _executeProcedure(Program* program, int procedureIndex);
 void programListNodeCreate(Program* program);
 void runProgram(Program* program);
 Program* runScript(char* name);
 void _updatePrograms();
+void interpreterSetTimeBudget(int milliseconds);
+bool interpreterHasTimeBudget();
+void interpreterSetStatsEnabled(bool enabled);
+void interpreterDumpStats();
+void interpreterSetProfilerEnabled(bool enabled);
+bool interpreterWriteProfile(const char* path);
 void programListFree();
 void interpreterRegisterOpcode(int opcode, OpcodeHandler* handler);
 
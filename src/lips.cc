@@ -420,6 +420,8 @@ static int _lips_make_speech()
         return -1;
     }
 
+    soundSetPriority(gLipsData.sound, GAME_SOUND_PRIORITY_SPEECH);
+
     if (soundSetFileIO(gLipsData.sound, audioOpen, audioClose, audioRead, nullptr, audioSeek, nullptr, audioGetSize)) {
         debugPrint("Ack!");
         debugPrint("Error!");
@@ -27,6 +27,7 @@
 #include "palette.h"
 #include "platform_compat.h"
 #include "preferences.h"
+#include "profiler.h"
 #include "proto.h"
 #include "random.h"
 #include "scripts.h"
@@ -325,15 +326,26 @@ static void mainLoop()
 
     while (_game_user_wants_to_quit == 0) {
         sharedFpsLimiter.mark();
+        profilerFrameBegin();
 
-        int keyCode = inputGetInput();
+        int keyCode;
+        {
+            ProfilerScope profilerScope(PROFILER_SECTION_INPUT);
+            keyCode = inputGetInput();
+        }
 
         // SFALL: MainLoopHook.
         sfall_gl_scr_process_main();
 
-        gameHandleKey(keyCode, false);
+        {
+            ProfilerScope profilerScope(PROFILER_SECTION_GAME_KEY);
+            gameHandleKey(keyCode, false);
+        }
 
-        scriptsHandleRequests();
+        {
+            ProfilerScope profilerScope(PROFILER_SECTION_SCRIPT_REQUESTS);
+            scriptsHandleRequests();
+        }
 
         mapHandleTransition();
 
@@ -347,7 +359,12 @@ static void mainLoop()
             _game_user_wants_to_quit = 2;
         }
 
-        renderPresent();
+        {
+            ProfilerScope profilerScope(PROFILER_SECTION_RENDER);
+            renderPresent();
+        }
+
+        profilerFrameEnd();
         sharedFpsLimiter.throttle();
     }
 
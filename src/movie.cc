@@ -1,5 +1,6 @@
 #include "movie.h"
 
+#include <stdio.h>
 #include <string.h>
 
 #include <SDL.h>
@@ -9,11 +10,13 @@
 #include "debug.h"
 #include "draw.h"
 #include "geometry.h"
+#include "histogram.h"
 #include "input.h"
 #include "memory_manager.h"
 #include "movie_effect.h"
 #include "movie_lib.h"
 #include "platform_compat.h"
+#include "settings.h"
 #include "sound.h"
 #include "svga.h"
 #include "text_font.h"
@@ -41,6 +44,7 @@ static int _movieScaleWindow(int win, unsigned char* data, int width, int height
 static int _blitNormal(int win, unsigned char* data, int width, int height, int pitch);
 static void movieSetPaletteEntriesImpl(unsigned char* palette, int start, int end);
 static void _cleanupMovie(int a1);
+static void movieLogDecodeStats();
 static void _cleanupLast();
 static File* movieOpen(char* filePath);
 static void movieLoadSubtitles(char* filePath);
@@ -403,6 +407,37 @@ void movieInit()
     MveSetIO(movieReadImpl);
 }
 
+// CE: Logs decode-ahead stalls and video decoder statistics of the last
+// movie.
+static void movieLogDecodeStats()
+{
+    int stalled;
+    MVE_rmStallCount(&stalled);
+    debugPrint("Video decode stalls %d\n", stalled);
+
+    MveDecodeStats decodeStats;
+    MVE_rmDecodeStats(&decodeStats);
+    if (decodeStats.frames == 0) {
+        return;
+    }
+
+    debugPrint("Video decode: avg %d us, p99 %u us\n",
+        (int)(decodeStats.time / decodeStats.frames),
+        histogramGetPercentile(decodeStats.timeHistogram, MVE_DECODE_TIME_BUCKETS, MVE_DECODE_TIME_BUCKET_WIDTH, 99));
+
+    char opcodes[256];
+    size_t length = 0;
+    for (int opcode = 0; opcode < 16; opcode++) {
+        int written = snprintf(opcodes + length, sizeof(opcodes) - length, " %d:%d", opcode, decodeStats.opcodeCounts[opcode]);
+        if (written < 0 || static_cast<size_t>(written) >= sizeof(opcodes) - length) {
+            // Output is truncated.
+            break;
+        }
+        length += written;
+    }
+    debugPrint("Video decode opcodes:%s\n", opcodes);
+}
+
 // 0x486E98
 static void _cleanupMovie(int a1)
 {
@@ -415,6 +450,12 @@ static void _cleanupMovie(int a1)
     MVE_rmFrameCounts(&frame, &dropped);
     debugPrint("Frames %d, dropped %d\n", frame, dropped);
 
+    // CE: Stop decode-ahead worker before last frame is copied, it might
+    // still decode into video buffer otherwise.
+    if (a1) {
+        MVE_rmEndMovie();
+    }
+
     if (_lastMovieBuffer != nullptr) {
         internal_free_safe(_lastMovieBuffer, __FILE__, __LINE__); // "..\\int\\MOVIE.C", 787
         _lastMovieBuffer = nullptr;
@@ -426,12 +467,11 @@ static void _cleanupMovie(int a1)
         MVE_lastBuffer = nullptr;
     }
 
-    if (a1) {
-        MVE_rmEndMovie();
-    }
-
     MVE_ReleaseMem();
 
+    // CE: Decoder statistics are read once decode-ahead thread is stopped.
+    movieLogDecodeStats();
+
     fileClose(gMovieFileStream);
 
     if (_alphaWindowBuf != nullptr) {
@@ -706,6 +746,10 @@ static int _movieStart(int win, char* filePath)
         movieLoadSubtitles(filePath);
     }
 
+    // CE: Decoding ahead is opt-in, it only pays off when presenting frames
+    // is expensive (high scaling factors).
+    MveSetDecodeAhead(settings.system.movie_decode_ahead);
+
     if ((gMovieFlags & MOVIE_EXTENDED_FLAG_0x04) != 0) {
         debugPrint("Direct ");
         windowGetRect(gMovieWindow, &gMovieWindowRect);
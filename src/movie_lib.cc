@@ -8,8 +8,23 @@
 #include <stdio.h>
 #include <string.h>
 
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#if defined(__SSE2__)
+#define NF_PK_SSE2
+#include <emmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#define NF_PK_NEON
+#include <arm_neon.h>
+#endif
+
 #include "audio_engine.h"
 #include "delay.h"
+#include "histogram.h"
 #include "platform_compat.h"
 
 namespace fallout {
@@ -30,6 +45,29 @@ typedef struct MveHeader {
 } MveHeader;
 #pragma pack()
 
+// CE: Number of frame slots in decode-ahead queue. One of them is always
+// reserved for the frame being presented.
+#define MVE_QUEUE_CAPACITY 4
+
+// CE: Frame read and decoded by `mveQueueDecodeFrame` (ahead by decode
+// worker, or in place when decoding ahead is disabled). Decoded pixels stay in
+// video decoder buffer, records stay in `records_mem` where they were read.
+// `chunks_mem` holds offsets of all non-video chunks which preceded frame show
+// chunk (in stream order, pointing to chunk headers) to be replayed on the
+// main thread.
+typedef struct MveQueueFrame {
+    unsigned char* pixels;
+    int width;
+    int height;
+    bool skip_show;
+    unsigned int decode_time;
+    MveMem records_mem;
+    unsigned int records_length;
+    MveMem chunks_mem;
+    unsigned int chunks_length;
+    int result;
+} MveQueueFrame;
+
 static void MVE_MemInit(MveMem* mem, unsigned int size, void* ptr);
 static void MVE_MemFree(MveMem* mem);
 static int _sub_4F4B5();
@@ -51,7 +89,7 @@ static int _MVE_sndAdd(unsigned char* dest, unsigned char** src_ptr, int a3, int
 static void _MVE_sndResume();
 static int nfConfig(int a1, int a2, int a3, int is_16_bpp);
 static void movieSwapSurfaces();
-static void sfShowFrame(int a1, int a2, int a3);
+static void sfShowFrame(MveQueueFrame* frame, int a1, int a2, int a3);
 static void _do_nothing_(int a1, int a2, unsigned short* a3);
 static void palSetPalette(int start, int count);
 static void palClrPalette(int start, int count);
@@ -65,6 +103,24 @@ static int _MVE_sndDecompM16(unsigned short* a1, unsigned char* a2, int a3, int
 static int _MVE_sndDecompS16(unsigned short* a1, unsigned char* a2, int a3, int a4);
 static void _nfPkConfig();
 static void _nfPkDecomp(unsigned char* buf, unsigned char* a2, int a3, int a4, int a5, int a6);
+static void nfPkBuildPatternMasks();
+static void nfPkCopyBlock(unsigned char* dest, const unsigned char* src, int pitch);
+static void nfPkDrawPattern2(unsigned char* dest, int pitch, const unsigned char* mask, int rows, unsigned char color0, unsigned char color1);
+static void nfPkDrawPattern4(unsigned char* dest, int pitch, const unsigned char* lo, const unsigned char* hi, int rows, const unsigned char* colors);
+static void mveQueueStart();
+static void mveQueueStop();
+static void mveQueueRelease();
+static void mveQueueThreadMain();
+static void mveQueueDecodeFrame(MveQueueFrame* frame);
+static void mveQueueUpdateStats(MveQueueFrame* frame);
+static unsigned char* mveQueueReadRecord(MveQueueFrame* frame);
+static unsigned char* mveQueueReserveRecords(MveQueueFrame* frame, unsigned int size);
+static bool mveQueueAppendChunk(MveQueueFrame* frame, unsigned char* chunk);
+static bool mveQueueWaitForPixels(unsigned char* pixels);
+static void* mveQueueMemAlloc(MveMem* mem, unsigned int size, unsigned int preserve);
+static void mveQueueMemRealloc(MveMem* mem, unsigned int size, unsigned int preserve);
+static void mveQueueServeMemAlloc();
+static MveQueueFrame* mveQueueNextFrame();
 
 // 0x51EBE0
 static unsigned short word_51EBE0[256] = {
@@ -309,6 +365,9 @@ static MveMem io_mem_buf;
 // 0x6B369C
 static unsigned int io_next_hdr;
 
+// CE: End of current record (excluding header of the next one).
+static unsigned char* io_record_end;
+
 // 0x6B36A0
 static int dword_6B36A0;
 
@@ -402,6 +461,18 @@ static int dword_6B402B;
 // 0x6B402F
 static int nf_height;
 
+// CE: Per-pixel selection masks for 2-color (opcodes 7 and 8) and 4-color
+// (opcodes 9 and 10) pattern bytes, built from pattern tables above. 0xFF
+// selects second color, or the color with corresponding index bit set.
+static unsigned char nf_pat2_mask[256][8];
+static unsigned char nf_pat4_lo[256][4];
+static unsigned char nf_pat4_hi[256][4];
+
+// CE: Video decoder statistics, maintained by decode worker and published
+// under `gMveQueueMutex`.
+static int nf_opcode_counts[16];
+static MveDecodeStats gMveDecodeStats;
+
 static MveMem nf_mem_cur;
 static unsigned char* nf_buf_cur;
 static MveMem nf_mem_prv;
@@ -410,6 +481,37 @@ static unsigned char* nf_buf_prv;
 static int gMveSoundBuffer = -1;
 static unsigned int gMveBufferBytes;
 
+// CE: Whether movies are decoded ahead on a worker thread, takes effect on
+// the next `MVE_rmPrepMovie`.
+static bool gMveDecodeAhead = false;
+
+// CE: Decode-ahead worker reads and decodes frames into `gMveQueueFrames`
+// while main thread presents them. Worker owns io and nf state, main thread
+// owns sync, sound and palette state. Both sides use `gMveQueueMutex` to
+// access queue counters and memory requests below. Without worker only the
+// first frame slot is used.
+static bool gMveQueueThreaded;
+static std::thread gMveQueueThread;
+static std::mutex gMveQueueMutex;
+static std::condition_variable gMveQueueCondition;
+static bool gMveQueueQuit;
+static MveQueueFrame gMveQueueFrames[MVE_QUEUE_CAPACITY];
+static unsigned int gMveQueueHead;
+static unsigned int gMveQueueTail;
+static int gMveQueueStallCount;
+
+// CE: Whether frame preceding `gMveQueueTail` is being presented. Worker does
+// not decode into video decoder buffer referenced by presented or queued
+// frame.
+static bool gMveQueuePresenting;
+static thread_local bool gMveQueueIsWorker = false;
+
+// CE: Memory allocator provided by the game is not thread-safe, so worker
+// asks main thread to (re)allocate its buffers.
+static MveMem* gMveQueueMemRequest;
+static unsigned int gMveQueueMemRequestSize;
+static unsigned int gMveQueueMemRequestPreserve;
+
 // 0x4F4800
 void MveSetMemory(MveMallocFunc* malloc_func, MveFreeFunc* free_func)
 {
@@ -423,6 +525,12 @@ void MveSetIO(MveReadFunc* read_func)
     mve_read_func = read_func;
 }
 
+// CE: Enables reading and decoding frames ahead on a worker thread.
+void MveSetDecodeAhead(bool enabled)
+{
+    gMveDecodeAhead = enabled;
+}
+
 // 0x4F4890
 static void MVE_MemInit(MveMem* mem, unsigned int size, void* ptr)
 {
@@ -489,9 +597,25 @@ void MVE_rmFrameCounts(int* frame_count_ptr, int* frame_drop_count_ptr)
     *frame_drop_count_ptr = rm_FrameDropCount;
 }
 
+// CE: Returns number of frames main thread had to wait for decode-ahead
+// worker.
+void MVE_rmStallCount(int* stall_count_ptr)
+{
+    *stall_count_ptr = gMveQueueStallCount;
+}
+
+// CE: Returns video decoder statistics of current (or last) movie.
+void MVE_rmDecodeStats(MveDecodeStats* stats)
+{
+    std::lock_guard<std::mutex> lock(gMveQueueMutex);
+    memcpy(stats, &gMveDecodeStats, sizeof(*stats));
+}
+
 // 0x4F4BF0
 int MVE_rmPrepMovie(void* handle, int dx, int dy, unsigned char track)
 {
+    mveQueueStop();
+
     rm_dx = dx;
     rm_dy = dy;
     rm_track_bit = 1 << track;
@@ -517,6 +641,8 @@ int MVE_rmPrepMovie(void* handle, int dx, int dy, unsigned char track)
     rm_FrameCount = 0;
     rm_FrameDropCount = 0;
 
+    mveQueueStart();
+
     return 0;
 }
 
@@ -572,6 +698,10 @@ static void* MVE_MemAlloc(MveMem* mem, unsigned int size)
         return mem->ptr;
     }
 
+    if (gMveQueueIsWorker) {
+        return mveQueueMemAlloc(mem, size, 0);
+    }
+
     if (mve_malloc_func == nullptr) {
         return nullptr;
     }
@@ -600,7 +730,8 @@ static unsigned char* ioNextRecord()
         return nullptr;
     }
 
-    io_next_hdr = *(unsigned int*)(buf + (io_next_hdr & 0xFFFF));
+    io_record_end = buf + (io_next_hdr & 0xFFFF);
+    io_next_hdr = *(unsigned int*)io_record_end;
 
     return buf;
 }
@@ -633,49 +764,34 @@ static void _MVE_sndPause()
 // 0x4F4EC0
 int _MVE_rmStepMovie()
 {
-    int v0;
-    unsigned short* v1;
     unsigned int v5;
+    unsigned short* v1;
     int v6;
     int v7;
     int v8;
-    int v9;
-    int v10;
-    unsigned short* v3;
-    unsigned short* v21;
     int v18;
     int v19;
     int v20;
     unsigned char* v14;
-
-    v0 = rm_len;
-    v1 = (unsigned short*)rm_p;
+    MveQueueFrame* frame;
+    unsigned char* chunk;
+    unsigned int index;
 
     if (!rm_active) {
         return -10;
     }
 
-LABEL_5:
-    v21 = nullptr;
-    v3 = nullptr;
-    if (!v1) {
-        v6 = -2;
-        MVE_rmEndMovie();
-        return v6;
-    }
+    // CE: Reading records and decoding video is done by `mveQueueDecodeFrame`
+    // (possibly ahead by decode worker), which leaves remaining chunks of the
+    // frame to be replayed here.
+    frame = mveQueueNextFrame();
 
-    while (1) {
-        v5 = *(unsigned int*)((unsigned char*)v1 + v0);
-        v1 = (unsigned short*)((unsigned char*)v1 + v0 + 4);
-        v0 = v5 & 0xFFFF;
+    for (index = 0; index < frame->chunks_length; index++) {
+        chunk = (unsigned char*)frame->records_mem.ptr + ((unsigned int*)frame->chunks_mem.ptr)[index];
+        v5 = *(unsigned int*)chunk;
+        v1 = (unsigned short*)(chunk + 4);
 
         switch ((v5 >> 16) & 0xFF) {
-        case 0:
-            return -1;
-        case 1:
-            v0 = 0;
-            v1 = (unsigned short*)ioNextRecord();
-            goto LABEL_5;
         case 2:
             if (!syncInit(v1[0], v1[2])) {
                 v6 = -3;
@@ -702,29 +818,6 @@ LABEL_5:
         case 4:
             // initialize audio buffers
             _MVE_sndSync();
-            continue;
-        case 5:
-            v9 = 0;
-            if ((v5 >> 24) >= 2) {
-                v9 = v1[3];
-            }
-
-            v10 = 1;
-            if ((v5 >> 24) >= 1) {
-                v10 = v1[2];
-            }
-
-            if (!nfConfig(v1[0], v1[1], v10, v9)) {
-                MVE_rmEndMovie();
-                return -5;
-            }
-
-            if (rm_dx + nf_width > sf_ScreenWidth
-                || rm_dy + nf_height > sf_ScreenHeight) {
-                MVE_rmEndMovie();
-                return -6;
-            }
-
             continue;
         case 7:
             ++rm_FrameCount;
@@ -735,30 +828,27 @@ LABEL_5:
             }
 
             v19 = v1[1];
-            if (v19 == 0 || v21) {
+            if (v19 == 0 || frame->skip_show) {
                 palSetPalette(v1[0], v19);
             } else {
                 palClrPalette(v1[0], v19);
             }
 
-            if (v21) {
-                _do_nothing_(rm_dx, rm_dy, v21);
+            if (frame->skip_show) {
+                _do_nothing_(rm_dx, rm_dy, nullptr);
             } else if (!sync_late || v1[1]) {
-                sfShowFrame(rm_dx, rm_dy, v18);
+                sfShowFrame(frame, rm_dx, rm_dy, v18);
             } else {
                 sync_FrameDropped = 1;
                 ++rm_FrameDropCount;
             }
 
             v20 = v1[1];
-            if (v20 && !v21) {
+            if (v20 && !frame->skip_show) {
                 palSetPalette(v1[0], v20);
             }
 
-            rm_p = (unsigned char*)v1;
-            rm_len = v0;
-
-            return 0;
+            continue;
         case 8:
         case 9:
             // push data to audio buffers?
@@ -780,29 +870,6 @@ LABEL_5:
         case 12:
             // palette
             palLoadPalette((unsigned char*)v1 + 4, v1[0], v1[1]);
-            continue;
-        case 14:
-            // save current position
-            v21 = v1;
-            continue;
-        case 15:
-            // save current position
-            v3 = v1;
-            continue;
-        case 17:
-            // decode video chunk
-            if ((v5 >> 24) < 3) {
-                v6 = -8;
-                break;
-            }
-
-            // swap movie surfaces
-            if (v1[6] & 0x01) {
-                movieSwapSurfaces();
-            }
-
-            _nfPkDecomp((unsigned char*)v3, (unsigned char*)&v1[7], v1[2], v1[3], v1[4], v1[5]);
-
             continue;
         default:
             // unknown chunk
@@ -810,8 +877,19 @@ LABEL_5:
         }
     }
 
-    MVE_rmEndMovie();
-    return v6;
+    if (frame->result != 0) {
+        // Last frame stays in the queue, make sure its chunks are not
+        // replayed again.
+        frame->chunks_length = 0;
+
+        v6 = frame->result;
+        if (v6 != -1) {
+            MVE_rmEndMovie();
+        }
+        return v6;
+    }
+
+    return 0;
 }
 
 // 0x4F54F0
@@ -1220,13 +1298,13 @@ static void movieSwapSurfaces()
 }
 
 // 0x4F5F40
-static void sfShowFrame(int dst_x, int dst_y, int a3)
+static void sfShowFrame(MveQueueFrame* frame, int dst_x, int dst_y, int a3)
 {
-    dst_x = (sf_ScreenWidth - nf_width) / 2;
-    dst_y = (sf_ScreenHeight - nf_height) / 2;
+    dst_x = (sf_ScreenWidth - frame->width) / 2;
+    dst_y = (sf_ScreenHeight - frame->height) / 2;
 
     if (a3 == 0) {
-        sf_ShowFrame(nf_buf_cur, nf_width, nf_height, 0, 0, nf_width, nf_height, dst_x, dst_y);
+        sf_ShowFrame(frame->pixels, frame->width, frame->height, 0, 0, frame->width, frame->height, dst_x, dst_y);
     }
 }
 
@@ -1282,6 +1360,8 @@ static void palLoadPalette(unsigned char* palette, int start, int count)
 // 0x4F6240
 void MVE_rmEndMovie()
 {
+    mveQueueStop();
+
     if (rm_active) {
         syncWait();
         syncRelease();
@@ -1303,6 +1383,7 @@ void MVE_ReleaseMem()
     ioRelease();
     _MVE_sndRelease();
     nfRelease();
+    mveQueueRelease();
 }
 
 // 0x4F6370
@@ -1398,6 +1479,8 @@ static void _nfPkConfig()
         v4 += v1;
         --v5;
     } while (v5);
+
+    nfPkBuildPatternMasks();
 }
 
 // 0x4F7359
@@ -1445,6 +1528,7 @@ static void _nfPkDecomp(unsigned char* a1, unsigned char* a2, int a3, int a4, in
             nibbles[1] = v8 >> 4;
             for (j = 0; j < 2; j++) {
                 v7 = nibbles[j];
+                nf_opcode_counts[v7]++;
 
                 switch (v7) {
                 case 1:
@@ -1486,17 +1570,24 @@ static void _nfPkDecomp(unsigned char* a1, unsigned char* a2, int a3, int a4, in
 
                     value2 = nf_width;
 
-                    for (i = 0; i < 8; i++) {
-                        src_ptr = (unsigned int*)(dest + v10);
-                        dest_ptr = (unsigned int*)dest;
+                    // CE: Copy rows at once unless source overlaps
+                    // destination row.
+                    if (v10 >= 8 || v10 <= -8) {
+                        nfPkCopyBlock(dest, dest + v10, value2);
+                        dest += value2 * 7;
+                    } else {
+                        for (i = 0; i < 8; i++) {
+                            src_ptr = (unsigned int*)(dest + v10);
+                            dest_ptr = (unsigned int*)dest;
 
-                        dest_ptr[0] = src_ptr[0];
-                        dest_ptr[1] = src_ptr[1];
+                            dest_ptr[0] = src_ptr[0];
+                            dest_ptr[1] = src_ptr[1];
 
-                        dest += value2;
-                    }
+                            dest += value2;
+                        }
 
-                    dest -= value2;
+                        dest -= value2;
+                    }
 
                     dest -= var_10;
 
@@ -1562,29 +1653,13 @@ static void _nfPkDecomp(unsigned char* a1, unsigned char* a2, int a3, int a4, in
                         // 7/2
                         // VERIFIED
                         for (i = 0; i < 8; i++) {
-                            value1 = _$$R0004[a2[2 + i]];
-                            map1[i * 4] = value1 & 0xFF;
-                            map1[i * 4 + 1] = (value1 >> 8) & 0xFF;
-                            map1[i * 4 + 2] = (value1 >> 16) & 0xFF;
-                            map1[i * 4 + 3] = (value1 >> 24) & 0xFF;
+                            memcpy(map1 + i * 8, nf_pat2_mask[a2[2 + i]], 8);
                         }
 
-                        map2[0xC1] = (a2[1] << 8) | a2[0]; // cx
-                        map2[0xC3] = (a2[0] << 8) | a2[0]; // bx
-                        map2[0xC2] = (a2[0] << 8) | a2[1]; // dx
-                        map2[0xC5] = (a2[1] << 8) | a2[1]; // bp
-
                         value2 = nf_width;
 
-                        for (i = 0; i < 8; i++) {
-                            dest_ptr = (unsigned int*)dest;
-                            dest_ptr[0] = (map2[map1[i * 4]] << 16) | map2[map1[i * 4 + 1]];
-                            dest_ptr[1] = (map2[map1[i * 4 + 2]] << 16) | map2[map1[i * 4 + 3]];
-
-                            dest += value2;
-                        }
-
-                        dest -= value2;
+                        nfPkDrawPattern2(dest, value2, map1, 8, a2[0], a2[1]);
+                        dest += value2 * 7;
 
                         a2 += 10;
                         dest -= var_10;
@@ -1596,50 +1671,15 @@ static void _nfPkDecomp(unsigned char* a1, unsigned char* a2, int a3, int a4, in
                         if (a2[6] > a2[7]) {
                             // 8/1
                             for (i = 0; i < 4; i++) {
-                                value1 = _$$R0004[a2[2 + i]];
-                                map1[i * 4] = value1 & 0xFF;
-                                map1[i * 4 + 1] = (value1 >> 8) & 0xFF;
-                                map1[i * 4 + 2] = (value1 >> 16) & 0xFF;
-                                map1[i * 4 + 3] = (value1 >> 24) & 0xFF;
-                            }
-
-                            for (i = 0; i < 4; i++) {
-                                value1 = _$$R0004[a2[8 + i]];
-                                map1[16 + i * 4] = value1 & 0xFF;
-                                map1[16 + i * 4 + 1] = (value1 >> 8) & 0xFF;
-                                map1[16 + i * 4 + 2] = (value1 >> 16) & 0xFF;
-                                map1[16 + i * 4 + 3] = (value1 >> 24) & 0xFF;
+                                memcpy(map1 + i * 8, nf_pat2_mask[a2[2 + i]], 8);
+                                memcpy(map1 + 32 + i * 8, nf_pat2_mask[a2[8 + i]], 8);
                             }
 
                             value2 = nf_width;
 
-                            map2[0xC1] = (a2[1] << 8) | a2[0]; // cx
-                            map2[0xC3] = (a2[0] << 8) | a2[0]; // bx
-                            map2[0xC2] = (a2[0] << 8) | a2[1]; // dx
-                            map2[0xC5] = (a2[1] << 8) | a2[1]; // bp
-
-                            for (i = 0; i < 4; i++) {
-                                dest_ptr = (unsigned int*)dest;
-                                dest_ptr[0] = (map2[map1[i * 4]] << 16) | map2[map1[i * 4 + 1]];
-                                dest_ptr[1] = (map2[map1[i * 4 + 2]] << 16) | map2[map1[i * 4 + 3]];
-
-                                dest += value2;
-                            }
-
-                            map2[0xC1] = (a2[6 + 1] << 8) | a2[6 + 0]; // cx
-                            map2[0xC3] = (a2[6 + 0] << 8) | a2[6 + 0]; // bx
-                            map2[0xC2] = (a2[6 + 0] << 8) | a2[6 + 1]; // dx
-                            map2[0xC5] = (a2[6 + 1] << 8) | a2[6 + 1]; // bp
-
-                            for (i = 0; i < 4; i++) {
-                                dest_ptr = (unsigned int*)dest;
-                                dest_ptr[0] = (map2[map1[16 + i * 4]] << 16) | map2[map1[16 + i * 4 + 1]];
-                                dest_ptr[1] = (map2[map1[16 + i * 4 + 2]] << 16) | map2[map1[16 + i * 4 + 3]];
-
-                                dest += value2;
-                            }
-
-                            dest -= value2;
+                            nfPkDrawPattern2(dest, value2, map1, 4, a2[0], a2[1]);
+                            nfPkDrawPattern2(dest + value2 * 4, value2, map1 + 32, 4, a2[6 + 0], a2[6 + 1]);
+                            dest += value2 * 7;
 
                             a2 += 12;
                             dest -= var_10;
@@ -1814,37 +1854,16 @@ static void _nfPkDecomp(unsigned char* a1, unsigned char* a2, int a3, int a4, in
                             // 9/1
                             // VERIFIED
                             for (i = 0; i < 8; i++) {
-                                value1 = _$$R0063[a2[4 + i]];
-                                map1[i * 4] = value1 & 0xFF;
-                                map1[i * 4 + 1] = (value1 >> 8) & 0xFF;
-                                map1[i * 4 + 2] = (value1 >> 16) & 0xFF;
-                                map1[i * 4 + 3] = (value1 >> 24) & 0xFF;
+                                memcpy(map1 + (i >> 1) * 16 + (i & 1) * 4, nf_pat4_lo[a2[4 + i]], 4);
+                                memcpy(map1 + (i >> 1) * 16 + (i & 1) * 4 + 8, nf_pat4_lo[a2[4 + i]], 4);
+                                memcpy(map1 + 64 + (i >> 1) * 16 + (i & 1) * 4, nf_pat4_hi[a2[4 + i]], 4);
+                                memcpy(map1 + 64 + (i >> 1) * 16 + (i & 1) * 4 + 8, nf_pat4_hi[a2[4 + i]], 4);
                             }
 
-                            map2[0xC1] = a2[2]; // mov al, cl
-                            map2[0xC3] = a2[0]; // mov al, bl
-                            map2[0xC5] = a2[3]; // mov al, ch
-                            map2[0xC7] = a2[1]; // mov al, bh
-                            map2[0xE1] = a2[2]; // mov ah, cl
-                            map2[0xE3] = a2[0]; // mov ah, bl
-                            map2[0xE5] = a2[3]; // mov ah, ch
-                            map2[0xE7] = a2[1]; // mov ah, bh
-
                             value2 = nf_width;
 
-                            for (i = 0; i < 4; i++) {
-                                dest_ptr = (unsigned int*)dest;
-                                dest_ptr[0] = (map2[map1[i * 8]] << 16) | (map2[map1[i * 8 + 1]] << 24) | (map2[map1[i * 8 + 2]]) | (map2[map1[i * 8 + 3]] << 8);
-                                dest_ptr[1] = (map2[map1[i * 8 + 4]] << 16) | (map2[map1[i * 8 + 5]] << 24) | (map2[map1[i * 8 + 6]]) | (map2[map1[i * 8 + 7]] << 8);
-
-                                dest_ptr = (unsigned int*)(dest + value2);
-                                dest_ptr[0] = (map2[map1[i * 8]] << 16) | (map2[map1[i * 8 + 1]] << 24) | (map2[map1[i * 8 + 2]]) | (map2[map1[i * 8 + 3]] << 8);
-                                dest_ptr[1] = (map2[map1[i * 8 + 4]] << 16) | (map2[map1[i * 8 + 5]] << 24) | (map2[map1[i * 8 + 6]]) | (map2[map1[i * 8 + 7]] << 8);
-
-                                dest += value2 * 2;
-                            }
-
-                            dest -= value2;
+                            nfPkDrawPattern4(dest, value2, map1, map1 + 64, 8, a2);
+                            dest += value2 * 7;
 
                             a2 += 12;
                             dest -= var_10;
@@ -1928,32 +1947,14 @@ static void _nfPkDecomp(unsigned char* a1, unsigned char* a2, int a3, int a4, in
                             // 9/4
                             // VERIFIED
                             for (i = 0; i < 16; i++) {
-                                value1 = _$$R0063[a2[4 + i]];
-                                map1[i * 4] = value1 & 0xFF;
-                                map1[i * 4 + 1] = (value1 >> 8) & 0xFF;
-                                map1[i * 4 + 2] = (value1 >> 16) & 0xFF;
-                                map1[i * 4 + 3] = (value1 >> 24) & 0xFF;
+                                memcpy(map1 + i * 4, nf_pat4_lo[a2[4 + i]], 4);
+                                memcpy(map1 + 64 + i * 4, nf_pat4_hi[a2[4 + i]], 4);
                             }
 
-                            map2[0xC1] = a2[2]; // mov al, cl
-                            map2[0xC3] = a2[0]; // mov al, bl
-                            map2[0xC5] = a2[3]; // mov al, ch
-                            map2[0xC7] = a2[1]; // mov al, bh
-                            map2[0xE1] = a2[2]; // mov ah, cl
-                            map2[0xE3] = a2[0]; // mov ah, bl
-                            map2[0xE5] = a2[3]; // mov ah, ch
-                            map2[0xE7] = a2[1]; // mov ah, bh
-
                             value2 = nf_width;
 
-                            for (i = 0; i < 8; i++) {
-                                dest_ptr = (unsigned int*)dest;
-                                dest_ptr[0] = (map2[map1[i * 8 + 0]] << 16) | (map2[map1[i * 8 + 1]] << 24) | (map2[map1[i * 8 + 2]]) | (map2[map1[i * 8 + 3]] << 8);
-                                dest_ptr[1] = (map2[map1[i * 8 + 4]] << 16) | (map2[map1[i * 8 + 5]] << 24) | (map2[map1[i * 8 + 6]]) | (map2[map1[i * 8 + 7]] << 8);
-                                dest += value2;
-                            }
-
-                            dest -= value2;
+                            nfPkDrawPattern4(dest, value2, map1, map1 + 64, 8, a2);
+                            dest += value2 * 7;
 
                             a2 += 20;
                             dest -= var_10;
@@ -1966,56 +1967,17 @@ static void _nfPkDecomp(unsigned char* a1, unsigned char* a2, int a3, int a4, in
                             // 10/1
                             // VERIFIED
                             for (i = 0; i < 8; i++) {
-                                value1 = _$$R0063[a2[4 + i]];
-                                map1[i * 4] = value1 & 0xFF;
-                                map1[i * 4 + 1] = (value1 >> 8) & 0xFF;
-                                map1[i * 4 + 2] = (value1 >> 16) & 0xFF;
-                                map1[i * 4 + 3] = (value1 >> 24) & 0xFF;
-                            }
-
-                            for (i = 0; i < 8; i++) {
-                                value1 = _$$R0063[a2[16 + i]];
-                                map1[32 + i * 4] = value1 & 0xFF;
-                                map1[32 + i * 4 + 1] = (value1 >> 8) & 0xFF;
-                                map1[32 + i * 4 + 2] = (value1 >> 16) & 0xFF;
-                                map1[32 + i * 4 + 3] = (value1 >> 24) & 0xFF;
+                                memcpy(map1 + i * 4, nf_pat4_lo[a2[4 + i]], 4);
+                                memcpy(map1 + 32 + i * 4, nf_pat4_hi[a2[4 + i]], 4);
+                                memcpy(map1 + 64 + i * 4, nf_pat4_lo[a2[16 + i]], 4);
+                                memcpy(map1 + 96 + i * 4, nf_pat4_hi[a2[16 + i]], 4);
                             }
 
                             value2 = nf_width;
 
-                            map2[0xC1] = a2[2]; // mov al, cl
-                            map2[0xC3] = a2[0]; // mov al, bl
-                            map2[0xC5] = a2[3]; // mov al, ch
-                            map2[0xC7] = a2[1]; // mov al, bh
-                            map2[0xE1] = a2[2]; // mov ah, cl
-                            map2[0xE3] = a2[0]; // mov ah, bl
-                            map2[0xE5] = a2[3]; // mov ah, ch
-                            map2[0xE7] = a2[1]; // mov ah, bh
-
-                            for (i = 0; i < 4; i++) {
-                                dest_ptr = (unsigned int*)dest;
-                                dest_ptr[0] = (map2[map1[i * 8 + 0]] << 16) | (map2[map1[i * 8 + 1]] << 24) | (map2[map1[i * 8 + 2]]) | (map2[map1[i * 8 + 3]] << 8);
-                                dest_ptr[1] = (map2[map1[i * 8 + 4]] << 16) | (map2[map1[i * 8 + 5]] << 24) | (map2[map1[i * 8 + 6]]) | (map2[map1[i * 8 + 7]] << 8);
-                                dest += value2;
-                            }
-
-                            map2[0xC1] = a2[0x0C + 2]; // mov al, cl
-                            map2[0xC3] = a2[0x0C + 0]; // mov al, bl
-                            map2[0xC5] = a2[0x0C + 3]; // mov al, ch
-                            map2[0xC7] = a2[0x0C + 1]; // mov al, bh
-                            map2[0xE1] = a2[0x0C + 2]; // mov ah, cl
-                            map2[0xE3] = a2[0x0C + 0]; // mov ah, bl
-                            map2[0xE5] = a2[0x0C + 3]; // mov ah, ch
-                            map2[0xE7] = a2[0x0C + 1]; // mov ah, bh
-
-                            for (i = 0; i < 4; i++) {
-                                dest_ptr = (unsigned int*)dest;
-                                dest_ptr[0] = (map2[map1[32 + i * 8 + 0]] << 16) | (map2[map1[32 + i * 8 + 1]] << 24) | (map2[map1[32 + i * 8 + 2]]) | (map2[map1[32 + i * 8 + 3]] << 8);
-                                dest_ptr[1] = (map2[map1[32 + i * 8 + 4]] << 16) | (map2[map1[32 + i * 8 + 5]] << 24) | (map2[map1[32 + i * 8 + 6]]) | (map2[map1[32 + i * 8 + 7]] << 8);
-                                dest += value2;
-                            }
-
-                            dest -= value2;
+                            nfPkDrawPattern4(dest, value2, map1, map1 + 32, 4, a2);
+                            nfPkDrawPattern4(dest + value2 * 4, value2, map1 + 64, map1 + 96, 4, a2 + 0x0C);
+                            dest += value2 * 7;
 
                             a2 += 24;
                             dest -= var_10;
@@ -2211,15 +2173,12 @@ static void _nfPkDecomp(unsigned char* a1, unsigned char* a2, int a3, int a4, in
                 case 11:
                     value2 = nf_width;
 
-                    src_ptr = (unsigned int*)a2;
+                    // CE: Source is packed, copy rows one by one.
                     for (i = 0; i < 8; i++) {
-                        dest_ptr = (unsigned int*)dest;
-                        dest_ptr[0] = src_ptr[i * 2];
-                        dest_ptr[1] = src_ptr[i * 2 + 1];
-                        dest += value2;
+                        memcpy(dest + value2 * i, a2 + i * 8, 8);
                     }
 
-                    dest -= value2;
+                    dest += value2 * 7;
 
                     a2 += 64;
                     dest -= var_10;
@@ -2336,4 +2295,576 @@ static void _nfPkDecomp(unsigned char* a1, unsigned char* a2, int a3, int a4, in
     }
 }
 
+// Builds pixel masks for pattern opcodes by evaluating pattern tables the
+// same way `_nfPkDecomp` does with synthetic colors.
+static void nfPkBuildPatternMasks()
+{
+    unsigned int map2[256];
+    unsigned int row[2];
+    unsigned char indexes[4];
+    unsigned int value1;
+    unsigned int value2;
+
+    // See 7/2.
+    map2[0xC1] = 0xFF00;
+    map2[0xC3] = 0x0000;
+    map2[0xC2] = 0x00FF;
+    map2[0xC5] = 0xFFFF;
+
+    for (int byte = 0; byte < 256; byte++) {
+        value1 = _$$R0004[byte];
+        row[0] = (map2[value1 & 0xFF] << 16) | map2[(value1 >> 8) & 0xFF];
+        row[1] = (map2[(value1 >> 16) & 0xFF] << 16) | map2[(value1 >> 24) & 0xFF];
+        memcpy(nf_pat2_mask[byte], row, 8);
+    }
+
+    // See 9/4, colors are replaced with their indexes.
+    map2[0xC1] = 2;
+    map2[0xC3] = 0;
+    map2[0xC5] = 3;
+    map2[0xC7] = 1;
+    map2[0xE1] = 2;
+    map2[0xE3] = 0;
+    map2[0xE5] = 3;
+    map2[0xE7] = 1;
+
+    for (int byte = 0; byte < 256; byte++) {
+        value1 = _$$R0063[byte];
+        value2 = (map2[value1 & 0xFF] << 16) | (map2[(value1 >> 8) & 0xFF] << 24) | (map2[(value1 >> 16) & 0xFF]) | (map2[(value1 >> 24) & 0xFF] << 8);
+        memcpy(indexes, &value2, 4);
+
+        for (int index = 0; index < 4; index++) {
+            nf_pat4_lo[byte][index] = (indexes[index] & 1) != 0 ? 0xFF : 0x00;
+            nf_pat4_hi[byte][index] = (indexes[index] & 2) != 0 ? 0xFF : 0x00;
+        }
+    }
+}
+
+// Copies 8x8 block, source must not overlap destination rows.
+static void nfPkCopyBlock(unsigned char* dest, const unsigned char* src, int pitch)
+{
+    for (int row = 0; row < 8; row++) {
+        memcpy(dest, src, 8);
+        dest += pitch;
+        src += pitch;
+    }
+}
+
+// Draws 8 pixels wide pattern of `rows` (even) rows, `mask` contains 8 bytes
+// per row.
+static void nfPkDrawPattern2(unsigned char* dest, int pitch, const unsigned char* mask, int rows, unsigned char color0, unsigned char color1)
+{
+#if defined(NF_PK_SSE2)
+    __m128i c0 = _mm_set1_epi8((char)color0);
+    __m128i c1 = _mm_set1_epi8((char)color1);
+
+    for (int row = 0; row < rows; row += 2) {
+        __m128i m = _mm_loadu_si128((const __m128i*)(mask + row * 8));
+        __m128i pixels = _mm_or_si128(_mm_and_si128(m, c1), _mm_andnot_si128(m, c0));
+        _mm_storel_epi64((__m128i*)dest, pixels);
+        _mm_storel_epi64((__m128i*)(dest + pitch), _mm_unpackhi_epi64(pixels, pixels));
+        dest += pitch * 2;
+    }
+#elif defined(NF_PK_NEON)
+    uint8x16_t c0 = vdupq_n_u8(color0);
+    uint8x16_t c1 = vdupq_n_u8(color1);
+
+    for (int row = 0; row < rows; row += 2) {
+        uint8x16_t pixels = vbslq_u8(vld1q_u8(mask + row * 8), c1, c0);
+        vst1_u8(dest, vget_low_u8(pixels));
+        vst1_u8(dest + pitch, vget_high_u8(pixels));
+        dest += pitch * 2;
+    }
+#else
+    unsigned long long c0 = color0 * 0x0101010101010101ULL;
+    unsigned long long c1 = color1 * 0x0101010101010101ULL;
+
+    for (int row = 0; row < rows; row++) {
+        unsigned long long m;
+        memcpy(&m, mask + row * 8, 8);
+
+        unsigned long long pixels = (m & c1) | (~m & c0);
+        memcpy(dest, &pixels, 8);
+        dest += pitch;
+    }
+#endif
+}
+
+// Draws 8 pixels wide pattern of `rows` (even) rows, `lo` and `hi` contain 8
+// bytes per row and select one of four `colors`.
+static void nfPkDrawPattern4(unsigned char* dest, int pitch, const unsigned char* lo, const unsigned char* hi, int rows, const unsigned char* colors)
+{
+#if defined(NF_PK_SSE2)
+    __m128i c0 = _mm_set1_epi8((char)colors[0]);
+    __m128i c1 = _mm_set1_epi8((char)colors[1]);
+    __m128i c2 = _mm_set1_epi8((char)colors[2]);
+    __m128i c3 = _mm_set1_epi8((char)colors[3]);
+
+    for (int row = 0; row < rows; row += 2) {
+        __m128i l = _mm_loadu_si128((const __m128i*)(lo + row * 8));
+        __m128i h = _mm_loadu_si128((const __m128i*)(hi + row * 8));
+        __m128i a = _mm_or_si128(_mm_and_si128(l, c1), _mm_andnot_si128(l, c0));
+        __m128i b = _mm_or_si128(_mm_and_si128(l, c3), _mm_andnot_si128(l, c2));
+        __m128i pixels = _mm_or_si128(_mm_and_si128(h, b), _mm_andnot_si128(h, a));
+        _mm_storel_epi64((__m128i*)dest, pixels);
+        _mm_storel_epi64((__m128i*)(dest + pitch), _mm_unpackhi_epi64(pixels, pixels));
+        dest += pitch * 2;
+    }
+#elif defined(NF_PK_NEON)
+    uint8x16_t c0 = vdupq_n_u8(colors[0]);
+    uint8x16_t c1 = vdupq_n_u8(colors[1]);
+    uint8x16_t c2 = vdupq_n_u8(colors[2]);
+    uint8x16_t c3 = vdupq_n_u8(colors[3]);
+
+    for (int row = 0; row < rows; row += 2) {
+        uint8x16_t l = vld1q_u8(lo + row * 8);
+        uint8x16_t h = vld1q_u8(hi + row * 8);
+        uint8x16_t pixels = vbslq_u8(h, vbslq_u8(l, c3, c2), vbslq_u8(l, c1, c0));
+        vst1_u8(dest, vget_low_u8(pixels));
+        vst1_u8(dest + pitch, vget_high_u8(pixels));
+        dest += pitch * 2;
+    }
+#else
+    unsigned long long c0 = colors[0] * 0x0101010101010101ULL;
+    unsigned long long c1 = colors[1] * 0x0101010101010101ULL;
+    unsigned long long c2 = colors[2] * 0x0101010101010101ULL;
+    unsigned long long c3 = colors[3] * 0x0101010101010101ULL;
+
+    for (int row = 0; row < rows; row++) {
+        unsigned long long l;
+        unsigned long long h;
+        memcpy(&l, lo + row * 8, 8);
+        memcpy(&h, hi + row * 8, 8);
+
+        unsigned long long a = (l & c1) | (~l & c0);
+        unsigned long long b = (l & c3) | (~l & c2);
+        unsigned long long pixels = (h & b) | (~h & a);
+        memcpy(dest, &pixels, 8);
+        dest += pitch;
+    }
+#endif
+}
+
+static void mveQueueStart()
+{
+    gMveQueueQuit = false;
+    gMveQueueHead = 0;
+    gMveQueueTail = 0;
+    gMveQueueStallCount = 0;
+    gMveQueuePresenting = false;
+    gMveQueueMemRequest = nullptr;
+    gMveQueueThreaded = gMveDecodeAhead;
+
+    for (int index = 0; index < MVE_QUEUE_CAPACITY; index++) {
+        MveQueueFrame* frame = &(gMveQueueFrames[index]);
+        frame->pixels = nullptr;
+        frame->chunks_length = 0;
+        frame->result = 0;
+    }
+
+    memset(&gMveDecodeStats, 0, sizeof(gMveDecodeStats));
+    memset(nf_opcode_counts, 0, sizeof(nf_opcode_counts));
+
+    if (gMveQueueThreaded) {
+        gMveQueueThread = std::thread(mveQueueThreadMain);
+    }
+}
+
+static void mveQueueStop()
+{
+    if (!gMveQueueThread.joinable()) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(gMveQueueMutex);
+        gMveQueueQuit = true;
+    }
+    gMveQueueCondition.notify_all();
+    gMveQueueThread.join();
+}
+
+static void mveQueueRelease()
+{
+    for (int index = 0; index < MVE_QUEUE_CAPACITY; index++) {
+        MveQueueFrame* frame = &(gMveQueueFrames[index]);
+        frame->pixels = nullptr;
+        MVE_MemFree(&(frame->records_mem));
+        frame->records_length = 0;
+        MVE_MemFree(&(frame->chunks_mem));
+        frame->chunks_length = 0;
+    }
+}
+
+static void mveQueueThreadMain()
+{
+    gMveQueueIsWorker = true;
+
+    std::unique_lock<std::mutex> lock(gMveQueueMutex);
+    while (!gMveQueueQuit) {
+        if (gMveQueueHead - gMveQueueTail >= MVE_QUEUE_CAPACITY - 1) {
+            gMveQueueCondition.wait(lock);
+            continue;
+        }
+
+        MveQueueFrame* frame = &(gMveQueueFrames[gMveQueueHead % MVE_QUEUE_CAPACITY]);
+        lock.unlock();
+
+        mveQueueDecodeFrame(frame);
+
+        lock.lock();
+        if (gMveQueueQuit) {
+            break;
+        }
+
+        gMveQueueHead++;
+        gMveQueueCondition.notify_all();
+
+        mveQueueUpdateStats(frame);
+
+        if (frame->result != 0) {
+            break;
+        }
+    }
+}
+
+// Reads movie records up to and including next frame show chunk, decodes
+// video chunks and collects offsets of everything else for
+// `_MVE_rmStepMovie`.
+//
+// See `_MVE_rmStepMovie` for chunk layout.
+static void mveQueueDecodeFrame(MveQueueFrame* frame)
+{
+    int v0;
+    unsigned short* v1;
+    unsigned int v5;
+    unsigned char* chunk;
+    unsigned short* v3;
+    unsigned short* v21;
+    unsigned char* records;
+    unsigned int remainder;
+    std::chrono::steady_clock::time_point start;
+
+    frame->pixels = nullptr;
+    frame->chunks_length = 0;
+    frame->skip_show = false;
+    frame->decode_time = 0;
+    frame->result = 0;
+
+    // Move the rest of the current record (which might reside in previous
+    // frame) to the beginning of this frame's records.
+    remainder = (unsigned int)(io_record_end - (rm_p + rm_len));
+    frame->records_length = 0;
+
+    records = mveQueueReserveRecords(frame, remainder);
+    if (records == nullptr) {
+        frame->result = -8;
+        return;
+    }
+
+    memmove(records, rm_p + rm_len, remainder);
+    frame->records_length = remainder;
+    io_record_end = records + remainder;
+
+    v0 = 0;
+    v1 = (unsigned short*)records;
+
+LABEL_5:
+    v21 = nullptr;
+    v3 = nullptr;
+    if (!v1) {
+        frame->result = -2;
+        return;
+    }
+
+    while (1) {
+        chunk = (unsigned char*)v1 + v0;
+        v5 = *(unsigned int*)chunk;
+        v1 = (unsigned short*)(chunk + 4);
+        v0 = v5 & 0xFFFF;
+
+        switch ((v5 >> 16) & 0xFF) {
+        case 0:
+            frame->result = -1;
+            return;
+        case 1:
+            v0 = 0;
+            v1 = (unsigned short*)mveQueueReadRecord(frame);
+            goto LABEL_5;
+        case 5:
+            // Video decoder buffers are about to be reallocated.
+            if (!mveQueueWaitForPixels(nullptr)) {
+                frame->result = -1;
+                return;
+            }
+
+            if (!nfConfig(v1[0], v1[1], (v5 >> 24) >= 1 ? v1[2] : 1, (v5 >> 24) >= 2 ? v1[3] : 0)) {
+                frame->result = -5;
+                return;
+            }
+
+            if (rm_dx + nf_width > sf_ScreenWidth
+                || rm_dy + nf_height > sf_ScreenHeight) {
+                frame->result = -6;
+                return;
+            }
+
+            continue;
+        case 7:
+            if (!mveQueueAppendChunk(frame, chunk)) {
+                frame->result = -8;
+                return;
+            }
+
+            frame->skip_show = v21 != nullptr;
+            if (!frame->skip_show) {
+                frame->pixels = nf_buf_cur;
+                frame->width = nf_width;
+                frame->height = nf_height;
+            }
+
+            rm_p = (unsigned char*)v1;
+            rm_len = v0;
+            return;
+        case 14:
+            // save current position
+            v21 = v1;
+            continue;
+        case 15:
+            // save current position
+            v3 = v1;
+            continue;
+        case 17:
+            // decode video chunk
+            if ((v5 >> 24) < 3) {
+                continue;
+            }
+
+            // swap movie surfaces
+            if (v1[6] & 0x01) {
+                movieSwapSurfaces();
+            }
+
+            if (!mveQueueWaitForPixels(nf_buf_cur)) {
+                frame->result = -1;
+                return;
+            }
+
+            start = std::chrono::steady_clock::now();
+            _nfPkDecomp((unsigned char*)v3, (unsigned char*)&v1[7], v1[2], v1[3], v1[4], v1[5]);
+            frame->decode_time += (unsigned int)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+
+            continue;
+        default:
+            if (!mveQueueAppendChunk(frame, chunk)) {
+                frame->result = -8;
+                return;
+            }
+            continue;
+        }
+    }
+}
+
+// NOTE: Must be called with `gMveQueueMutex` held when decoding ahead.
+static void mveQueueUpdateStats(MveQueueFrame* frame)
+{
+    if (frame->result == 0) {
+        gMveDecodeStats.frames++;
+        gMveDecodeStats.time += frame->decode_time;
+        gMveDecodeStats.timeHistogram[histogramGetBucket(frame->decode_time, MVE_DECODE_TIME_BUCKET_WIDTH, MVE_DECODE_TIME_BUCKETS)]++;
+        memcpy(gMveDecodeStats.opcodeCounts, nf_opcode_counts, sizeof(nf_opcode_counts));
+    }
+}
+
+// Same as `ioNextRecord`, but appends record to frame's records, so that
+// chunks can be replayed from there without copying.
+static unsigned char* mveQueueReadRecord(MveQueueFrame* frame)
+{
+    unsigned int size;
+    unsigned char* buf;
+
+    size = (io_next_hdr & 0xFFFF) + 4;
+
+    buf = mveQueueReserveRecords(frame, size);
+    if (buf == nullptr) {
+        return nullptr;
+    }
+
+    if (mve_read_func(io_handle, buf, size) < 1) {
+        return nullptr;
+    }
+
+    frame->records_length += size;
+
+    io_record_end = buf + (io_next_hdr & 0xFFFF);
+    io_next_hdr = *(unsigned int*)io_record_end;
+
+    return buf;
+}
+
+// Makes room for `size` more bytes of frame's records, returns pointer past
+// current records.
+static unsigned char* mveQueueReserveRecords(MveQueueFrame* frame, unsigned int size)
+{
+    unsigned int required = frame->records_length + size;
+    if (frame->records_mem.size == 0 || frame->records_mem.size < required) {
+        if (mveQueueMemAlloc(&(frame->records_mem), required * 2, frame->records_length) == nullptr) {
+            return nullptr;
+        }
+    }
+
+    return (unsigned char*)frame->records_mem.ptr + frame->records_length;
+}
+
+static bool mveQueueAppendChunk(MveQueueFrame* frame, unsigned char* chunk)
+{
+    unsigned int required = (frame->chunks_length + 1) * sizeof(unsigned int);
+    if (frame->chunks_mem.size < required) {
+        if (mveQueueMemAlloc(&(frame->chunks_mem), required * 2, frame->chunks_length * sizeof(unsigned int)) == nullptr) {
+            return false;
+        }
+    }
+
+    ((unsigned int*)frame->chunks_mem.ptr)[frame->chunks_length] = (unsigned int)(chunk - (unsigned char*)frame->records_mem.ptr);
+    frame->chunks_length++;
+
+    return true;
+}
+
+// Waits until `pixels` (or any video decoder buffer if `nullptr`) is no
+// longer referenced by frames queued or being presented by main thread.
+// Returns `false` if decode worker is stopped meanwhile.
+static bool mveQueueWaitForPixels(unsigned char* pixels)
+{
+    if (!gMveQueueThreaded) {
+        return true;
+    }
+
+    std::unique_lock<std::mutex> lock(gMveQueueMutex);
+    while (!gMveQueueQuit) {
+        unsigned int index = gMveQueueTail - (gMveQueuePresenting ? 1 : 0);
+        while (index != gMveQueueHead) {
+            unsigned char* queued = gMveQueueFrames[index % MVE_QUEUE_CAPACITY].pixels;
+            if (queued != nullptr && (pixels == nullptr || queued == pixels)) {
+                break;
+            }
+            index++;
+        }
+
+        if (index == gMveQueueHead) {
+            return true;
+        }
+
+        gMveQueueCondition.wait(lock);
+    }
+
+    return false;
+}
+
+// Reallocates `mem` to hold at least `size` bytes, keeping first `preserve`
+// bytes. Decode worker asks main thread to do it and blocks until request is
+// served.
+static void* mveQueueMemAlloc(MveMem* mem, unsigned int size, unsigned int preserve)
+{
+    if (!gMveQueueIsWorker) {
+        mveQueueMemRealloc(mem, size, preserve);
+        return mem->size >= size ? mem->ptr : nullptr;
+    }
+
+    std::unique_lock<std::mutex> lock(gMveQueueMutex);
+    gMveQueueMemRequest = mem;
+    gMveQueueMemRequestSize = size;
+    gMveQueueMemRequestPreserve = preserve;
+    gMveQueueCondition.notify_all();
+
+    while (gMveQueueMemRequest != nullptr && !gMveQueueQuit) {
+        gMveQueueCondition.wait(lock);
+    }
+
+    if (gMveQueueMemRequest != nullptr) {
+        gMveQueueMemRequest = nullptr;
+        return nullptr;
+    }
+
+    return mem->size >= size ? mem->ptr : nullptr;
+}
+
+static void mveQueueMemRealloc(MveMem* mem, unsigned int size, unsigned int preserve)
+{
+    if (mve_malloc_func == nullptr) {
+        return;
+    }
+
+    void* ptr = mve_malloc_func(size + 100);
+    if (ptr == nullptr) {
+        return;
+    }
+
+    if (preserve != 0) {
+        memcpy(ptr, mem->ptr, preserve);
+    }
+
+    MVE_MemInit(mem, size + 100, ptr);
+    mem->alloced = 1;
+}
+
+// NOTE: Must be called with `gMveQueueMutex` held.
+static void mveQueueServeMemAlloc()
+{
+    MveMem* mem = gMveQueueMemRequest;
+    if (mem == nullptr) {
+        return;
+    }
+
+    mveQueueMemRealloc(mem, gMveQueueMemRequestSize, gMveQueueMemRequestPreserve);
+
+    gMveQueueMemRequest = nullptr;
+    gMveQueueCondition.notify_all();
+}
+
+// Returns next decoded frame, decoding it in place or waiting for decode
+// worker if needed. Frame stays valid until next call (it might be referenced
+// by show frame callback). The last frame (with non-zero result) is never
+// dequeued.
+static MveQueueFrame* mveQueueNextFrame()
+{
+    if (!gMveQueueThreaded) {
+        MveQueueFrame* frame = &(gMveQueueFrames[0]);
+        if (frame->result == 0) {
+            mveQueueDecodeFrame(frame);
+            mveQueueUpdateStats(frame);
+        }
+        return frame;
+    }
+
+    std::unique_lock<std::mutex> lock(gMveQueueMutex);
+
+    // Previous frame is no longer presented, its pixels can be reused.
+    gMveQueuePresenting = false;
+    gMveQueueCondition.notify_all();
+
+    mveQueueServeMemAlloc();
+
+    if (gMveQueueHead == gMveQueueTail) {
+        // First frame is always waited for.
+        if (gMveQueueTail != 0) {
+            gMveQueueStallCount++;
+        }
+
+        do {
+            gMveQueueCondition.wait(lock);
+            mveQueueServeMemAlloc();
+        } while (gMveQueueHead == gMveQueueTail);
+    }
+
+    MveQueueFrame* frame = &(gMveQueueFrames[gMveQueueTail % MVE_QUEUE_CAPACITY]);
+    if (frame->result == 0) {
+        gMveQueueTail++;
+        gMveQueuePresenting = true;
+        gMveQueueCondition.notify_all();
+    }
+
+    return frame;
+}
+
 } // namespace fallout
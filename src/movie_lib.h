@@ -5,6 +5,19 @@
 
 namespace fallout {
 
+// CE: Number of buckets and bucket width (in microseconds) of video decode
+// time histogram. Last bucket collects everything above.
+#define MVE_DECODE_TIME_BUCKETS 32
+#define MVE_DECODE_TIME_BUCKET_WIDTH 250
+
+// CE: Video decoder statistics.
+typedef struct MveDecodeStats {
+    int frames;
+    unsigned long long time;
+    unsigned int timeHistogram[MVE_DECODE_TIME_BUCKETS];
+    int opcodeCounts[16];
+} MveDecodeStats;
+
 typedef void*(MveMallocFunc)(size_t size);
 typedef void(MveFreeFunc)(void* ptr);
 typedef bool(MveReadFunc)(void* handle, void* buffer, int count);
@@ -13,11 +26,14 @@ typedef void(MveSetPaletteFunc)(unsigned char* palette, int start, int count);
 
 void MveSetMemory(MveMallocFunc* malloc_func, MveFreeFunc* free_func);
 void MveSetIO(MveReadFunc* read_func);
+void MveSetDecodeAhead(bool enabled);
 void MveSetVolume(int volume);
 void MveSetScreenSize(int width, int height);
 void MveSetShowFrame(MveShowFrameFunc* proc);
 void MveSetPalette(MveSetPaletteFunc* set_palette_func);
 void MVE_rmFrameCounts(int* frame_count_ptr, int* frame_drop_count_ptr);
+void MVE_rmStallCount(int* stall_count_ptr);
+void MVE_rmDecodeStats(MveDecodeStats* stats);
 int MVE_rmPrepMovie(void* handle, int dx, int dy, unsigned char track);
 int _MVE_rmStepMovie();
 void MVE_rmEndMovie();
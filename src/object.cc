@@ -134,7 +134,7 @@ static Rect _light_rect[9] = {
 };
 
 // 0x5196DC
-static int _light_distance[36] = {
+static const int _light_distance[36] = {
     1,
     2,
     3,
@@ -280,6 +280,12 @@ static char _obj_seen_check[5001];
 // 0x662445
 static char _obj_seen[5001];
 
+// CE: Light batch state (see `objectLightBatchBegin`).
+static int gObjectLightBatchDepth = 0;
+static bool gObjectLightBatchHasDirtyRect = false;
+static Rect gObjectLightBatchDirtyRect;
+static int gObjectLightBatchElevation;
+
 // obj_init
 // 0x488780
 int objectsInit(unsigned char* buf, int width, int height, int pitch)
@@ -1703,6 +1709,52 @@ int objectRotateCounterClockwise(Object* obj, Rect* dirtyRect)
     return objectSetRotation(obj, rotation, dirtyRect);
 }
 
+// CE: Postpones refreshing areas affected by light changes until matching
+// `objectLightBatchEnd`. Batches can be nested.
+void objectLightBatchBegin()
+{
+    gObjectLightBatchDepth++;
+}
+
+// CE: Refreshes union of areas affected by light changes reported during
+// batch.
+void objectLightBatchEnd()
+{
+    if (gObjectLightBatchDepth == 0) {
+        return;
+    }
+
+    gObjectLightBatchDepth--;
+
+    if (gObjectLightBatchDepth == 0 && gObjectLightBatchHasDirtyRect) {
+        gObjectLightBatchHasDirtyRect = false;
+        tileWindowRefreshRect(&gObjectLightBatchDirtyRect, gObjectLightBatchElevation);
+    }
+}
+
+// CE: Refreshes area affected by light change, or accumulates it when light
+// batch is in progress.
+void objectLightRefreshRect(Rect* rect, int elevation)
+{
+    if (gObjectLightBatchDepth == 0) {
+        tileWindowRefreshRect(rect, elevation);
+        return;
+    }
+
+    // Only current elevation is ever refreshed.
+    if (elevation != gElevation) {
+        return;
+    }
+
+    if (gObjectLightBatchHasDirtyRect && gObjectLightBatchElevation == elevation) {
+        rectUnion(&gObjectLightBatchDirtyRect, rect, &gObjectLightBatchDirtyRect);
+    } else {
+        rectCopy(&gObjectLightBatchDirtyRect, rect);
+        gObjectLightBatchElevation = elevation;
+        gObjectLightBatchHasDirtyRect = true;
+    }
+}
+
 // 0x48AC54
 void _obj_rebuild_all_light()
 {
@@ -3998,43 +4050,14 @@ static int _obj_adjust_light(Object* obj, int a2, Rect* rect)
 
     int(*v70)[36] = _light_offsets[obj->tile & 1];
     int v7 = (obj->lightIntensity - 655) / (obj->lightDistance + 1);
+
+    // CE: Original code unrolls falloff calculation for every offset. Light
+    // fades linearly with distance so it can be calculated from distance
+    // table (which also allows compiler to vectorize it).
     int v28[36];
-    v28[0] = obj->lightIntensity - v7;
-    v28[1] = v28[0] - v7;
-    v28[8] = v28[0] - v7;
-    v28[2] = v28[0] - v7 - v7;
-    v28[9] = v28[2];
-    v28[15] = v28[0] - v7 - v7;
-    v28[3] = v28[2] - v7;
-    v28[10] = v28[2] - v7;
-    v28[16] = v28[2] - v7;
-    v28[21] = v28[2] - v7;
-    v28[4] = v28[2] - v7 - v7;
-    v28[11] = v28[4];
-    v28[17] = v28[2] - v7 - v7;
-    v28[22] = v28[2] - v7 - v7;
-    v28[26] = v28[2] - v7 - v7;
-    v28[5] = v28[4] - v7;
-    v28[12] = v28[4] - v7;
-    v28[18] = v28[4] - v7;
-    v28[23] = v28[4] - v7;
-    v28[27] = v28[4] - v7;
-    v28[30] = v28[4] - v7;
-    v28[6] = v28[4] - v7 - v7;
-    v28[13] = v28[6];
-    v28[19] = v28[4] - v7 - v7;
-    v28[24] = v28[4] - v7 - v7;
-    v28[28] = v28[4] - v7 - v7;
-    v28[31] = v28[4] - v7 - v7;
-    v28[33] = v28[4] - v7 - v7;
-    v28[7] = v28[6] - v7;
-    v28[14] = v28[6] - v7;
-    v28[20] = v28[6] - v7;
-    v28[25] = v28[6] - v7;
-    v28[29] = v28[6] - v7;
-    v28[32] = v28[6] - v7;
-    v28[34] = v28[6] - v7;
-    v28[35] = v28[6] - v7;
+    for (int index = 0; index < 36; index++) {
+        v28[index] = obj->lightIntensity - v7 * _light_distance[index];
+    }
 
     for (int index = 0; index < 36; index++) {
         if (obj->lightDistance >= _light_distance[index]) {
@@ -45,6 +45,9 @@ int objectSetPrevFrame(Object* obj, Rect* rect);
 int objectSetRotation(Object* obj, int direction, Rect* rect);
 int objectRotateClockwise(Object* obj, Rect* rect);
 int objectRotateCounterClockwise(Object* obj, Rect* rect);
+void objectLightBatchBegin();
+void objectLightBatchEnd();
+void objectLightRefreshRect(Rect* rect, int elevation);
 void _obj_rebuild_all_light();
 int objectSetLight(Object* obj, int lightDistance, int lightIntensity, Rect* rect);
 int objectGetLightIntensity(Object* obj);
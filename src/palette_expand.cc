@@ -0,0 +1,137 @@
+#include "palette_expand.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define PALETTE_EXPAND_AVX2
+#include <immintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#define PALETTE_EXPAND_NEON
+#include <arm_neon.h>
+#endif
+
+namespace fallout {
+
+#if defined(PALETTE_EXPAND_AVX2)
+__attribute__((target("avx2"))) static void paletteExpandAvx2(const PaletteExpandTable* table, const unsigned char* src, int srcPitch, unsigned char* dest, int destPitch, int width, int height);
+#elif defined(PALETTE_EXPAND_NEON)
+static void paletteExpandNeon(const PaletteExpandTable* table, const unsigned char* src, int srcPitch, unsigned char* dest, int destPitch, int width, int height);
+#endif
+
+void paletteExpandTableSetColor(PaletteExpandTable* table, int index, uint32_t color)
+{
+    table->colors[index] = color;
+
+    unsigned char* bytes = reinterpret_cast<unsigned char*>(&color);
+    for (int plane = 0; plane < 4; plane++) {
+        table->planes[plane][index] = bytes[plane];
+    }
+}
+
+// CE: Returns the fastest expansion kernel supported by CPU.
+PaletteExpandProc* paletteExpandGetProc()
+{
+#if defined(PALETTE_EXPAND_AVX2)
+    if (__builtin_cpu_supports("avx2")) {
+        return paletteExpandAvx2;
+    }
+#elif defined(PALETTE_EXPAND_NEON)
+    return paletteExpandNeon;
+#endif
+
+    return paletteExpandScalar;
+}
+
+void paletteExpandScalar(const PaletteExpandTable* table, const unsigned char* src, int srcPitch, unsigned char* dest, int destPitch, int width, int height)
+{
+    const uint32_t* colors = table->colors;
+
+    for (int y = 0; y < height; y++) {
+        uint32_t* destRow = reinterpret_cast<uint32_t*>(dest);
+        int x = 0;
+        for (; x + 4 <= width; x += 4) {
+            destRow[x] = colors[src[x]];
+            destRow[x + 1] = colors[src[x + 1]];
+            destRow[x + 2] = colors[src[x + 2]];
+            destRow[x + 3] = colors[src[x + 3]];
+        }
+
+        for (; x < width; x++) {
+            destRow[x] = colors[src[x]];
+        }
+
+        src += srcPitch;
+        dest += destPitch;
+    }
+}
+
+#if defined(PALETTE_EXPAND_AVX2)
+__attribute__((target("avx2"))) static void paletteExpandAvx2(const PaletteExpandTable* table, const unsigned char* src, int srcPitch, unsigned char* dest, int destPitch, int width, int height)
+{
+    const int* palette = reinterpret_cast<const int*>(table->colors);
+
+    for (int y = 0; y < height; y++) {
+        uint32_t* destRow = reinterpret_cast<uint32_t*>(dest);
+        int x = 0;
+        for (; x + 16 <= width; x += 16) {
+            __m128i indexes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x));
+            __m256i lo = _mm256_i32gather_epi32(palette, _mm256_cvtepu8_epi32(indexes), 4);
+            __m256i hi = _mm256_i32gather_epi32(palette, _mm256_cvtepu8_epi32(_mm_srli_si128(indexes, 8)), 4);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(destRow + x), lo);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(destRow + x + 8), hi);
+        }
+
+        for (; x < width; x++) {
+            destRow[x] = table->colors[src[x]];
+        }
+
+        src += srcPitch;
+        dest += destPitch;
+    }
+}
+#elif defined(PALETTE_EXPAND_NEON)
+// NEON has no gather, instead every byte of the resulting color is looked up
+// in its own 256-entry plane with four 64-byte table lookups, then planes are
+// interleaved back into 32-bit pixels on store.
+static void paletteExpandNeon(const PaletteExpandTable* table, const unsigned char* src, int srcPitch, unsigned char* dest, int destPitch, int width, int height)
+{
+    uint8x16x4_t tables[4][4];
+    for (int plane = 0; plane < 4; plane++) {
+        for (int quarter = 0; quarter < 4; quarter++) {
+            tables[plane][quarter] = vld1q_u8_x4(table->planes[plane] + quarter * 64);
+        }
+    }
+
+    const uint8x16_t step = vdupq_n_u8(64);
+
+    for (int y = 0; y < height; y++) {
+        uint32_t* destRow = reinterpret_cast<uint32_t*>(dest);
+        int x = 0;
+        for (; x + 16 <= width; x += 16) {
+            uint8x16_t indexes[4];
+            indexes[0] = vld1q_u8(src + x);
+            indexes[1] = vsubq_u8(indexes[0], step);
+            indexes[2] = vsubq_u8(indexes[1], step);
+            indexes[3] = vsubq_u8(indexes[2], step);
+
+            uint8x16x4_t pixels;
+            for (int plane = 0; plane < 4; plane++) {
+                uint8x16_t value = vqtbl4q_u8(tables[plane][0], indexes[0]);
+                value = vqtbx4q_u8(value, tables[plane][1], indexes[1]);
+                value = vqtbx4q_u8(value, tables[plane][2], indexes[2]);
+                value = vqtbx4q_u8(value, tables[plane][3], indexes[3]);
+                pixels.val[plane] = value;
+            }
+
+            vst4q_u8(reinterpret_cast<uint8_t*>(destRow + x), pixels);
+        }
+
+        for (; x < width; x++) {
+            destRow[x] = table->colors[src[x]];
+        }
+
+        src += srcPitch;
+        dest += destPitch;
+    }
+}
+#endif
+
+} // namespace fallout
@@ -0,0 +1,24 @@
+#ifndef PALETTE_EXPAND_H
+#define PALETTE_EXPAND_H
+
+#include <stdint.h>
+
+namespace fallout {
+
+// CE: Palette mapped into 32-bit pixel format, used to expand 8-bit images.
+typedef struct PaletteExpandTable {
+    alignas(32) uint32_t colors[256];
+
+    // Same colors split into bytes (as laid out in memory) for SIMD lookups.
+    alignas(16) unsigned char planes[4][256];
+} PaletteExpandTable;
+
+typedef void(PaletteExpandProc)(const PaletteExpandTable* table, const unsigned char* src, int srcPitch, unsigned char* dest, int destPitch, int width, int height);
+
+void paletteExpandTableSetColor(PaletteExpandTable* table, int index, uint32_t color);
+PaletteExpandProc* paletteExpandGetProc();
+void paletteExpandScalar(const PaletteExpandTable* table, const unsigned char* src, int srcPitch, unsigned char* dest, int destPitch, int width, int height);
+
+} // namespace fallout
+
+#endif /* PALETTE_EXPAND_H */
@@ -0,0 +1,458 @@
+#include "profiler.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+#include <SDL.h>
+
+#include "color.h"
+#include "debug.h"
+#include "platform_compat.h"
+#include "settings.h"
+#include "svga.h"
+#include "text_font.h"
+#include "window_manager.h"
+
+namespace fallout {
+
+// CE: Number of section timings kept for trace export. Older timings are
+// overwritten.
+#define PROFILER_EVENT_CAPACITY 65536
+
+// CE: Number of frames kept for overlay and CSV export.
+#define PROFILER_FRAME_CAPACITY 600
+
+// CE: Maximum depth of nested sections.
+#define PROFILER_STACK_CAPACITY 32
+
+// CE: Number of recent frames summarized in overlay and overlay refresh
+// interval (in frames).
+#define PROFILER_OVERLAY_FRAMES 60
+#define PROFILER_OVERLAY_REFRESH_INTERVAL 10
+
+#define PROFILER_OVERLAY_WIDTH 180
+#define PROFILER_OVERLAY_FONT 101
+
+typedef struct ProfilerEvent {
+    // Microseconds since profiler initialization.
+    unsigned long long start;
+    unsigned int duration;
+    unsigned char section;
+    unsigned char depth;
+} ProfilerEvent;
+
+typedef struct ProfilerFrame {
+    // Microseconds since profiler initialization.
+    unsigned long long start;
+
+    // Inclusive time (in microseconds) spent in every section during this
+    // frame, `PROFILER_SECTION_FRAME` is the frame itself.
+    unsigned int sections[PROFILER_SECTION_COUNT];
+} ProfilerFrame;
+
+typedef struct ProfilerStackEntry {
+    ProfilerSection section;
+    Uint64 start;
+} ProfilerStackEntry;
+
+static unsigned long long profilerTicksToMicroseconds(Uint64 ticks);
+static void profilerRecordEvent(ProfilerSection section, Uint64 start, Uint64 end, int depth);
+static void profilerOverlayShow();
+static void profilerOverlayHide();
+static void profilerOverlayRefresh();
+static bool profilerWriteTrace(FILE* stream);
+static bool profilerWriteCsv(FILE* stream);
+static bool profilerWriteOutput();
+
+static const char* gProfilerSectionNames[PROFILER_SECTION_COUNT] = {
+    "frame",
+    "input",
+    "tickers",
+    "animation",
+    "scripts",
+    "critter_scripts",
+    "timed_events",
+    "map_update",
+    "game_key",
+    "script_requests",
+    "render",
+};
+
+static bool gProfilerEnabled = false;
+static Uint64 gProfilerFrequency = 1;
+static Uint64 gProfilerOrigin = 0;
+
+static std::vector<ProfilerEvent> gProfilerEvents;
+static unsigned long long gProfilerEventsCount = 0;
+
+static std::vector<ProfilerFrame> gProfilerFrames;
+static unsigned long long gProfilerFramesCount = 0;
+static ProfilerFrame gProfilerCurrentFrame;
+static bool gProfilerFrameOpen = false;
+
+// Longest time (in microseconds) spent in every section during a single frame
+// since profiler initialization, which is how long the worst hitch caused by
+// that section was.
+static unsigned int gProfilerSectionMaximums[PROFILER_SECTION_COUNT];
+
+static ProfilerStackEntry gProfilerStack[PROFILER_STACK_CAPACITY];
+static int gProfilerStackSize = 0;
+
+// Number of open instances of every section, only outermost instance of a
+// re-entered section contributes to frame time.
+static int gProfilerSectionDepth[PROFILER_SECTION_COUNT];
+
+static int gProfilerOverlayWindow = -1;
+static int gProfilerOverlayFramesUntilRefresh = 0;
+
+bool profilerInit()
+{
+    if (!settings.debug.profiler) {
+        return true;
+    }
+
+    gProfilerEvents.resize(PROFILER_EVENT_CAPACITY);
+    gProfilerEventsCount = 0;
+
+    gProfilerFrames.resize(PROFILER_FRAME_CAPACITY);
+    gProfilerFramesCount = 0;
+
+    gProfilerFrameOpen = false;
+    gProfilerStackSize = 0;
+    memset(gProfilerSectionDepth, 0, sizeof(gProfilerSectionDepth));
+    memset(gProfilerSectionMaximums, 0, sizeof(gProfilerSectionMaximums));
+
+    gProfilerFrequency = SDL_GetPerformanceFrequency();
+    gProfilerOrigin = SDL_GetPerformanceCounter();
+
+    gProfilerEnabled = true;
+
+    debugPrint("Profiler: enabled, output: %s\n", settings.debug.profiler_output.c_str());
+
+    return true;
+}
+
+void profilerExit()
+{
+    if (!gProfilerEnabled) {
+        return;
+    }
+
+    profilerOverlayHide();
+
+    if (gProfilerFramesCount != 0) {
+        unsigned long long framesCount = std::min(gProfilerFramesCount, static_cast<unsigned long long>(PROFILER_FRAME_CAPACITY));
+        unsigned long long total = 0;
+        for (unsigned long long index = 0; index < framesCount; index++) {
+            total += gProfilerFrames[index].sections[PROFILER_SECTION_FRAME];
+        }
+
+        debugPrint("Profiler: %llu frames, avg frame %.2f ms (last %llu frames)\n",
+            gProfilerFramesCount,
+            static_cast<double>(total) / framesCount / 1000.0,
+            framesCount);
+
+        for (int section = 0; section < PROFILER_SECTION_COUNT; section++) {
+            if (gProfilerSectionMaximums[section] != 0) {
+                debugPrint("Profiler: worst frame %s %.2f ms\n",
+                    gProfilerSectionNames[section],
+                    gProfilerSectionMaximums[section] / 1000.0);
+            }
+        }
+    }
+
+    if (!profilerWriteOutput()) {
+        debugPrint("Profiler: failed to write %s\n", settings.debug.profiler_output.c_str());
+    }
+
+    gProfilerEnabled = false;
+
+    gProfilerEvents.clear();
+    gProfilerEvents.shrink_to_fit();
+    gProfilerFrames.clear();
+    gProfilerFrames.shrink_to_fit();
+}
+
+bool profilerIsEnabled()
+{
+    return gProfilerEnabled;
+}
+
+void profilerFrameBegin()
+{
+    if (!gProfilerEnabled) {
+        return;
+    }
+
+    memset(&gProfilerCurrentFrame, 0, sizeof(gProfilerCurrentFrame));
+    gProfilerCurrentFrame.start = profilerTicksToMicroseconds(SDL_GetPerformanceCounter() - gProfilerOrigin);
+    gProfilerFrameOpen = true;
+
+    profilerSectionBegin(PROFILER_SECTION_FRAME);
+}
+
+void profilerFrameEnd()
+{
+    if (!gProfilerEnabled || !gProfilerFrameOpen) {
+        return;
+    }
+
+    profilerSectionEnd(PROFILER_SECTION_FRAME);
+
+    gProfilerFrames[gProfilerFramesCount % PROFILER_FRAME_CAPACITY] = gProfilerCurrentFrame;
+    gProfilerFramesCount++;
+
+    for (int section = 0; section < PROFILER_SECTION_COUNT; section++) {
+        gProfilerSectionMaximums[section] = std::max(gProfilerSectionMaximums[section], gProfilerCurrentFrame.sections[section]);
+    }
+    gProfilerFrameOpen = false;
+
+    if (gProfilerOverlayWindow != -1) {
+        gProfilerOverlayFramesUntilRefresh--;
+        if (gProfilerOverlayFramesUntilRefresh <= 0) {
+            profilerOverlayRefresh();
+            gProfilerOverlayFramesUntilRefresh = PROFILER_OVERLAY_REFRESH_INTERVAL;
+        }
+    }
+}
+
+void profilerSectionBegin(ProfilerSection section)
+{
+    if (!gProfilerEnabled) {
+        return;
+    }
+
+    if (gProfilerStackSize < PROFILER_STACK_CAPACITY) {
+        ProfilerStackEntry* entry = &(gProfilerStack[gProfilerStackSize]);
+        entry->section = section;
+        entry->start = SDL_GetPerformanceCounter();
+    }
+
+    gProfilerStackSize++;
+    gProfilerSectionDepth[section]++;
+}
+
+void profilerSectionEnd(ProfilerSection section)
+{
+    if (!gProfilerEnabled || gProfilerStackSize == 0) {
+        return;
+    }
+
+    Uint64 end = SDL_GetPerformanceCounter();
+
+    gProfilerStackSize--;
+    gProfilerSectionDepth[section]--;
+
+    // Sections nested too deep are not timed.
+    if (gProfilerStackSize >= PROFILER_STACK_CAPACITY) {
+        return;
+    }
+
+    ProfilerStackEntry* entry = &(gProfilerStack[gProfilerStackSize]);
+    profilerRecordEvent(section, entry->start, end, gProfilerStackSize);
+
+    if (gProfilerFrameOpen && gProfilerSectionDepth[section] == 0) {
+        gProfilerCurrentFrame.sections[section] += static_cast<unsigned int>(profilerTicksToMicroseconds(end - entry->start));
+    }
+}
+
+void profilerToggleOverlay()
+{
+    if (!gProfilerEnabled) {
+        debugPrint("Profiler: not enabled, set profiler=1 in [debug] section\n");
+        return;
+    }
+
+    if (gProfilerOverlayWindow == -1) {
+        profilerOverlayShow();
+    } else {
+        profilerOverlayHide();
+    }
+}
+
+ProfilerScope::ProfilerScope(ProfilerSection section)
+    : _section(section)
+{
+    profilerSectionBegin(_section);
+}
+
+ProfilerScope::~ProfilerScope()
+{
+    profilerSectionEnd(_section);
+}
+
+static unsigned long long profilerTicksToMicroseconds(Uint64 ticks)
+{
+    // Split to avoid overflow on high resolution counters.
+    return (ticks / gProfilerFrequency) * 1000000 + (ticks % gProfilerFrequency) * 1000000 / gProfilerFrequency;
+}
+
+static void profilerRecordEvent(ProfilerSection section, Uint64 start, Uint64 end, int depth)
+{
+    ProfilerEvent* event = &(gProfilerEvents[gProfilerEventsCount % PROFILER_EVENT_CAPACITY]);
+    event->start = profilerTicksToMicroseconds(start - gProfilerOrigin);
+    event->duration = static_cast<unsigned int>(profilerTicksToMicroseconds(end - start));
+    event->section = static_cast<unsigned char>(section);
+    event->depth = static_cast<unsigned char>(depth);
+    gProfilerEventsCount++;
+}
+
+static void profilerOverlayShow()
+{
+    int oldFont = fontGetCurrent();
+    fontSetCurrent(PROFILER_OVERLAY_FONT);
+
+    int height = (PROFILER_SECTION_COUNT + 1) * (fontGetLineHeight() + 1) + 8;
+    int x = std::max(screenGetWidth() - PROFILER_OVERLAY_WIDTH - 4, 0);
+
+    fontSetCurrent(oldFont);
+
+    gProfilerOverlayWindow = windowCreate(x, 4, PROFILER_OVERLAY_WIDTH, height, _colorTable[0], WINDOW_MOVE_ON_TOP);
+    if (gProfilerOverlayWindow == -1) {
+        debugPrint("Profiler: failed to create overlay window\n");
+        return;
+    }
+
+    profilerOverlayRefresh();
+    gProfilerOverlayFramesUntilRefresh = PROFILER_OVERLAY_REFRESH_INTERVAL;
+}
+
+static void profilerOverlayHide()
+{
+    if (gProfilerOverlayWindow != -1) {
+        windowDestroy(gProfilerOverlayWindow);
+        gProfilerOverlayWindow = -1;
+    }
+}
+
+static void profilerOverlayRefresh()
+{
+    unsigned long long framesCount = std::min(gProfilerFramesCount, static_cast<unsigned long long>(PROFILER_OVERLAY_FRAMES));
+
+    unsigned long long totals[PROFILER_SECTION_COUNT];
+    unsigned int maximums[PROFILER_SECTION_COUNT];
+    memset(totals, 0, sizeof(totals));
+    memset(maximums, 0, sizeof(maximums));
+
+    for (unsigned long long index = 0; index < framesCount; index++) {
+        const ProfilerFrame* frame = &(gProfilerFrames[(gProfilerFramesCount - 1 - index) % PROFILER_FRAME_CAPACITY]);
+        for (int section = 0; section < PROFILER_SECTION_COUNT; section++) {
+            totals[section] += frame->sections[section];
+            maximums[section] = std::max(maximums[section], frame->sections[section]);
+        }
+    }
+
+    int oldFont = fontGetCurrent();
+    fontSetCurrent(PROFILER_OVERLAY_FONT);
+
+    int lineHeight = fontGetLineHeight() + 1;
+    int color = _colorTable[992] | 0x2000000;
+
+    windowFill(gProfilerOverlayWindow, 0, 0, PROFILER_OVERLAY_WIDTH, (PROFILER_SECTION_COUNT + 1) * lineHeight + 8, _colorTable[0]);
+
+    int y = 4;
+    windowDrawText(gProfilerOverlayWindow, "ms", 0, 4, y, color);
+    windowDrawText(gProfilerOverlayWindow, "avg", 0, 104, y, color);
+    windowDrawText(gProfilerOverlayWindow, "max", 0, 144, y, color);
+    y += lineHeight;
+
+    for (int section = 0; section < PROFILER_SECTION_COUNT; section++) {
+        char text[16];
+
+        windowDrawText(gProfilerOverlayWindow, gProfilerSectionNames[section], 0, 4, y, color);
+
+        double average = framesCount != 0 ? static_cast<double>(totals[section]) / framesCount / 1000.0 : 0.0;
+        snprintf(text, sizeof(text), "%.2f", average);
+        windowDrawText(gProfilerOverlayWindow, text, 0, 104, y, color);
+
+        snprintf(text, sizeof(text), "%.2f", maximums[section] / 1000.0);
+        windowDrawText(gProfilerOverlayWindow, text, 0, 144, y, color);
+
+        y += lineHeight;
+    }
+
+    fontSetCurrent(oldFont);
+
+    windowRefresh(gProfilerOverlayWindow);
+}
+
+// Writes recorded section timings in Chrome trace event format (viewable in
+// `chrome://tracing` or Perfetto).
+static bool profilerWriteTrace(FILE* stream)
+{
+    unsigned long long eventsCount = std::min(gProfilerEventsCount, static_cast<unsigned long long>(PROFILER_EVENT_CAPACITY));
+    unsigned long long first = gProfilerEventsCount - eventsCount;
+
+    fprintf(stream, "{\"traceEvents\":[\n");
+
+    for (unsigned long long index = 0; index < eventsCount; index++) {
+        const ProfilerEvent* event = &(gProfilerEvents[(first + index) % PROFILER_EVENT_CAPACITY]);
+        fprintf(stream,
+            "{\"name\":\"%s\",\"cat\":\"engine\",\"ph\":\"X\",\"ts\":%llu,\"dur\":%u,\"pid\":1,\"tid\":1,\"args\":{\"depth\":%d}}%s\n",
+            gProfilerSectionNames[event->section],
+            event->start,
+            event->duration,
+            event->depth,
+            index + 1 < eventsCount ? "," : "");
+    }
+
+    fprintf(stream, "],\"displayTimeUnit\":\"ms\"}\n");
+
+    return ferror(stream) == 0;
+}
+
+// Writes per-frame section times (in microseconds), one frame per line.
+static bool profilerWriteCsv(FILE* stream)
+{
+    unsigned long long framesCount = std::min(gProfilerFramesCount, static_cast<unsigned long long>(PROFILER_FRAME_CAPACITY));
+    unsigned long long first = gProfilerFramesCount - framesCount;
+
+    fprintf(stream, "index,start");
+    for (int section = 0; section < PROFILER_SECTION_COUNT; section++) {
+        fprintf(stream, ",%s", gProfilerSectionNames[section]);
+    }
+    fprintf(stream, "\n");
+
+    for (unsigned long long index = 0; index < framesCount; index++) {
+        const ProfilerFrame* frame = &(gProfilerFrames[(first + index) % PROFILER_FRAME_CAPACITY]);
+        fprintf(stream, "%llu,%llu", first + index, frame->start);
+        for (int section = 0; section < PROFILER_SECTION_COUNT; section++) {
+            fprintf(stream, ",%u", frame->sections[section]);
+        }
+        fprintf(stream, "\n");
+    }
+
+    return ferror(stream) == 0;
+}
+
+static bool profilerWriteOutput()
+{
+    const char* path = settings.debug.profiler_output.c_str();
+    if (path[0] == '\0') {
+        return true;
+    }
+
+    FILE* stream = compat_fopen(path, "wt");
+    if (stream == nullptr) {
+        return false;
+    }
+
+    size_t length = strlen(path);
+    bool success;
+    if (length >= 4 && compat_stricmp(path + length - 4, ".csv") == 0) {
+        success = profilerWriteCsv(stream);
+    } else {
+        success = profilerWriteTrace(stream);
+    }
+
+    if (fclose(stream) != 0) {
+        success = false;
+    }
+
+    return success;
+}
+
+} // namespace fallout
@@ -0,0 +1,45 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+namespace fallout {
+
+// CE: Engine subsystems timed by the frame profiler. Sections can be nested
+// (e.g. scripts run from tickers, which run from input), so section times are
+// inclusive.
+typedef enum ProfilerSection {
+    PROFILER_SECTION_FRAME,
+    PROFILER_SECTION_INPUT,
+    PROFILER_SECTION_TICKERS,
+    PROFILER_SECTION_ANIMATION,
+    PROFILER_SECTION_SCRIPTS,
+    PROFILER_SECTION_CRITTER_SCRIPTS,
+    PROFILER_SECTION_TIMED_EVENTS,
+    PROFILER_SECTION_MAP_UPDATE,
+    PROFILER_SECTION_GAME_KEY,
+    PROFILER_SECTION_SCRIPT_REQUESTS,
+    PROFILER_SECTION_RENDER,
+    PROFILER_SECTION_COUNT,
+} ProfilerSection;
+
+bool profilerInit();
+void profilerExit();
+bool profilerIsEnabled();
+void profilerFrameBegin();
+void profilerFrameEnd();
+void profilerSectionBegin(ProfilerSection section);
+void profilerSectionEnd(ProfilerSection section);
+void profilerToggleOverlay();
+
+// CE: Times enclosing block as given profiler section.
+class ProfilerScope {
+public:
+    ProfilerScope(ProfilerSection section);
+    ~ProfilerScope();
+
+private:
+    const ProfilerSection _section;
+};
+
+} // namespace fallout
+
+#endif /* PROFILER_H */
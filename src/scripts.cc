@@ -5,6 +5,10 @@
 #include <string.h>
 #include <time.h>
 
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
 #include "actions.h"
 #include "animation.h"
 #include "art.h"
@@ -26,9 +30,11 @@
 #include "object.h"
 #include "party_member.h"
 #include "platform_compat.h"
+#include "profiler.h"
 #include "proto.h"
 #include "proto_instance.h"
 #include "queue.h"
+#include "settings.h"
 #include "sfall_arrays.h"
 #include "sfall_config.h"
 #include "sfall_global_scripts.h"
@@ -68,11 +74,28 @@ typedef struct ScriptList {
     int nextScriptId;
 } ScriptList;
 
+// CE: Critter script scheduled to run critter proc.
+typedef struct CritterProcEntry {
+    int sid;
+    Script* script;
+
+    // Value of `gCritterProcFrame` when critter proc was last run.
+    unsigned int lastRun;
+} CritterProcEntry;
+
 static Program* scriptsCreateProgramByName(const char* name);
 static void _doBkProcesses();
 static void _script_chk_critters();
+static int _script_chk_next_critter();
+static void critterProcEntriesUpdate();
+static int critterProcGetWeight(Script* script);
+static void critterProcRunByPriority(int quota);
+static void scriptsBeginMapUpdate();
+static void scriptsContinueMapUpdate();
+static void scriptsCancelMapUpdate();
 static void _script_chk_timed_events();
 static int scriptsClearPendingRequests();
+static int scriptExecProcScript(Script* script, int proc);
 static int scriptLocateProcs(Script* scr);
 static int scriptsLoadScriptsList();
 static int scriptsFreeScriptsList();
@@ -185,6 +208,23 @@ static ScriptsListEntry* gScriptsListEntries = nullptr;
 // 0x51C7CC
 static int gScriptsListEntriesLength = 0;
 
+// CE: Critter scripts in list order. Rebuilt when critter scripts are added
+// or removed (which also invalidates `script` pointers).
+static std::vector<CritterProcEntry> gCritterProcEntries;
+static bool gCritterProcEntriesDirty = true;
+
+// CE: Number of frames critter procs were run by priority.
+static unsigned int gCritterProcFrame = 0;
+
+// CE: Priorities and indexes of critter procs to run in current frame.
+static std::vector<std::pair<unsigned long long, int>> gCritterProcQueue;
+
+// CE: Scripts to run map update proc in current map update spread over
+// several frames, index of the next one, and number of scripts per frame.
+static std::vector<int> gMapUpdateSids;
+static size_t gMapUpdateSidsIndex = 0;
+static size_t gMapUpdateBatchSize = 0;
+
 // 0x51C7D4
 static int _cur_id = 4;
 
@@ -685,6 +725,7 @@ static void _doBkProcesses()
         // NOTE: There is a loop at 0x4A3C64, consisting of one iteration, going
         // downwards from 1.
         for (int index = 0; index < 1; index++) {
+            ProfilerScope profilerScope(PROFILER_SECTION_SCRIPTS);
             _updatePrograms();
         }
     }
@@ -695,27 +736,52 @@ static void _doBkProcesses()
         // SFALL: Fix to prevent the execution of critter_p_proc and game events
         // when playing movies.
         if (!_gdialogActive() && !gameMovieIsPlaying()) {
-            _script_chk_critters();
-            _script_chk_timed_events();
+            {
+                ProfilerScope profilerScope(PROFILER_SECTION_CRITTER_SCRIPTS);
+                _script_chk_critters();
+            }
+
+            {
+                ProfilerScope profilerScope(PROFILER_SECTION_TIMED_EVENTS);
+                _script_chk_timed_events();
+            }
         }
     }
 }
 
+// CE: Critter procs are run for `critter_proc_quota` critters per frame (and
+// then, with scripts time budget enabled, for subsequent critters while there
+// is time left, every critter at most once per frame). With
+// `critter_proc_priority` critters are picked by how long they have been
+// waiting and how close they are to the player, otherwise in list order.
+//
 // 0x4A3CA0
 static void _script_chk_critters()
 {
-    if (!_gdialogActive() && !isInCombat()) {
-        ScriptList* scriptList;
-        ScriptListExtent* scriptListExtent;
+    int quota = std::max(settings.system.critter_proc_quota, 1);
 
-        int scriptsCount = 0;
+    if (settings.system.critter_proc_priority) {
+        critterProcRunByPriority(quota);
+        return;
+    }
 
-        scriptList = &(gScriptLists[SCRIPT_TYPE_CRITTER]);
-        scriptListExtent = scriptList->head;
-        while (scriptListExtent != nullptr) {
-            scriptsCount += scriptListExtent->length;
-            scriptListExtent = scriptListExtent->next;
-        }
+    int scriptsCount = _script_chk_next_critter();
+    for (int index = 1; index < scriptsCount && (index < quota || interpreterHasTimeBudget()); index++) {
+        _script_chk_next_critter();
+    }
+}
+
+// CE: Runs critter proc of the next critter, returns number of critter
+// scripts. Extracted from `_script_chk_critters`.
+static int _script_chk_next_critter()
+{
+    int scriptsCount = 0;
+
+    if (!_gdialogActive() && !isInCombat()) {
+        // CE: Critter scripts are indexed directly instead of walking script
+        // list extents.
+        critterProcEntriesUpdate();
+        scriptsCount = static_cast<int>(gCritterProcEntries.size());
 
         _count_ += 1;
         if (_count_ >= scriptsCount) {
@@ -724,20 +790,121 @@ static void _script_chk_critters()
 
         if (_count_ < scriptsCount) {
             int proc = isInCombat() ? SCRIPT_PROC_COMBAT : SCRIPT_PROC_CRITTER;
-            int extentIndex = _count_ / SCRIPT_LIST_EXTENT_SIZE;
-            int scriptIndex = _count_ % SCRIPT_LIST_EXTENT_SIZE;
-
-            scriptList = &(gScriptLists[SCRIPT_TYPE_CRITTER]);
-            scriptListExtent = scriptList->head;
-            while (scriptListExtent != nullptr && extentIndex != 0) {
-                extentIndex -= 1;
-                scriptListExtent = scriptListExtent->next;
+            CritterProcEntry* entry = &(gCritterProcEntries[_count_]);
+            entry->lastRun = gCritterProcFrame;
+            if (gScriptsEnabled) {
+                scriptExecProcScript(entry->script, proc);
             }
+        }
+    }
 
-            if (scriptListExtent != nullptr) {
-                Script* script = &(scriptListExtent->scripts[scriptIndex]);
-                scriptExecProc(script->sid, proc);
-            }
+    return scriptsCount;
+}
+
+// CE: Rebuilds critter scripts index if critter scripts were added or removed
+// since it was last built.
+static void critterProcEntriesUpdate()
+{
+    if (!gCritterProcEntriesDirty) {
+        return;
+    }
+
+    std::unordered_map<int, unsigned int> lastRuns;
+    for (const CritterProcEntry& entry : gCritterProcEntries) {
+        lastRuns[entry.sid] = entry.lastRun;
+    }
+
+    gCritterProcEntries.clear();
+
+    ScriptListExtent* scriptListExtent = gScriptLists[SCRIPT_TYPE_CRITTER].head;
+    while (scriptListExtent != nullptr) {
+        for (int index = 0; index < scriptListExtent->length; index++) {
+            Script* script = &(scriptListExtent->scripts[index]);
+
+            // New critters are considered waiting since the beginning to run
+            // them first.
+            auto it = lastRuns.find(script->sid);
+            unsigned int lastRun = it != lastRuns.end() ? it->second : 0;
+
+            gCritterProcEntries.push_back(CritterProcEntry { script->sid, script, lastRun });
+        }
+        scriptListExtent = scriptListExtent->next;
+    }
+
+    gCritterProcEntriesDirty = false;
+}
+
+// CE: Returns how much critter proc of given critter script is preferred over
+// others waiting for the same time, or 0 if it should not be run at all.
+static int critterProcGetWeight(Script* script)
+{
+    Object* owner = script->owner;
+    if (owner == nullptr || gDude == nullptr) {
+        return 1;
+    }
+
+    if (owner->elevation == gElevation && tileIsOnScreen(owner->tile)) {
+        return 4;
+    }
+
+    int maxDistance = settings.system.critter_proc_max_distance;
+    if (owner->elevation != gDude->elevation) {
+        return maxDistance > 0 ? 0 : 1;
+    }
+
+    if (maxDistance > 0 && tileDistanceBetween(owner->tile, gDude->tile) > maxDistance) {
+        return 0;
+    }
+
+    return 2;
+}
+
+// CE: Runs critter procs of `quota` critters with highest priority (and then
+// subsequent ones while there is scripts time budget left). Priority is the
+// number of frames since critter proc was last run multiplied by critter
+// weight, so critters on screen run most often, while those beyond
+// `critter_proc_max_distance` are not run at all.
+static void critterProcRunByPriority(int quota)
+{
+    if (_gdialogActive() || isInCombat()) {
+        return;
+    }
+
+    gCritterProcFrame++;
+
+    critterProcEntriesUpdate();
+
+    gCritterProcQueue.clear();
+    for (int index = 0; index < static_cast<int>(gCritterProcEntries.size()); index++) {
+        CritterProcEntry* entry = &(gCritterProcEntries[index]);
+        int weight = critterProcGetWeight(entry->script);
+        if (weight != 0) {
+            unsigned long long priority = static_cast<unsigned long long>(gCritterProcFrame - entry->lastRun) * weight;
+            gCritterProcQueue.push_back(std::make_pair(priority, index));
+        }
+    }
+
+    // Higher priority first, list order for equal priorities.
+    std::sort(gCritterProcQueue.begin(), gCritterProcQueue.end(), [](const std::pair<unsigned long long, int>& a, const std::pair<unsigned long long, int>& b) {
+        return a.first != b.first ? a.first > b.first : a.second < b.second;
+    });
+
+    for (int index = 0; index < static_cast<int>(gCritterProcQueue.size()); index++) {
+        if (index >= quota && !interpreterHasTimeBudget()) {
+            break;
+        }
+
+        // Critter procs can add or remove critters (which invalidates the
+        // queue), or start dialog or combat. Remaining critters are
+        // considered in the next frame.
+        if (gCritterProcEntriesDirty || _gdialogActive() || isInCombat()) {
+            break;
+        }
+
+        CritterProcEntry* entry = &(gCritterProcEntries[gCritterProcQueue[index].second]);
+        entry->lastRun = gCritterProcFrame;
+        if (gScriptsEnabled) {
+            scriptExecProcScript(entry->script, SCRIPT_PROC_CRITTER);
         }
     }
 }
@@ -757,7 +924,16 @@ static void _script_chk_timed_events()
     if (gameGetState() != GAME_STATE_4) {
         if (getTicksBetween(v0, _last_light_time) >= 30000) {
             _last_light_time = v0;
-            scriptsExecMapUpdateScripts(SCRIPT_PROC_MAP_UPDATE);
+
+            ProfilerScope profilerScope(PROFILER_SECTION_MAP_UPDATE);
+            if (settings.system.map_update_frames > 1) {
+                scriptsBeginMapUpdate();
+            } else {
+                scriptsExecMapUpdateScripts(SCRIPT_PROC_MAP_UPDATE);
+            }
+        } else if (gMapUpdateSidsIndex < gMapUpdateSids.size()) {
+            ProfilerScope profilerScope(PROFILER_SECTION_MAP_UPDATE);
+            scriptsContinueMapUpdate();
         }
     } else {
         v1 = false;
@@ -782,6 +958,75 @@ static void _script_chk_timed_events()
     }
 }
 
+// CE: Runs map update procs of global scripts and map script, and starts
+// running map update procs of other scripts in batches over the next
+// `map_update_frames` frames (the first batch is run immediately). Scripts
+// are collected the same way as in `scriptsExecMapUpdateScripts`.
+static void scriptsBeginMapUpdate()
+{
+    // Finish previous map update if it's still in progress.
+    while (gMapUpdateSidsIndex < gMapUpdateSids.size()) {
+        scriptsContinueMapUpdate();
+    }
+
+    // SFALL: Run global scripts.
+    sfall_gl_scr_exec_map_update_scripts(SCRIPT_PROC_MAP_UPDATE);
+
+    _scr_SpatialsEnabled = false;
+    scriptExecProc(gMapSid, SCRIPT_PROC_MAP_UPDATE);
+    _scr_SpatialsEnabled = true;
+
+    scriptsCancelMapUpdate();
+
+    for (int scriptType = 0; scriptType < SCRIPT_TYPE_COUNT; scriptType++) {
+        ScriptList* scriptList = &(gScriptLists[scriptType]);
+        ScriptListExtent* scriptListExtent = scriptList->head;
+        while (scriptListExtent != nullptr) {
+            for (int scriptIndex = 0; scriptIndex < scriptListExtent->length; scriptIndex++) {
+                Script* script = &(scriptListExtent->scripts[scriptIndex]);
+                if (script->sid != gMapSid && script->procs[SCRIPT_PROC_MAP_UPDATE] > 0) {
+                    gMapUpdateSids.push_back(script->sid);
+                }
+            }
+            scriptListExtent = scriptListExtent->next;
+        }
+    }
+
+    size_t frames = static_cast<size_t>(settings.system.map_update_frames);
+    gMapUpdateBatchSize = (gMapUpdateSids.size() + frames - 1) / frames;
+
+    scriptsContinueMapUpdate();
+}
+
+// CE: Runs the next batch of map update procs started with
+// `scriptsBeginMapUpdate`.
+static void scriptsContinueMapUpdate()
+{
+    size_t end = gMapUpdateSidsIndex + gMapUpdateBatchSize;
+
+    _scr_SpatialsEnabled = false;
+
+    // Map update proc can change map, which cancels map update.
+    while (gMapUpdateSidsIndex < end && gMapUpdateSidsIndex < gMapUpdateSids.size()) {
+        int sid = gMapUpdateSids[gMapUpdateSidsIndex++];
+        scriptExecProc(sid, SCRIPT_PROC_MAP_UPDATE);
+    }
+
+    _scr_SpatialsEnabled = true;
+
+    if (gMapUpdateSidsIndex >= gMapUpdateSids.size()) {
+        scriptsCancelMapUpdate();
+    }
+}
+
+// CE: Forgets map update in progress (when scripts are removed or map is
+// entered or left).
+static void scriptsCancelMapUpdate()
+{
+    gMapUpdateSids.clear();
+    gMapUpdateSidsIndex = 0;
+}
+
 // 0x4A3E30
 void _scrSetQueueTestVals(Object* a1, int a2)
 {
@@ -1269,6 +1514,13 @@ int scriptExecProc(int sid, int proc)
         return -1;
     }
 
+    return scriptExecProcScript(script, proc);
+}
+
+// CE: Extracted from `scriptExecProc` to run procs of scripts which are
+// already known.
+static int scriptExecProcScript(Script* script, int proc)
+{
     script->scriptOverrides = 0;
 
     bool programLoaded = false;
@@ -1347,8 +1599,10 @@ int scriptExecProc(int sid, int proc)
 // 0x4A49D0
 static int scriptLocateProcs(Script* script)
 {
+    // CE: Indexes are resolved once per script file.
+    const int* indexes = programGetProcedureIndexes(script->program, gScriptProcNames, SCRIPT_PROC_COUNT);
     for (int proc = 0; proc < SCRIPT_PROC_COUNT; proc++) {
-        int index = programFindProcedure(script->program, gScriptProcNames[proc]);
+        int index = indexes[proc];
         if (index == -1) {
             index = SCRIPT_PROC_NO_PROC;
         }
@@ -1797,6 +2051,8 @@ static int _scr_header_load()
         scriptList->nextScriptId = 0;
     }
 
+    gCritterProcEntriesDirty = true;
+
     return 0;
 }
 
@@ -1908,6 +2164,12 @@ int scriptSaveAll(File* stream)
                         memcpy(script, &(lastScriptExtent->scripts[backwardsIndex]), sizeof(Script));
                         memcpy(&(lastScriptExtent->scripts[backwardsIndex]), &temp, sizeof(Script));
 
+                        // CE: Swapped scripts moved, `script` pointers in
+                        // critter procs index are no longer valid.
+                        if (scriptType == SCRIPT_TYPE_CRITTER) {
+                            gCritterProcEntriesDirty = true;
+                        }
+
                         scriptCount++;
                     }
                 }
@@ -2099,6 +2361,8 @@ int scriptLoadAll(File* stream)
         }
     }
 
+    gCritterProcEntriesDirty = true;
+
     return 0;
 }
 
@@ -2220,6 +2484,10 @@ int scriptAdd(int* sidPtr, int scriptType)
 
     scriptListExtent->length++;
 
+    if (scriptType == SCRIPT_TYPE_CRITTER) {
+        gCritterProcEntriesDirty = true;
+    }
+
     return 0;
 }
 
@@ -2316,6 +2584,10 @@ int scriptRemove(int sid)
             debugPrint("\nERROR Removing Timed Events on scr_remove!!\n");
         }
 
+        if (SID_TYPE(sid) == SCRIPT_TYPE_CRITTER) {
+            gCritterProcEntriesDirty = true;
+        }
+
         if (scriptListExtent == scriptList->tail && index + 1 == scriptListExtent->length) {
             // Removing last script in tail extent
             scriptListExtent->length -= 1;
@@ -2367,6 +2639,8 @@ int scriptRemove(int sid)
 // 0x4A63E0
 int _scr_remove_all()
 {
+    scriptsCancelMapUpdate();
+
     _queue_clear_type(EVENT_TYPE_SCRIPT, nullptr);
     _scr_message_free();
 
@@ -2411,6 +2685,8 @@ int _scr_remove_all()
 // 0x4A64A8
 int _scr_remove_all_force()
 {
+    scriptsCancelMapUpdate();
+
     _queue_clear_type(EVENT_TYPE_SCRIPT, nullptr);
     _scr_message_free();
 
@@ -2428,6 +2704,8 @@ int _scr_remove_all_force()
         scriptList->length = 0;
     }
 
+    gCritterProcEntriesDirty = true;
+
     gScriptsEnumerationScriptIndex = 0;
     gScriptsEnumerationScriptListExtent = nullptr;
     gScriptsEnumerationElevation = 0;
@@ -2600,6 +2878,11 @@ void scriptsExecMapUpdateProc()
 // 0x4A67EC
 void scriptsExecMapUpdateScripts(int proc)
 {
+    // CE: Map update spread over several frames should not outlive the map.
+    if (proc != SCRIPT_PROC_MAP_UPDATE) {
+        scriptsCancelMapUpdate();
+    }
+
     // SFALL: Run global scripts.
     sfall_gl_scr_exec_map_update_scripts(proc);
 
@@ -57,6 +57,12 @@ static void settingsFromConfig()
     settingsRead(GAME_CONFIG_SYSTEM_KEY, GAME_CONFIG_HASHING_KEY, settings.system.hashing);
     settingsRead(GAME_CONFIG_SYSTEM_KEY, GAME_CONFIG_SPLASH_KEY, settings.system.splash);
     settingsRead(GAME_CONFIG_SYSTEM_KEY, GAME_CONFIG_FREE_SPACE_KEY, settings.system.free_space);
+    settingsRead(GAME_CONFIG_SYSTEM_KEY, GAME_CONFIG_SCRIPT_TIME_BUDGET_KEY, settings.system.script_time_budget);
+    settingsRead(GAME_CONFIG_SYSTEM_KEY, GAME_CONFIG_CRITTER_PROC_QUOTA_KEY, settings.system.critter_proc_quota);
+    settingsRead(GAME_CONFIG_SYSTEM_KEY, GAME_CONFIG_CRITTER_PROC_PRIORITY_KEY, settings.system.critter_proc_priority);
+    settingsRead(GAME_CONFIG_SYSTEM_KEY, GAME_CONFIG_CRITTER_PROC_MAX_DISTANCE_KEY, settings.system.critter_proc_max_distance);
+    settingsRead(GAME_CONFIG_SYSTEM_KEY, GAME_CONFIG_MAP_UPDATE_FRAMES_KEY, settings.system.map_update_frames);
+    settingsRead(GAME_CONFIG_SYSTEM_KEY, GAME_CONFIG_MOVIE_DECODE_AHEAD_KEY, settings.system.movie_decode_ahead);
 
     settingsRead(GAME_CONFIG_PREFERENCES_KEY, GAME_CONFIG_GAME_DIFFICULTY_KEY, settings.preferences.game_difficulty);
     settingsRead(GAME_CONFIG_PREFERENCES_KEY, GAME_CONFIG_COMBAT_DIFFICULTY_KEY, settings.preferences.combat_difficulty);
@@ -92,6 +98,8 @@ static void settingsFromConfig()
     settingsRead(GAME_CONFIG_SOUND_KEY, GAME_CONFIG_SNDFX_VOLUME_KEY, settings.sound.sndfx_volume);
     settingsRead(GAME_CONFIG_SOUND_KEY, GAME_CONFIG_SPEECH_VOLUME_KEY, settings.sound.speech_volume);
     settingsRead(GAME_CONFIG_SOUND_KEY, GAME_CONFIG_CACHE_SIZE_KEY, settings.sound.cache_size);
+    settingsRead(GAME_CONFIG_SOUND_KEY, GAME_CONFIG_PCM_CACHE_SIZE_KEY, settings.sound.pcm_cache_size);
+    settingsRead(GAME_CONFIG_SOUND_KEY, GAME_CONFIG_MAX_VOICES_KEY, settings.sound.max_voices);
     settingsRead(GAME_CONFIG_SOUND_KEY, GAME_CONFIG_MUSIC_PATH1_KEY, settings.sound.music_path1);
     settingsRead(GAME_CONFIG_SOUND_KEY, GAME_CONFIG_MUSIC_PATH2_KEY, settings.sound.music_path2);
 
@@ -100,6 +108,11 @@ static void settingsFromConfig()
     settingsRead(GAME_CONFIG_DEBUG_KEY, GAME_CONFIG_SHOW_SCRIPT_MESSAGES_KEY, settings.debug.show_script_messages);
     settingsRead(GAME_CONFIG_DEBUG_KEY, GAME_CONFIG_SHOW_LOAD_INFO_KEY, settings.debug.show_load_info);
     settingsRead(GAME_CONFIG_DEBUG_KEY, GAME_CONFIG_OUTPUT_MAP_DATA_INFO_KEY, settings.debug.output_map_data_info);
+    settingsRead(GAME_CONFIG_DEBUG_KEY, GAME_CONFIG_PROFILER_KEY, settings.debug.profiler);
+    settingsRead(GAME_CONFIG_DEBUG_KEY, GAME_CONFIG_PROFILER_OUTPUT_KEY, settings.debug.profiler_output);
+    settingsRead(GAME_CONFIG_DEBUG_KEY, GAME_CONFIG_SCRIPT_STATS_KEY, settings.debug.script_stats);
+    settingsRead(GAME_CONFIG_DEBUG_KEY, GAME_CONFIG_SCRIPT_PROFILER_KEY, settings.debug.script_profiler);
+    settingsRead(GAME_CONFIG_DEBUG_KEY, GAME_CONFIG_SCRIPT_PROFILER_OUTPUT_KEY, settings.debug.script_profiler_output);
 
     settingsRead(GAME_CONFIG_MAPPER_KEY, GAME_CONFIG_OVERRIDE_LIBRARIAN_KEY, settings.mapper.override_librarian);
     settingsRead(GAME_CONFIG_MAPPER_KEY, GAME_CONFIG_LIBRARIAN_KEY, settings.mapper.librarian);
@@ -131,6 +144,12 @@ static void settingsToConfig()
     settingsWrite(GAME_CONFIG_SYSTEM_KEY, GAME_CONFIG_HASHING_KEY, settings.system.hashing);
     settingsWrite(GAME_CONFIG_SYSTEM_KEY, GAME_CONFIG_SPLASH_KEY, settings.system.splash);
     settingsWrite(GAME_CONFIG_SYSTEM_KEY, GAME_CONFIG_FREE_SPACE_KEY, settings.system.free_space);
+    settingsWrite(GAME_CONFIG_SYSTEM_KEY, GAME_CONFIG_SCRIPT_TIME_BUDGET_KEY, settings.system.script_time_budget);
+    settingsWrite(GAME_CONFIG_SYSTEM_KEY, GAME_CONFIG_CRITTER_PROC_QUOTA_KEY, settings.system.critter_proc_quota);
+    settingsWrite(GAME_CONFIG_SYSTEM_KEY, GAME_CONFIG_CRITTER_PROC_PRIORITY_KEY, settings.system.critter_proc_priority);
+    settingsWrite(GAME_CONFIG_SYSTEM_KEY, GAME_CONFIG_CRITTER_PROC_MAX_DISTANCE_KEY, settings.system.critter_proc_max_distance);
+    settingsWrite(GAME_CONFIG_SYSTEM_KEY, GAME_CONFIG_MAP_UPDATE_FRAMES_KEY, settings.system.map_update_frames);
+    settingsWrite(GAME_CONFIG_SYSTEM_KEY, GAME_CONFIG_MOVIE_DECODE_AHEAD_KEY, settings.system.movie_decode_ahead);
 
     settingsWrite(GAME_CONFIG_PREFERENCES_KEY, GAME_CONFIG_GAME_DIFFICULTY_KEY, settings.preferences.game_difficulty);
     settingsWrite(GAME_CONFIG_PREFERENCES_KEY, GAME_CONFIG_COMBAT_DIFFICULTY_KEY, settings.preferences.combat_difficulty);
@@ -166,6 +185,8 @@ static void settingsToConfig()
     settingsWrite(GAME_CONFIG_SOUND_KEY, GAME_CONFIG_SNDFX_VOLUME_KEY, settings.sound.sndfx_volume);
     settingsWrite(GAME_CONFIG_SOUND_KEY, GAME_CONFIG_SPEECH_VOLUME_KEY, settings.sound.speech_volume);
     settingsWrite(GAME_CONFIG_SOUND_KEY, GAME_CONFIG_CACHE_SIZE_KEY, settings.sound.cache_size);
+    settingsWrite(GAME_CONFIG_SOUND_KEY, GAME_CONFIG_PCM_CACHE_SIZE_KEY, settings.sound.pcm_cache_size);
+    settingsWrite(GAME_CONFIG_SOUND_KEY, GAME_CONFIG_MAX_VOICES_KEY, settings.sound.max_voices);
     settingsWrite(GAME_CONFIG_SOUND_KEY, GAME_CONFIG_MUSIC_PATH1_KEY, settings.sound.music_path1);
     settingsWrite(GAME_CONFIG_SOUND_KEY, GAME_CONFIG_MUSIC_PATH2_KEY, settings.sound.music_path2);
 
@@ -174,6 +195,11 @@ static void settingsToConfig()
     settingsWrite(GAME_CONFIG_DEBUG_KEY, GAME_CONFIG_SHOW_SCRIPT_MESSAGES_KEY, settings.debug.show_script_messages);
     settingsWrite(GAME_CONFIG_DEBUG_KEY, GAME_CONFIG_SHOW_LOAD_INFO_KEY, settings.debug.show_load_info);
     settingsWrite(GAME_CONFIG_DEBUG_KEY, GAME_CONFIG_OUTPUT_MAP_DATA_INFO_KEY, settings.debug.output_map_data_info);
+    settingsWrite(GAME_CONFIG_DEBUG_KEY, GAME_CONFIG_PROFILER_KEY, settings.debug.profiler);
+    settingsWrite(GAME_CONFIG_DEBUG_KEY, GAME_CONFIG_PROFILER_OUTPUT_KEY, settings.debug.profiler_output);
+    settingsWrite(GAME_CONFIG_DEBUG_KEY, GAME_CONFIG_SCRIPT_STATS_KEY, settings.debug.script_stats);
+    settingsWrite(GAME_CONFIG_DEBUG_KEY, GAME_CONFIG_SCRIPT_PROFILER_KEY, settings.debug.script_profiler);
+    settingsWrite(GAME_CONFIG_DEBUG_KEY, GAME_CONFIG_SCRIPT_PROFILER_OUTPUT_KEY, settings.debug.script_profiler_output);
 
     settingsWrite(GAME_CONFIG_MAPPER_KEY, GAME_CONFIG_OVERRIDE_LIBRARIAN_KEY, settings.mapper.override_librarian);
     settingsWrite(GAME_CONFIG_MAPPER_KEY, GAME_CONFIG_LIBRARIAN_KEY, settings.mapper.librarian);
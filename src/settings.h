@@ -23,6 +23,12 @@ struct SystemSettings {
     int splash = 0;
     int free_space = 20480;
     int times_run = 0;
+    int script_time_budget = 0;
+    int critter_proc_quota = 1;
+    bool critter_proc_priority = false;
+    int critter_proc_max_distance = 0;
+    int map_update_frames = 1;
+    bool movie_decode_ahead = false;
 };
 
 struct PreferencesSettings {
@@ -62,6 +68,8 @@ struct SoundSettings {
     int sndfx_volume = 22281;
     int speech_volume = 22281;
     int cache_size = 448;
+    int pcm_cache_size = 2048;
+    int max_voices = 8;
     std::string music_path1 = "sound\\music\\";
     std::string music_path2 = "sound\\music\\";
 };
@@ -72,6 +80,11 @@ struct DebugSettings {
     bool show_script_messages = false;
     bool show_load_info = false;
     bool output_map_data_info = false;
+    bool profiler = false;
+    std::string profiler_output = "profile.json";
+    bool script_stats = false;
+    bool script_profiler = false;
+    std::string script_profiler_output = "script_profile.txt";
 };
 
 struct MapperSettings {
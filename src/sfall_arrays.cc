@@ -6,6 +6,7 @@
 #include <algorithm>
 #include <memory>
 #include <random>
+#include <string_view>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
@@ -192,6 +193,26 @@ public:
         }
     }
 
+    size_t hash() const
+    {
+        switch (type) {
+        case ArrayElementType::INT:
+            return std::hash<int>()(value.integerValue);
+        case ArrayElementType::FLOAT:
+            // 0.0 and -0.0 are equal, but have different representation.
+            if (value.floatValue == 0.0f) {
+                return 0;
+            }
+            return std::hash<float>()(value.floatValue);
+        case ArrayElementType::POINTER:
+            return std::hash<void*>()(value.pointerValue);
+        case ArrayElementType::STRING:
+            return std::hash<std::string_view>()(std::string_view(value.stringValue));
+        default:
+            return 0;
+        }
+    }
+
     ~ArrayElement()
     {
         if (type == ArrayElementType::STRING) {
@@ -337,6 +358,8 @@ private:
     std::vector<ArrayElement> values;
 };
 
+// Pairs are kept in insertion order (which is exposed with `GetArrayKey`)
+// and indexed by key hash.
 class SFallArrayAssoc : public SFallArray {
 public:
     SFallArrayAssoc() = delete;
@@ -348,7 +371,7 @@ public:
 
     int size()
     {
-        return static_cast<int>(pairs.size());
+        return static_cast<int>(pairs.size()) - tombstones;
     }
 
     ProgramValue GetArrayKey(int index, Program* program)
@@ -361,51 +384,48 @@ public:
             return ProgramValue(1);
         }
 
+        Compact();
+
         return pairs[index].key.toValue(program);
     }
 
     ProgramValue GetArray(const ProgramValue& key, Program* program)
     {
         auto keyEl = ArrayElement { key, program };
-        auto it = std::find_if(pairs.begin(), pairs.end(), [&keyEl](const KeyValuePair& pair) -> bool {
-            return pair.key == keyEl;
-        });
-
-        if (it == pairs.end()) {
+        int index = FindKey(keyEl, keyEl.hash());
+        if (index == -1) {
             return ProgramValue(0);
         }
 
-        auto index = it - pairs.begin();
         return pairs[index].value.toValue(program);
     }
 
     void SetArray(const ProgramValue& key, const ProgramValue& val, bool allowUnset, Program* program)
     {
         auto keyEl = ArrayElement { key, program };
-        auto it = std::find_if(pairs.begin(), pairs.end(), [&keyEl](const KeyValuePair& pair) -> bool {
-            return pair.key == keyEl;
-        });
+        size_t hash = keyEl.hash();
+        int index = FindKey(keyEl, hash);
 
-        if (it != pairs.end() && isReadOnly()) {
+        if (index != -1 && isReadOnly()) {
             // don't update value of key
             return;
         }
 
         if (allowUnset && !isReadOnly() && val.isInt() && val.asInt() == 0) {
             // after assigning zero to a key, no need to store it, because "get_array" returns 0 for non-existent keys: try unset
-            if (it != pairs.end()) {
-                pairs.erase(it);
+            if (index != -1) {
+                RemovePair(index, hash);
             }
         } else {
-            if (it == pairs.end()) {
+            if (index == -1) {
                 // size check
                 if (size() >= ARRAY_MAX_SIZE) {
                     return;
                 }
 
-                pairs.push_back(KeyValuePair { std::move(keyEl), ArrayElement { val, program } });
+                keyIndexes.emplace(hash, static_cast<int>(pairs.size()));
+                pairs.push_back(KeyValuePair { std::move(keyEl), ArrayElement { val, program }, false });
             } else {
-                auto index = it - pairs.begin();
                 pairs[index].value = ArrayElement { val, program };
             }
         }
@@ -422,12 +442,16 @@ public:
             return;
         }
 
+        Compact();
+
         // only allow to reduce number of elements (adding range of elements is meaningless for maps)
         if (newLen >= 0 && newLen < size()) {
             pairs.resize(newLen);
+            RebuildKeyIndexes();
         } else if (newLen < 0) {
             if (newLen < (ARRAY_ACTION_SHUFFLE - 2)) return;
             MapSort(newLen);
+            RebuildKeyIndexes();
         }
     }
 
@@ -435,7 +459,7 @@ public:
     {
         auto valueEl = ArrayElement { value, program };
         auto it = std::find_if(pairs.begin(), pairs.end(), [&valueEl](const KeyValuePair& pair) {
-            return pair.value == valueEl;
+            return !pair.removed && pair.value == valueEl;
         });
 
         if (it == pairs.end()) {
@@ -449,8 +473,72 @@ private:
     struct KeyValuePair {
         ArrayElement key;
         ArrayElement value;
+
+        // Removed pairs are kept in place until `Compact` so that removal
+        // does not shift subsequent pairs.
+        bool removed;
     };
 
+    // Returns index of pair with given key, or -1 if there is no such key.
+    int FindKey(const ArrayElement& key, size_t hash)
+    {
+        auto range = keyIndexes.equal_range(hash);
+        for (auto it = range.first; it != range.second; ++it) {
+            if (pairs[it->second].key == key) {
+                return it->second;
+            }
+        }
+
+        return -1;
+    }
+
+    // Marks pair as removed, remaining pairs keep their order and indexes.
+    // Removed pairs are dropped once they make up more than a half of
+    // `pairs`, so removal is O(1) amortized.
+    void RemovePair(int index, size_t hash)
+    {
+        auto range = keyIndexes.equal_range(hash);
+        for (auto it = range.first; it != range.second; ++it) {
+            if (it->second == index) {
+                keyIndexes.erase(it);
+                break;
+            }
+        }
+
+        pairs[index].key = ArrayElement {};
+        pairs[index].value = ArrayElement {};
+        pairs[index].removed = true;
+        tombstones++;
+
+        if (tombstones > static_cast<int>(pairs.size()) / 2) {
+            Compact();
+        }
+    }
+
+    // Drops removed pairs, must be done before accessing pairs by index.
+    void Compact()
+    {
+        if (tombstones == 0) {
+            return;
+        }
+
+        pairs.erase(std::remove_if(pairs.begin(), pairs.end(), [](const KeyValuePair& pair) {
+            return pair.removed;
+        }),
+            pairs.end());
+        tombstones = 0;
+
+        RebuildKeyIndexes();
+    }
+
+    void RebuildKeyIndexes()
+    {
+        keyIndexes.clear();
+        for (int index = 0; index < size(); index++) {
+            keyIndexes.emplace(pairs[index].key.hash(), index);
+        }
+    }
+
     void MapSort(int type)
     {
         bool sortByValue = false;
@@ -471,6 +559,12 @@ private:
     }
 
     std::vector<KeyValuePair> pairs;
+
+    // Number of removed pairs in `pairs`.
+    int tombstones = 0;
+
+    // Indexes of pairs (except removed ones) by key hash.
+    std::unordered_multimap<size_t, int> keyIndexes;
 };
 
 struct SfallArraysState {
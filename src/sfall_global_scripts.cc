@@ -101,8 +101,9 @@ void sfall_gl_scr_exec_start_proc()
             GlobalScript scr;
             scr.program = program;
 
+            const int* indexes = programGetProcedureIndexes(program, gScriptProcNames, SCRIPT_PROC_COUNT);
             for (int action = 0; action < SCRIPT_PROC_COUNT; action++) {
-                scr.procs[action] = programFindProcedure(program, gScriptProcNames[action]);
+                scr.procs[action] = indexes[action];
             }
 
             state->globalScripts.push_back(std::move(scr));
@@ -13,6 +13,10 @@
 #endif
 
 #include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <new>
+#include <thread>
 
 #include <SDL.h>
 
@@ -29,6 +33,22 @@ typedef enum SoundStatusFlags {
     SOUND_STATUS_IS_PAUSED = 0x08,
 } SoundStatusFlags;
 
+// CE: Number of chunks (`dataSize` bytes each) streaming thread decodes ahead
+// of playback.
+#define SOUND_STREAM_CAPACITY 8
+
+// CE: Streaming thread is woken up when number of decoded chunks drops below
+// this value.
+#define SOUND_STREAM_LOW_WATERMARK 4
+
+typedef enum SoundStreamChunkFlags {
+    // End of data reached while reading this chunk.
+    SOUND_STREAM_CHUNK_END = 0x01,
+
+    // Last loop finished while reading this chunk.
+    SOUND_STREAM_CHUNK_LOOPS_DONE = 0x02,
+} SoundStreamChunkFlags;
+
 typedef char*(SoundFileNameMangler)(char*);
 
 typedef struct FadeSound {
@@ -42,6 +62,50 @@ typedef struct FadeSound {
     struct FadeSound* next;
 } FadeSound;
 
+typedef struct SoundStreamChunk {
+    unsigned char* data;
+    int size;
+    int flags;
+
+    // Number of times sound looped while reading this chunk, reported with
+    // `0x400` callback when the chunk is consumed.
+    int loops;
+} SoundStreamChunk;
+
+// CE: Streaming sounds are read and decoded ahead by streaming thread into
+// ring of chunks, `_refreshSoundBuffers` only copies them into sound buffer.
+//
+// Reading state of the sound (file handle, `loops`, `field_54`, `field_58`) is
+// protected by `mutex`. Ring indices and `busy` are protected by
+// `gSoundStreamMutex`. When both are needed `mutex` is taken first.
+typedef struct SoundStream {
+    Sound* sound;
+    std::mutex mutex;
+    SoundStreamChunk chunks[SOUND_STREAM_CAPACITY];
+
+    // Total number of chunks produced and consumed.
+    unsigned int head;
+    unsigned int tail;
+
+    // Streaming thread is reading into this stream.
+    bool busy;
+
+    // Chunks are read ahead by streaming thread. Sounds with IO procs that are
+    // not thread safe (database backed) read chunks on the main thread when
+    // they are consumed.
+    bool threaded;
+
+    // Copies of `SOUND_LOOPING` and `SOUND_FLAG_0x100` used for reading so
+    // that `soundFlags` is only touched from the main thread.
+    bool looping;
+    bool once;
+
+    // End of data was reached, all subsequent chunks are silent.
+    bool ended;
+
+    struct SoundStream* next;
+} SoundStream;
+
 static void* soundMallocProcDefaultImpl(size_t size);
 static void* soundReallocProcDefaultImpl(void* ptr, size_t size);
 static void soundFreeProcDefaultImpl(void* ptr);
@@ -66,6 +130,12 @@ static void _removeTimedEvent(SDL_TimerID* timerId);
 static void _removeFadeSound(FadeSound* fadeSound);
 static void _fadeSounds();
 static int _internalSoundFade(Sound* sound, int duration, int targetVolume, bool pause);
+static void soundStreamThreadMain();
+static bool soundStreamAttach(Sound* sound);
+static void soundStreamDetach(Sound* sound);
+static void soundStreamReset(SoundStream* stream);
+static bool soundStreamProduce(SoundStream* stream);
+static void soundStreamReadChunk(SoundStream* stream, SoundStreamChunk* chunk);
 
 // 0x51D478
 static FadeSound* _fadeHead = nullptr;
@@ -165,6 +235,27 @@ static Sound* gSoundListHead;
 
 static SDL_TimerID gFadeSoundsTimerId = 0;
 
+// CE: Streaming thread and list of streams it serves.
+static std::thread gSoundStreamThread;
+static std::mutex gSoundStreamMutex;
+static std::condition_variable gSoundStreamCondition;
+static bool gSoundStreamThreadQuit = false;
+static SoundStream* gSoundStreams = nullptr;
+
+// CE: Serializes reading by streaming thread with opening and closing files
+// on the main thread. File IO procs keep their handles in shared lists which
+// are reallocated on open.
+static std::mutex gSoundIoMutex;
+
+// CE: Number of refills which found no decoded chunks and had to read on the
+// main thread.
+static unsigned int gSoundStreamUnderruns = 0;
+
+// CE: Decode-ahead depth statistics sampled on every refill.
+static unsigned int gSoundStreamMinDepth = SOUND_STREAM_CAPACITY;
+static unsigned long long gSoundStreamDepthSum = 0;
+static unsigned int gSoundStreamDepthSamples = 0;
+
 // 0x4AC6F0
 void* soundMallocProcDefaultImpl(size_t size)
 {
@@ -350,69 +441,60 @@ void _refreshSoundBuffers(Sound* sound)
     }
     unsigned char* audioPtr = (unsigned char*)audioPtr1;
     int audioBytes = audioBytes1;
+    SoundStream* stream = sound->stream;
+
+    // CE: Sample decode-ahead depth before consuming.
+    if (stream->threaded) {
+        std::lock_guard<std::mutex> lock(gSoundStreamMutex);
+        unsigned int depth = stream->head - stream->tail;
+        gSoundStreamMinDepth = std::min(gSoundStreamMinDepth, depth);
+        gSoundStreamDepthSum += depth;
+        gSoundStreamDepthSamples++;
+    }
+
     while (--v53 != -1) {
-        int bytesRead;
-        if ((sound->soundFlags & SOUND_FLAG_0x200) != 0) {
-            bytesRead = sound->dataSize;
-            memset(sound->data, 0, bytesRead);
-        } else {
-            int bytesToRead = sound->dataSize;
-            if (sound->field_58 != -1) {
-                int pos = sound->io.tell(sound->io.fd);
-                if (bytesToRead + pos > sound->field_58) {
-                    bytesToRead = sound->field_58 - pos;
+        // CE: Take next chunk decoded by streaming thread. Read it here only
+        // if streaming thread is behind (or the stream is not threaded).
+        SoundStreamChunk* chunk;
+        {
+            std::unique_lock<std::mutex> lock(gSoundStreamMutex);
+            if (stream->head == stream->tail) {
+                lock.unlock();
+
+                if (stream->threaded) {
+                    gSoundStreamUnderruns++;
                 }
+                soundStreamProduce(stream);
+
+                lock.lock();
             }
 
-            bytesRead = sound->io.read(sound->io.fd, sound->data, bytesToRead);
-            if (bytesRead < sound->dataSize) {
-                if ((sound->soundFlags & SOUND_LOOPING) == 0 || (sound->soundFlags & SOUND_FLAG_0x100) != 0) {
-                    memset(sound->data + bytesRead, 0, sound->dataSize - bytesRead);
-                    sound->soundFlags |= SOUND_FLAG_0x200;
-                    bytesRead = sound->dataSize;
-                } else {
-                    while (bytesRead < sound->dataSize) {
-                        if (sound->loops == -1) {
-                            sound->io.seek(sound->io.fd, sound->field_54, SEEK_SET);
-                            if (sound->callback != nullptr) {
-                                sound->callback(sound->callbackUserData, 0x0400);
-                            }
-                        } else {
-                            if (sound->loops <= 0) {
-                                sound->field_58 = -1;
-                                sound->field_54 = 0;
-                                sound->loops = 0;
-                                sound->soundFlags &= ~SOUND_LOOPING;
-                                bytesRead += sound->io.read(sound->io.fd, sound->data + bytesRead, sound->dataSize - bytesRead);
-                                break;
-                            }
-
-                            sound->loops--;
-                            sound->io.seek(sound->io.fd, sound->field_54, SEEK_SET);
-
-                            if (sound->callback != nullptr) {
-                                sound->callback(sound->callbackUserData, 0x400);
-                            }
-                        }
+            chunk = &(stream->chunks[stream->tail % SOUND_STREAM_CAPACITY]);
+        }
 
-                        if (sound->field_58 == -1) {
-                            bytesToRead = sound->dataSize - bytesRead;
-                        } else {
-                            int pos = sound->io.tell(sound->io.fd);
-                            if (sound->dataSize + bytesRead + pos <= sound->field_58) {
-                                bytesToRead = sound->dataSize - bytesRead;
-                            } else {
-                                bytesToRead = sound->field_58 - bytesRead - pos;
-                            }
-                        }
+        if ((chunk->flags & SOUND_STREAM_CHUNK_END) != 0) {
+            sound->soundFlags |= SOUND_FLAG_0x200;
+        }
 
-                        int v20 = sound->io.read(sound->io.fd, sound->data + bytesRead, bytesToRead);
-                        bytesRead += v20;
-                        if (v20 < bytesToRead) {
-                            break;
-                        }
-                    }
-                }
+        if ((chunk->flags & SOUND_STREAM_CHUNK_LOOPS_DONE) != 0) {
+            sound->soundFlags &= ~SOUND_LOOPING;
+        }
+
+        for (int loop = 0; loop < chunk->loops; loop++) {
+            if (sound->callback != nullptr) {
+                sound->callback(sound->callbackUserData, 0x400);
+            }
+        }
+
+        int bytesRead = chunk->size;
+        memcpy(sound->data, chunk->data, bytesRead);
+
+        {
+            std::lock_guard<std::mutex> lock(gSoundStreamMutex);
+            stream->tail++;
+
+            if (stream->head - stream->tail < SOUND_STREAM_LOW_WATERMARK) {
+                gSoundStreamCondition.notify_all();
             }
         }
 
@@ -456,6 +538,13 @@ int soundInit(int a1, int numBuffers, int a3, int dataSize, int rate)
     gSoundInitialized = true;
     _deviceInit = 1;
 
+    gSoundStreamThreadQuit = false;
+    gSoundStreamUnderruns = 0;
+    gSoundStreamMinDepth = SOUND_STREAM_CAPACITY;
+    gSoundStreamDepthSum = 0;
+    gSoundStreamDepthSamples = 0;
+    gSoundStreamThread = std::thread(soundStreamThreadMain);
+
     _soundSetMasterVolume(VOLUME_MAX);
 
     gSoundLastError = SOUND_NO_ERROR;
@@ -475,6 +564,21 @@ void soundExit()
         _removeTimedEvent(&gFadeSoundsTimerId);
     }
 
+    if (gSoundStreamThread.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(gSoundStreamMutex);
+            gSoundStreamThreadQuit = true;
+        }
+        gSoundStreamCondition.notify_all();
+        gSoundStreamThread.join();
+
+        debugPrint("Sound streaming: %u underruns, decode-ahead depth min %u, avg %u of %d chunks\n",
+            gSoundStreamUnderruns,
+            gSoundStreamDepthSamples != 0 ? gSoundStreamMinDepth : 0,
+            gSoundStreamDepthSamples != 0 ? (unsigned int)(gSoundStreamDepthSum / gSoundStreamDepthSamples) : 0,
+            SOUND_STREAM_CAPACITY);
+    }
+
     while (_fadeFreeList != nullptr) {
         FadeSound* next = _fadeFreeList->next;
         gSoundFreeProc(_fadeFreeList);
@@ -483,6 +587,18 @@ void soundExit()
 
     audioEngineExit();
 
+    AudioEngineMixStats mixStats;
+    audioEngineGetMixStats(&mixStats);
+    if (mixStats.callbacks != 0) {
+        debugPrint("Sound mixer: %u callbacks, %llu frames at %d Hz, %llu frames per CPU second, avg %llu us, p99 %u us\n",
+            mixStats.callbacks,
+            mixStats.frames,
+            mixStats.rate,
+            mixStats.time != 0 ? mixStats.frames * 1000000 / mixStats.time : 0,
+            mixStats.time / mixStats.callbacks,
+            mixStats.p99Time);
+    }
+
     gSoundLastError = SOUND_NO_ERROR;
     gSoundInitialized = false;
 }
@@ -525,6 +641,7 @@ Sound* soundAllocate(int type, int soundFlags)
     sound->field_58 = -1;
     sound->minReadBuffer = 1;
     sound->volume = VOLUME_MAX;
+    sound->priority = AUDIO_ENGINE_SOUND_BUFFER_PRIORITY_DEFAULT;
     sound->prev = nullptr;
     sound->field_54 = 0;
     sound->next = gSoundListHead;
@@ -592,12 +709,23 @@ int _preloadBuffers(Sound* sound)
     gSoundFreeProc(buf);
 
     if ((sound->type & SOUND_TYPE_MEMORY) != 0) {
+        std::lock_guard<std::mutex> ioLock(gSoundIoMutex);
         sound->io.close(sound->io.fd);
         sound->io.fd = -1;
     } else {
         if (sound->data == nullptr) {
             sound->data = (unsigned char*)gSoundMallocProc(sound->dataSize);
         }
+
+        // CE: Hand the rest of the file to streaming thread.
+        if (sound->stream == nullptr) {
+            if (!soundStreamAttach(sound)) {
+                gSoundLastError = SOUND_NO_MEMORY_AVAILABLE;
+                return gSoundLastError;
+            }
+        } else {
+            soundStreamReset(sound->stream);
+        }
     }
 
     return result;
@@ -616,7 +744,10 @@ int soundLoad(Sound* sound, char* filePath)
         return gSoundLastError;
     }
 
-    sound->io.fd = sound->io.open(gSoundFileNameMangler(filePath), &(sound->rate));
+    {
+        std::lock_guard<std::mutex> ioLock(gSoundIoMutex);
+        sound->io.fd = sound->io.open(gSoundFileNameMangler(filePath), &(sound->rate));
+    }
     if (sound->io.fd == -1) {
         gSoundLastError = SOUND_FILE_NOT_FOUND;
         return gSoundLastError;
@@ -641,6 +772,12 @@ int _soundRewind(Sound* sound)
     }
 
     if ((sound->type & SOUND_TYPE_STREAMING) != 0) {
+        // CE: Keep streaming thread away while file is rewound.
+        std::unique_lock<std::mutex> streamLock;
+        if (sound->stream != nullptr) {
+            streamLock = std::unique_lock<std::mutex>(sound->stream->mutex);
+        }
+
         sound->io.seek(sound->io.fd, 0, SEEK_SET);
         sound->lastUpdate = 0;
         sound->lastPosition = 0;
@@ -713,6 +850,8 @@ int _soundSetData(Sound* sound, unsigned char* buf, int size)
             gSoundLastError = SOUND_UNKNOWN_ERROR;
             return gSoundLastError;
         }
+
+        audioEngineSoundBufferSetPriority(sound->soundBuffer, sound->priority);
     }
 
     return _addSoundData(sound, buf, size);
@@ -805,7 +944,11 @@ int soundDelete(Sound* sample)
         return gSoundLastError;
     }
 
+    // CE: Streaming thread must let go of the file before it's closed.
+    soundStreamDetach(sample);
+
     if (sample->io.fd != -1) {
+        std::lock_guard<std::mutex> ioLock(gSoundIoMutex);
         sample->io.close(sample->io.fd);
         sample->io.fd = -1;
     }
@@ -991,6 +1134,12 @@ int soundSetLooping(Sound* sound, int loops)
         return gSoundLastError;
     }
 
+    // CE: Loop state is used by streaming thread.
+    std::unique_lock<std::mutex> streamLock;
+    if (sound->stream != nullptr) {
+        streamLock = std::unique_lock<std::mutex>(sound->stream->mutex);
+    }
+
     if (loops != 0) {
         sound->soundFlags |= SOUND_LOOPING;
         sound->loops = loops;
@@ -1001,6 +1150,10 @@ int soundSetLooping(Sound* sound, int loops)
         sound->soundFlags &= ~SOUND_LOOPING;
     }
 
+    if (sound->stream != nullptr) {
+        sound->stream->looping = (sound->soundFlags & SOUND_LOOPING) != 0;
+    }
+
     gSoundLastError = SOUND_NO_ERROR;
     return gSoundLastError;
 }
@@ -1131,6 +1284,29 @@ int soundSetReadLimit(Sound* sound, int readLimit)
     return gSoundLastError;
 }
 
+// CE: Sets voice priority used when number of mixed sounds is limited.
+int soundSetPriority(Sound* sound, int priority)
+{
+    if (!gSoundInitialized) {
+        gSoundLastError = SOUND_NOT_INITIALIZED;
+        return gSoundLastError;
+    }
+
+    if (sound == nullptr) {
+        gSoundLastError = SOUND_NO_SOUND;
+        return gSoundLastError;
+    }
+
+    sound->priority = priority;
+
+    if (sound->soundBuffer != -1) {
+        audioEngineSoundBufferSetPriority(sound->soundBuffer, priority);
+    }
+
+    gSoundLastError = SOUND_NO_ERROR;
+    return gSoundLastError;
+}
+
 // TODO: Check, looks like it uses couple of inlined functions.
 //
 // 0x4AE0E4
@@ -1261,6 +1437,28 @@ int soundSetFileIO(Sound* sound, SoundOpenProc* openProc, SoundCloseProc* closeP
     return gSoundLastError;
 }
 
+// CE: Allows streaming thread to read the sound ahead with its file IO procs.
+// Procs must not use database (`fileRead` and friends are not thread safe),
+// otherwise the sound is read on the main thread. Takes effect on next
+// `soundLoad`.
+int soundSetFileIOThreadSafe(Sound* sound, bool threadSafe)
+{
+    if (!gSoundInitialized) {
+        gSoundLastError = SOUND_NOT_INITIALIZED;
+        return gSoundLastError;
+    }
+
+    if (sound == nullptr) {
+        gSoundLastError = SOUND_NO_SOUND;
+        return gSoundLastError;
+    }
+
+    sound->ioThreadSafe = threadSafe;
+
+    gSoundLastError = SOUND_NO_ERROR;
+    return gSoundLastError;
+}
+
 // 0x4AE378
 void soundDeleteInternal(Sound* sound)
 {
@@ -1412,6 +1610,13 @@ int _soundSetPosition(Sound* sound, int pos)
 
         audioEngineSoundBufferSetCurrentPosition(sound->soundBuffer, section * sound->dataSize + pos % sound->dataSize);
 
+        // CE: Chunks decoded ahead are no longer valid.
+        std::unique_lock<std::mutex> streamLock;
+        if (sound->stream != nullptr) {
+            streamLock = std::unique_lock<std::mutex>(sound->stream->mutex);
+            soundStreamReset(sound->stream);
+        }
+
         sound->io.seek(sound->io.fd, section * sound->dataSize, SEEK_SET);
         int bytesRead = sound->io.read(sound->io.fd, sound->data, sound->dataSize);
         if (bytesRead < sound->dataSize) {
@@ -1432,6 +1637,10 @@ int _soundSetPosition(Sound* sound, int pos)
             sound->lastUpdate = 0;
         }
 
+        if (streamLock.owns_lock()) {
+            streamLock.unlock();
+        }
+
         soundContinue(sound);
     } else {
         audioEngineSoundBufferSetCurrentPosition(sound->soundBuffer, pos);
@@ -1674,4 +1883,223 @@ int soundSetDefaultFileIO(SoundOpenProc* openProc, SoundCloseProc* closeProc, So
     return gSoundLastError;
 }
 
+// CE: Streaming thread, keeps decoded chunks of every stream ahead of
+// playback.
+static void soundStreamThreadMain()
+{
+    std::unique_lock<std::mutex> lock(gSoundStreamMutex);
+    while (!gSoundStreamThreadQuit) {
+        // Serve the stream with the least amount of decoded data first.
+        SoundStream* stream = nullptr;
+        for (SoundStream* curr = gSoundStreams; curr != nullptr; curr = curr->next) {
+            if (curr->threaded && !curr->busy && curr->head - curr->tail < SOUND_STREAM_CAPACITY) {
+                if (stream == nullptr || curr->head - curr->tail < stream->head - stream->tail) {
+                    stream = curr;
+                }
+            }
+        }
+
+        if (stream == nullptr) {
+            gSoundStreamCondition.wait(lock);
+            continue;
+        }
+
+        stream->busy = true;
+        lock.unlock();
+
+        soundStreamProduce(stream);
+
+        lock.lock();
+        stream->busy = false;
+
+        // `soundStreamDetach` might be waiting for this stream.
+        gSoundStreamCondition.notify_all();
+    }
+}
+
+static bool soundStreamAttach(Sound* sound)
+{
+    SoundStream* stream = new (std::nothrow) SoundStream();
+    if (stream == nullptr) {
+        return false;
+    }
+
+    stream->sound = sound;
+    stream->threaded = sound->ioThreadSafe;
+
+    for (int index = 0; index < SOUND_STREAM_CAPACITY; index++) {
+        stream->chunks[index].data = (unsigned char*)gSoundMallocProc(sound->dataSize);
+        if (stream->chunks[index].data == nullptr) {
+            for (int prev = 0; prev < index; prev++) {
+                gSoundFreeProc(stream->chunks[prev].data);
+            }
+            delete stream;
+            return false;
+        }
+    }
+
+    soundStreamReset(stream);
+
+    std::lock_guard<std::mutex> lock(gSoundStreamMutex);
+    stream->next = gSoundStreams;
+    gSoundStreams = stream;
+    sound->stream = stream;
+
+    gSoundStreamCondition.notify_all();
+
+    return true;
+}
+
+static void soundStreamDetach(Sound* sound)
+{
+    SoundStream* stream = sound->stream;
+    if (stream == nullptr) {
+        return;
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(gSoundStreamMutex);
+
+        SoundStream** link = &gSoundStreams;
+        while (*link != stream) {
+            link = &((*link)->next);
+        }
+        *link = stream->next;
+
+        while (stream->busy) {
+            gSoundStreamCondition.wait(lock);
+        }
+    }
+
+    for (int index = 0; index < SOUND_STREAM_CAPACITY; index++) {
+        gSoundFreeProc(stream->chunks[index].data);
+    }
+
+    delete stream;
+    sound->stream = nullptr;
+}
+
+// Drops decoded chunks and resyncs reading state with the sound. Stream's
+// `mutex` must be held (or stream not yet visible to streaming thread).
+static void soundStreamReset(SoundStream* stream)
+{
+    Sound* sound = stream->sound;
+    stream->looping = (sound->soundFlags & SOUND_LOOPING) != 0;
+    stream->once = (sound->soundFlags & SOUND_FLAG_0x100) != 0;
+    stream->ended = (sound->soundFlags & SOUND_FLAG_0x200) != 0;
+
+    {
+        std::lock_guard<std::mutex> lock(gSoundStreamMutex);
+        stream->tail = stream->head;
+    }
+
+    gSoundStreamCondition.notify_all();
+}
+
+// Reads next chunk into the ring. Returns `false` if the ring is full.
+static bool soundStreamProduce(SoundStream* stream)
+{
+    std::lock_guard<std::mutex> streamLock(stream->mutex);
+
+    SoundStreamChunk* chunk;
+    {
+        std::lock_guard<std::mutex> lock(gSoundStreamMutex);
+        if (stream->head - stream->tail >= SOUND_STREAM_CAPACITY) {
+            return false;
+        }
+
+        chunk = &(stream->chunks[stream->head % SOUND_STREAM_CAPACITY]);
+    }
+
+    // Chunk at `head` is never touched by consumer, it's safe to fill it
+    // without holding `gSoundStreamMutex`.
+    {
+        std::lock_guard<std::mutex> ioLock(gSoundIoMutex);
+        soundStreamReadChunk(stream, chunk);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(gSoundStreamMutex);
+        stream->head++;
+    }
+
+    return true;
+}
+
+// Reads `dataSize` bytes of the sound handling loops and end of data. This is
+// the reading part of original `_refreshSoundBuffers`, flags are recorded in
+// chunk and applied to the sound when it's consumed.
+static void soundStreamReadChunk(SoundStream* stream, SoundStreamChunk* chunk)
+{
+    Sound* sound = stream->sound;
+    unsigned char* data = chunk->data;
+
+    chunk->flags = 0;
+    chunk->loops = 0;
+
+    int bytesRead;
+    if (stream->ended) {
+        bytesRead = sound->dataSize;
+        memset(data, 0, bytesRead);
+    } else {
+        int bytesToRead = sound->dataSize;
+        if (sound->field_58 != -1) {
+            int pos = sound->io.tell(sound->io.fd);
+            if (bytesToRead + pos > sound->field_58) {
+                bytesToRead = sound->field_58 - pos;
+            }
+        }
+
+        bytesRead = sound->io.read(sound->io.fd, data, bytesToRead);
+        if (bytesRead < sound->dataSize) {
+            if (!stream->looping || stream->once) {
+                memset(data + bytesRead, 0, sound->dataSize - bytesRead);
+                stream->ended = true;
+                chunk->flags |= SOUND_STREAM_CHUNK_END;
+                bytesRead = sound->dataSize;
+            } else {
+                while (bytesRead < sound->dataSize) {
+                    if (sound->loops == -1) {
+                        sound->io.seek(sound->io.fd, sound->field_54, SEEK_SET);
+                        chunk->loops++;
+                    } else {
+                        if (sound->loops <= 0) {
+                            sound->field_58 = -1;
+                            sound->field_54 = 0;
+                            sound->loops = 0;
+                            stream->looping = false;
+                            chunk->flags |= SOUND_STREAM_CHUNK_LOOPS_DONE;
+                            bytesRead += sound->io.read(sound->io.fd, data + bytesRead, sound->dataSize - bytesRead);
+                            break;
+                        }
+
+                        sound->loops--;
+                        sound->io.seek(sound->io.fd, sound->field_54, SEEK_SET);
+                        chunk->loops++;
+                    }
+
+                    if (sound->field_58 == -1) {
+                        bytesToRead = sound->dataSize - bytesRead;
+                    } else {
+                        int pos = sound->io.tell(sound->io.fd);
+                        if (sound->dataSize + bytesRead + pos <= sound->field_58) {
+                            bytesToRead = sound->dataSize - bytesRead;
+                        } else {
+                            bytesToRead = sound->field_58 - bytesRead - pos;
+                        }
+                    }
+
+                    int v20 = sound->io.read(sound->io.fd, data + bytesRead, bytesToRead);
+                    bytesRead += v20;
+                    if (v20 < bytesToRead) {
+                        break;
+                    }
+                }
+            }
+        }
+    }
+
+    chunk->size = bytesRead;
+}
+
 } // namespace fallout
@@ -87,6 +87,8 @@ typedef enum SoundFlags {
 typedef void SoundCallback(void* userData, int a2);
 typedef void SoundDeleteCallback(void* userData);
 
+struct SoundStream;
+
 typedef struct Sound {
     SoundFileIO io;
     unsigned char* data;
@@ -118,6 +120,15 @@ typedef struct Sound {
     SoundDeleteCallback* deleteCallback;
     struct Sound* next;
     struct Sound* prev;
+
+    // CE: Decode-ahead state of streaming sound.
+    struct SoundStream* stream;
+
+    // CE: Voice priority of sound buffer.
+    int priority;
+
+    // CE: File IO procs can be called from streaming thread.
+    bool ioThreadSafe;
 } Sound;
 
 void soundSetMemoryProcs(MallocProc* mallocProc, ReallocProc* reallocProc, FreeProc* freeProc);
@@ -140,9 +151,11 @@ int soundSetVolume(Sound* sound, int volume);
 int soundSetCallback(Sound* sound, SoundCallback* callback, void* userData);
 int soundSetChannels(Sound* sound, int channels);
 int soundSetReadLimit(Sound* sound, int readLimit);
+int soundSetPriority(Sound* sound, int priority);
 int soundPause(Sound* sound);
 int soundResume(Sound* sound);
 int soundSetFileIO(Sound* sound, SoundOpenProc* openProc, SoundCloseProc* closeProc, SoundReadProc* readProc, SoundWriteProc* writeProc, SoundSeekProc* seekProc, SoundTellProc* tellProc, SoundFileLengthProc* fileLengthProc);
+int soundSetFileIOThreadSafe(Sound* sound, bool threadSafe);
 int _soundSetMasterVolume(int value);
 int _soundGetPosition(Sound* sound);
 int _soundSetPosition(Sound* sound, int pos);
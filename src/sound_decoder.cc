@@ -11,6 +11,16 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <mutex>
+
+#if defined(__SSE2__)
+#define SOUND_DECODER_SSE2
+#include <emmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#define SOUND_DECODER_NEON
+#include <arm_neon.h>
+#endif
+
 namespace fallout {
 
 #define SOUND_DECODER_IN_BUFFER_SIZE (512)
@@ -37,6 +47,9 @@ static int ReadBand_Fmt29(SoundDecoder* soundDecoder, int offset, int bits);
 static bool ReadBands(SoundDecoder* soundDecoder);
 static void untransform_subband0(unsigned char* a1, unsigned char* a2, int a3, int a4);
 static void untransform_subband(unsigned char* a1, unsigned char* a2, int a3, int a4);
+static int untransform_subband0_columns(unsigned char* a1, unsigned char* a2, int a3, int a4);
+static int untransform_subband_columns(unsigned char* a1, unsigned char* a2, int a3, int a4);
+static void soundDecoderPackSamples(const int* src, unsigned short* dest, int count, int shift);
 static void untransform_all(SoundDecoder* soundDecoder);
 static bool soundDecoderFill(SoundDecoder* soundDecoder);
 
@@ -47,6 +60,11 @@ static int ReadBand_Fmt31(SoundDecoder* soundDecoder, int offset, int bits);
 // 0x51E328
 static int gSoundDecodersCount = 0;
 
+// CE: Decoders share scale table (rebuilt by every block), music is decoded on
+// streaming thread while sound effects and speech are decoded on the main
+// thread. Recursive because `soundDecoderInit` frees decoder on failure.
+static std::recursive_mutex gSoundDecodersMutex;
+
 // 0x51E330
 static ReadBandFunc _ReadBand_tbl[32] = {
     ReadBand_Fmt0,
@@ -862,6 +880,15 @@ static void untransform_subband0(unsigned char* a1, unsigned char* a2, int a3, i
     } else {
         int v30 = a4 >> 1;
         int v32 = a3;
+
+        // CE: Columns are independent, process several of them at once.
+        if ((v30 & 0x01) == 0) {
+            int processed = untransform_subband0_columns(a1, a2, a3, a4);
+            a1 += 4 * processed;
+            a2 += 4 * processed;
+            v32 -= processed;
+        }
+
         while (v32 != 0) {
             int* v19 = (int*)a2;
 
@@ -958,6 +985,12 @@ static void untransform_subband(unsigned char* a1, unsigned char* a2, int a3, in
     } else {
         int v24 = a3;
 
+        // CE: Columns are independent, process several of them at once.
+        int processed = untransform_subband_columns(a1, a2, a3, a4);
+        v26 += 2 * processed;
+        v25 += processed;
+        v24 -= processed;
+
         while (v24 != 0) {
             v13 = a4 >> 2;
             v14 = v25;
@@ -994,6 +1027,177 @@ static void untransform_subband(unsigned char* a1, unsigned char* a2, int a3, in
     }
 }
 
+// Vectorized version of the general case of `untransform_subband0`. Returns
+// number of processed columns, remaining ones are left for scalar code.
+static int untransform_subband0_columns(unsigned char* a1, unsigned char* a2, int a3, int a4)
+{
+    int processed = 0;
+
+#if defined(SOUND_DECODER_SSE2)
+    __m128i mask = _mm_set1_epi32(0xFFFF);
+
+    for (; processed + 4 <= a3; processed += 4) {
+        __m128i prev = _mm_loadu_si128((__m128i*)(a1 + 4 * processed));
+        __m128i v20 = _mm_srai_epi32(_mm_slli_epi32(prev, 16), 16);
+        __m128i v22 = _mm_srai_epi32(prev, 16);
+
+        int* v19 = (int*)a2 + processed;
+        for (int v23 = a4 >> 2; v23 != 0; v23--) {
+            __m128i v24 = _mm_loadu_si128((__m128i*)v19);
+            _mm_storeu_si128((__m128i*)v19, _mm_add_epi32(_mm_add_epi32(v24, v20), _mm_slli_epi32(v22, 1)));
+            v19 += a3;
+
+            __m128i v26 = _mm_loadu_si128((__m128i*)v19);
+            _mm_storeu_si128((__m128i*)v19, _mm_sub_epi32(_mm_sub_epi32(_mm_slli_epi32(v24, 1), v22), v26));
+            v19 += a3;
+
+            v20 = _mm_loadu_si128((__m128i*)v19);
+            _mm_storeu_si128((__m128i*)v19, _mm_add_epi32(_mm_add_epi32(v20, v24), _mm_slli_epi32(v26, 1)));
+            v19 += a3;
+
+            v22 = _mm_loadu_si128((__m128i*)v19);
+            _mm_storeu_si128((__m128i*)v19, _mm_sub_epi32(_mm_sub_epi32(_mm_slli_epi32(v20, 1), v26), v22));
+            v19 += a3;
+        }
+
+        _mm_storeu_si128((__m128i*)(a1 + 4 * processed), _mm_or_si128(_mm_and_si128(v20, mask), _mm_slli_epi32(v22, 16)));
+    }
+#elif defined(SOUND_DECODER_NEON)
+    for (; processed + 4 <= a3; processed += 4) {
+        int16x4x2_t prev = vld2_s16((short*)(a1 + 4 * processed));
+        int32x4_t v20 = vmovl_s16(prev.val[0]);
+        int32x4_t v22 = vmovl_s16(prev.val[1]);
+
+        int* v19 = (int*)a2 + processed;
+        for (int v23 = a4 >> 2; v23 != 0; v23--) {
+            int32x4_t v24 = vld1q_s32(v19);
+            vst1q_s32(v19, vaddq_s32(vaddq_s32(v24, v20), vshlq_n_s32(v22, 1)));
+            v19 += a3;
+
+            int32x4_t v26 = vld1q_s32(v19);
+            vst1q_s32(v19, vsubq_s32(vsubq_s32(vshlq_n_s32(v24, 1), v22), v26));
+            v19 += a3;
+
+            v20 = vld1q_s32(v19);
+            vst1q_s32(v19, vaddq_s32(vaddq_s32(v20, v24), vshlq_n_s32(v26, 1)));
+            v19 += a3;
+
+            v22 = vld1q_s32(v19);
+            vst1q_s32(v19, vsubq_s32(vsubq_s32(vshlq_n_s32(v20, 1), v26), v22));
+            v19 += a3;
+        }
+
+        int16x4x2_t next;
+        next.val[0] = vmovn_s32(v20);
+        next.val[1] = vmovn_s32(v22);
+        vst2_s16((short*)(a1 + 4 * processed), next);
+    }
+#endif
+
+    return processed;
+}
+
+// Vectorized version of the general case of `untransform_subband`. Returns
+// number of processed columns, remaining ones are left for scalar code.
+static int untransform_subband_columns(unsigned char* a1, unsigned char* a2, int a3, int a4)
+{
+    int processed = 0;
+
+#if defined(SOUND_DECODER_SSE2)
+    for (; processed + 4 <= a3; processed += 4) {
+        // Deinterleave (v15, v16) pairs of four columns.
+        __m128i lo = _mm_loadu_si128((__m128i*)((int*)a1 + 2 * processed));
+        __m128i hi = _mm_loadu_si128((__m128i*)((int*)a1 + 2 * processed + 4));
+        __m128i v15 = _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(lo), _mm_castsi128_ps(hi), _MM_SHUFFLE(2, 0, 2, 0)));
+        __m128i v16 = _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(lo), _mm_castsi128_ps(hi), _MM_SHUFFLE(3, 1, 3, 1)));
+
+        int* v14 = (int*)a2 + processed;
+        for (int v13 = a4 >> 2; v13 != 0; v13--) {
+            __m128i v17 = _mm_loadu_si128((__m128i*)v14);
+            _mm_storeu_si128((__m128i*)v14, _mm_add_epi32(_mm_add_epi32(v17, v15), _mm_slli_epi32(v16, 1)));
+            v14 += a3;
+
+            __m128i v19 = _mm_loadu_si128((__m128i*)v14);
+            _mm_storeu_si128((__m128i*)v14, _mm_sub_epi32(_mm_sub_epi32(_mm_slli_epi32(v17, 1), v16), v19));
+            v14 += a3;
+
+            v15 = _mm_loadu_si128((__m128i*)v14);
+            _mm_storeu_si128((__m128i*)v14, _mm_add_epi32(_mm_add_epi32(v15, v17), _mm_slli_epi32(v19, 1)));
+            v14 += a3;
+
+            v16 = _mm_loadu_si128((__m128i*)v14);
+            _mm_storeu_si128((__m128i*)v14, _mm_sub_epi32(_mm_sub_epi32(_mm_slli_epi32(v15, 1), v19), v16));
+            v14 += a3;
+        }
+
+        _mm_storeu_si128((__m128i*)((int*)a1 + 2 * processed), _mm_unpacklo_epi32(v15, v16));
+        _mm_storeu_si128((__m128i*)((int*)a1 + 2 * processed + 4), _mm_unpackhi_epi32(v15, v16));
+    }
+#elif defined(SOUND_DECODER_NEON)
+    for (; processed + 4 <= a3; processed += 4) {
+        int32x4x2_t prev = vld2q_s32((int*)a1 + 2 * processed);
+        int32x4_t v15 = prev.val[0];
+        int32x4_t v16 = prev.val[1];
+
+        int* v14 = (int*)a2 + processed;
+        for (int v13 = a4 >> 2; v13 != 0; v13--) {
+            int32x4_t v17 = vld1q_s32(v14);
+            vst1q_s32(v14, vaddq_s32(vaddq_s32(v17, v15), vshlq_n_s32(v16, 1)));
+            v14 += a3;
+
+            int32x4_t v19 = vld1q_s32(v14);
+            vst1q_s32(v14, vsubq_s32(vsubq_s32(vshlq_n_s32(v17, 1), v16), v19));
+            v14 += a3;
+
+            v15 = vld1q_s32(v14);
+            vst1q_s32(v14, vaddq_s32(vaddq_s32(v15, v17), vshlq_n_s32(v19, 1)));
+            v14 += a3;
+
+            v16 = vld1q_s32(v14);
+            vst1q_s32(v14, vsubq_s32(vsubq_s32(vshlq_n_s32(v15, 1), v19), v16));
+            v14 += a3;
+        }
+
+        int32x4x2_t next;
+        next.val[0] = v15;
+        next.val[1] = v16;
+        vst2q_s32((int*)a1 + 2 * processed, next);
+    }
+#endif
+
+    return processed;
+}
+
+// Converts decoded samples to 16-bit (truncating, not saturating).
+static void soundDecoderPackSamples(const int* src, unsigned short* dest, int count, int shift)
+{
+    int index = 0;
+
+#if defined(SOUND_DECODER_SSE2)
+    __m128i count128 = _mm_cvtsi32_si128(shift);
+    for (; index + 8 <= count; index += 8) {
+        __m128i lo = _mm_sra_epi32(_mm_loadu_si128((const __m128i*)(src + index)), count128);
+        __m128i hi = _mm_sra_epi32(_mm_loadu_si128((const __m128i*)(src + index + 4)), count128);
+
+        // Sign extend lower halves so saturating pack keeps them intact.
+        lo = _mm_srai_epi32(_mm_slli_epi32(lo, 16), 16);
+        hi = _mm_srai_epi32(_mm_slli_epi32(hi, 16), 16);
+        _mm_storeu_si128((__m128i*)(dest + index), _mm_packs_epi32(lo, hi));
+    }
+#elif defined(SOUND_DECODER_NEON)
+    int32x4_t shift128 = vdupq_n_s32(-shift);
+    for (; index + 8 <= count; index += 8) {
+        int32x4_t lo = vshlq_s32(vld1q_s32(src + index), shift128);
+        int32x4_t hi = vshlq_s32(vld1q_s32(src + index + 4), shift128);
+        vst1q_u16(dest + index, vcombine_u16(vmovn_u32(vreinterpretq_u32_s32(lo)), vmovn_u32(vreinterpretq_u32_s32(hi))));
+    }
+#endif
+
+    for (; index < count; index++) {
+        dest[index] = (src[index] >> shift) & 0xFFFF;
+    }
+}
+
 // 0x4D4E80
 static void untransform_all(SoundDecoder* soundDecoder)
 {
@@ -1074,6 +1278,8 @@ static bool soundDecoderFill(SoundDecoder* soundDecoder)
 // 0x4D4FA0
 size_t soundDecoderDecode(SoundDecoder* soundDecoder, void* buffer, size_t size)
 {
+    std::lock_guard<std::recursive_mutex> lock(gSoundDecodersMutex);
+
     unsigned char* dest;
     unsigned char* samp_ptr;
     int samp_cnt;
@@ -1082,8 +1288,8 @@ size_t soundDecoderDecode(SoundDecoder* soundDecoder, void* buffer, size_t size)
     samp_ptr = soundDecoder->samp_ptr;
     samp_cnt = soundDecoder->samp_cnt;
 
-    size_t bytesRead;
-    for (bytesRead = 0; bytesRead < size; bytesRead += 2) {
+    size_t bytesRead = 0;
+    while (bytesRead < size) {
         if (samp_cnt == 0) {
             if (soundDecoder->file_cnt == 0) {
                 break;
@@ -1098,10 +1304,18 @@ size_t soundDecoderDecode(SoundDecoder* soundDecoder, void* buffer, size_t size)
             samp_cnt = soundDecoder->samp_cnt;
         }
 
-        int sample = *(int*)samp_ptr;
-        samp_ptr += 4;
-        *(unsigned short*)(dest + bytesRead) = (sample >> soundDecoder->levels) & 0xFFFF;
-        samp_cnt--;
+        // CE: Convert samples in runs instead of one by one. Odd `size` is
+        // rounded up the same way original loop did.
+        size_t samplesToCopy = (size - bytesRead + 1) / 2;
+        if (samplesToCopy > (size_t)samp_cnt) {
+            samplesToCopy = samp_cnt;
+        }
+
+        soundDecoderPackSamples((int*)samp_ptr, (unsigned short*)(dest + bytesRead), (int)samplesToCopy, soundDecoder->levels);
+
+        samp_ptr += 4 * samplesToCopy;
+        samp_cnt -= (int)samplesToCopy;
+        bytesRead += 2 * samplesToCopy;
     }
 
     soundDecoder->samp_ptr = samp_ptr;
@@ -1113,6 +1327,8 @@ size_t soundDecoderDecode(SoundDecoder* soundDecoder, void* buffer, size_t size)
 // 0x4D5048
 void soundDecoderFree(SoundDecoder* soundDecoder)
 {
+    std::lock_guard<std::recursive_mutex> lock(gSoundDecodersMutex);
+
     if (soundDecoder->bufferIn != nullptr) {
         free(soundDecoder->bufferIn);
     }
@@ -1140,6 +1356,8 @@ void soundDecoderFree(SoundDecoder* soundDecoder)
 // 0x4D50A8
 SoundDecoder* soundDecoderInit(SoundDecoderReadProc* readProc, void* data, int* channelsPtr, int* sampleRatePtr, int* sampleCountPtr)
 {
+    std::lock_guard<std::recursive_mutex> lock(gSoundDecodersMutex);
+
     int v14;
     int v20;
     int v73;
@@ -1172,7 +1390,8 @@ SoundDecoder* soundDecoderInit(SoundDecoderReadProc* readProc, void* data, int*
     v20 = soundDecoder->hold;
     soundDecoderDropBits(soundDecoder, 8);
 
-    if (v20 != 1) {
+    // CE: Mask version byte, accumulator can hold more bits than requested.
+    if ((v20 & 0xFF) != 1) {
         goto L66;
     }
 
@@ -1255,6 +1474,15 @@ L66:
 
 static inline void soundDecoderRequireBits(SoundDecoder* soundDecoder, int bits)
 {
+    // CE: Take two bytes at once when they are available in input buffer.
+    // The accumulator never exceeds 31 bits so it stays non-negative.
+    if (soundDecoder->bits < bits && soundDecoder->bits <= 8 && soundDecoder->remainingInSize >= 2) {
+        soundDecoder->hold |= (soundDecoder->nextIn[0] | (soundDecoder->nextIn[1] << 8)) << soundDecoder->bits;
+        soundDecoder->nextIn += 2;
+        soundDecoder->remainingInSize -= 2;
+        soundDecoder->bits += 16;
+    }
+
     while (soundDecoder->bits < bits) {
         soundDecoder->remainingInSize--;
 
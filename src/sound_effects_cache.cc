@@ -6,8 +6,11 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <unordered_set>
+
 #include "cache.h"
 #include "db.h"
+#include "debug.h"
 #include "memory.h"
 #include "settings.h"
 #include "sound_decoder.h"
@@ -17,6 +20,10 @@ namespace fallout {
 
 #define SOUND_EFFECTS_CACHE_MIN_SIZE (0x40000)
 
+// CE: Only effects which take no more than this fraction of decoded cache
+// budget are kept decoded, long effects are decoded on every read as usual.
+#define SOUND_EFFECTS_PCM_CACHE_MAX_ENTRY_FRACTION (8)
+
 typedef struct SoundEffect {
     // NOTE: This field is only 1 byte, likely unsigned char. It always uses
     // cmp for checking implying it's not bitwise flags. Therefore it's better
@@ -30,8 +37,19 @@ typedef struct SoundEffect {
     int position;
     int dataPosition;
     unsigned char* data;
+
+    // CE: Cache `cacheHandle` belongs to. Either compressed effects cache or
+    // decoded effects cache (in which case `data` is already decoded).
+    Cache* cache;
 } SoundEffect;
 
+// CE: Source of compressed data when decoding effect into decoded cache.
+typedef struct SoundEffectsCacheDecodeSource {
+    unsigned char* data;
+    int size;
+    int position;
+} SoundEffectsCacheDecodeSource;
+
 static int soundEffectsCacheGetFileSizeImpl(int tag, int* sizePtr);
 static int soundEffectsCacheReadDataImpl(int tag, int* sizePtr, unsigned char* data);
 static void soundEffectsCacheFreeImpl(void* ptr);
@@ -41,6 +59,12 @@ static int soundEffectsCreate(int* handlePtr, int id, void* data, CacheEntry* ca
 static bool soundEffectsIsValidHandle(int a1);
 static int soundEffectsCacheFileReadCompressed(int handle, void* buf, unsigned int size);
 static int soundEffectsCacheSoundDecoderReadHandler(void* data, void* buf, unsigned int size);
+static bool soundEffectsCachePcmInit();
+static void soundEffectsCachePcmExit();
+static bool soundEffectsCachePcmIsEligible(int tag);
+static int soundEffectsCachePcmGetSizeImpl(int tag, int* sizePtr);
+static int soundEffectsCachePcmReadDataImpl(int tag, int* sizePtr, unsigned char* data);
+static int soundEffectsCachePcmSoundDecoderReadHandler(void* data, void* buf, unsigned int size);
 
 // 0x50DE04
 static const char* off_50DE04 = "";
@@ -69,6 +93,24 @@ static SoundEffect* gSoundEffects = nullptr;
 // 0x51C8E8
 static int _sfxc_files_open = 0;
 
+// CE: Second level cache of fully decoded effects. Frequently played short
+// effects (gunfire, footsteps) are decoded once instead of on every read.
+static Cache* gSoundEffectsPcmCache = nullptr;
+
+// CE: Maximum decoded size of effect eligible for decoded cache.
+static int gSoundEffectsPcmCacheMaxEntrySize = 0;
+
+// CE: Number of effect opens served from decoded cache.
+static unsigned int gSoundEffectsPcmCacheHits = 0;
+
+// CE: Number of effects decoded into decoded cache.
+static unsigned int gSoundEffectsPcmCacheMisses = 0;
+
+// CE: Tags of effects which failed to decode into decoded cache. They are
+// always read through compressed cache instead of being decoded again on
+// every open.
+static std::unordered_set<int> gSoundEffectsPcmCacheFailedTags;
+
 // sfxc_init
 // 0x4A8FC0
 int soundEffectsCacheInit(int cacheSize, const char* effectsPath)
@@ -115,6 +157,9 @@ int soundEffectsCacheInit(int cacheSize, const char* effectsPath)
         return -1;
     }
 
+    // CE: Decoded cache is optional, sound effects work without it.
+    soundEffectsCachePcmInit();
+
     gSoundEffectsCacheInitialized = true;
 
     return 0;
@@ -124,6 +169,13 @@ int soundEffectsCacheInit(int cacheSize, const char* effectsPath)
 void soundEffectsCacheExit()
 {
     if (gSoundEffectsCacheInitialized) {
+        char stats[200];
+        if (soundEffectsCachePrintStats(stats, sizeof(stats))) {
+            debugPrint("%s", stats);
+        }
+
+        soundEffectsCachePcmExit();
+
         cacheFree(gSoundEffectsCache);
         internal_free(gSoundEffectsCache);
         gSoundEffectsCache = nullptr;
@@ -148,6 +200,10 @@ int soundEffectsCacheInitialized()
 void soundEffectsCacheFlush()
 {
     if (gSoundEffectsCacheInitialized) {
+        if (gSoundEffectsPcmCache != nullptr) {
+            cacheFlush(gSoundEffectsPcmCache);
+        }
+
         cacheFlush(gSoundEffectsCache);
     }
 }
@@ -174,18 +230,35 @@ int soundEffectsCacheFileOpen(const char* fname, int* sampleRate)
         return -1;
     }
 
+    Cache* cache = gSoundEffectsCache;
     void* data;
     CacheEntry* cacheHandle;
-    if (!cacheLock(gSoundEffectsCache, tag, &data, &cacheHandle)) {
-        return -1;
+
+    // CE: Prefer already decoded effect.
+    if (soundEffectsCachePcmIsEligible(tag)) {
+        unsigned int misses = gSoundEffectsPcmCacheMisses;
+        if (cacheLock(gSoundEffectsPcmCache, tag, &data, &cacheHandle)) {
+            cache = gSoundEffectsPcmCache;
+            if (misses == gSoundEffectsPcmCacheMisses) {
+                gSoundEffectsPcmCacheHits++;
+            }
+        }
+    }
+
+    if (cache == gSoundEffectsCache) {
+        if (!cacheLock(gSoundEffectsCache, tag, &data, &cacheHandle)) {
+            return -1;
+        }
     }
 
     int handle;
     if (soundEffectsCreate(&handle, tag, data, cacheHandle) != 0) {
-        cacheUnlock(gSoundEffectsCache, cacheHandle);
+        cacheUnlock(cache, cacheHandle);
         return -1;
     }
 
+    gSoundEffects[handle].cache = cache;
+
     return handle;
 }
 
@@ -198,7 +271,7 @@ int soundEffectsCacheFileClose(int handle)
     }
 
     SoundEffect* soundEffect = &(gSoundEffects[handle]);
-    if (!cacheUnlock(gSoundEffectsCache, soundEffect->cacheHandle)) {
+    if (!cacheUnlock(soundEffect->cache, soundEffect->cacheHandle)) {
         return -1;
     }
 
@@ -237,7 +310,10 @@ int soundEffectsCacheFileRead(int handle, void* buf, unsigned int size)
         bytesToRead = soundEffect->dataSize - soundEffect->position;
     }
 
-    switch (_sfxc_cmpr) {
+    // CE: Decoded effects are read the same way as uncompressed ones.
+    int cmpr = soundEffect->cache == gSoundEffectsPcmCache ? 0 : _sfxc_cmpr;
+
+    switch (cmpr) {
     case 0:
         memcpy(buf, soundEffect->data + soundEffect->position, bytesToRead);
         break;
@@ -437,6 +513,7 @@ static int soundEffectsCreate(int* handlePtr, int tag, void* data, CacheEntry* c
     soundEffect->dataPosition = 0;
 
     soundEffect->data = (unsigned char*)data;
+    soundEffect->cache = gSoundEffectsCache;
 
     *handlePtr = index;
 
@@ -526,4 +603,169 @@ static int soundEffectsCacheSoundDecoderReadHandler(void* data, void* buf, unsig
     return bytesToRead;
 }
 
+// Prints hit rate of decoded effects cache.
+bool soundEffectsCachePrintStats(char* dest, size_t size)
+{
+    if (dest == nullptr) {
+        return false;
+    }
+
+    if (gSoundEffectsPcmCache == nullptr) {
+        snprintf(dest, size, "Sound effects PCM cache is disabled.\n");
+        return true;
+    }
+
+    unsigned int lookups = gSoundEffectsPcmCacheHits + gSoundEffectsPcmCacheMisses;
+    snprintf(dest,
+        size,
+        "Sound effects PCM cache: %u hits, %u misses (%u%% hit rate), %d of %d bytes used.\n",
+        gSoundEffectsPcmCacheHits,
+        gSoundEffectsPcmCacheMisses,
+        lookups != 0 ? (unsigned int)((unsigned long long)gSoundEffectsPcmCacheHits * 100 / lookups) : 0,
+        gSoundEffectsPcmCache->size,
+        gSoundEffectsPcmCache->maxSize);
+
+    return true;
+}
+
+static bool soundEffectsCachePcmInit()
+{
+    gSoundEffectsPcmCacheHits = 0;
+    gSoundEffectsPcmCacheMisses = 0;
+    gSoundEffectsPcmCacheFailedTags.clear();
+
+    // Decoded cache only makes sense when effects are compressed.
+    if (_sfxc_cmpr != 1) {
+        return false;
+    }
+
+    int cacheSize = settings.sound.pcm_cache_size;
+    if (cacheSize <= 0 || cacheSize > INT_MAX >> 10) {
+        return false;
+    }
+
+    cacheSize <<= 10;
+
+    gSoundEffectsPcmCache = (Cache*)internal_malloc(sizeof(*gSoundEffectsPcmCache));
+    if (gSoundEffectsPcmCache == nullptr) {
+        return false;
+    }
+
+    if (!cacheInit(gSoundEffectsPcmCache, soundEffectsCachePcmGetSizeImpl, soundEffectsCachePcmReadDataImpl, soundEffectsCacheFreeImpl, cacheSize)) {
+        internal_free(gSoundEffectsPcmCache);
+        gSoundEffectsPcmCache = nullptr;
+        return false;
+    }
+
+    gSoundEffectsPcmCacheMaxEntrySize = cacheSize / SOUND_EFFECTS_PCM_CACHE_MAX_ENTRY_FRACTION;
+
+    return true;
+}
+
+static void soundEffectsCachePcmExit()
+{
+    if (gSoundEffectsPcmCache != nullptr) {
+        cacheFree(gSoundEffectsPcmCache);
+        internal_free(gSoundEffectsPcmCache);
+        gSoundEffectsPcmCache = nullptr;
+    }
+
+    gSoundEffectsPcmCacheFailedTags.clear();
+}
+
+static bool soundEffectsCachePcmIsEligible(int tag)
+{
+    if (gSoundEffectsPcmCache == nullptr) {
+        return false;
+    }
+
+    if (gSoundEffectsPcmCacheFailedTags.find(tag) != gSoundEffectsPcmCacheFailedTags.end()) {
+        return false;
+    }
+
+    int size;
+    if (soundEffectsListGetDataSize(tag, &size) != SFXL_OK) {
+        return false;
+    }
+
+    return size > 0 && size <= gSoundEffectsPcmCacheMaxEntrySize;
+}
+
+static int soundEffectsCachePcmGetSizeImpl(int tag, int* sizePtr)
+{
+    int size;
+    if (soundEffectsListGetDataSize(tag, &size) != SFXL_OK) {
+        return -1;
+    }
+
+    *sizePtr = size;
+
+    return 0;
+}
+
+// Decodes entire effect taking compressed data from compressed effects cache.
+static int soundEffectsCachePcmReadDataImpl(int tag, int* sizePtr, unsigned char* data)
+{
+    int dataSize;
+    if (soundEffectsListGetDataSize(tag, &dataSize) != SFXL_OK) {
+        return -1;
+    }
+
+    SoundEffectsCacheDecodeSource source;
+    if (soundEffectsListGetFileSize(tag, &(source.size)) != SFXL_OK) {
+        return -1;
+    }
+
+    void* compressedData;
+    CacheEntry* cacheHandle;
+    if (!cacheLock(gSoundEffectsCache, tag, &compressedData, &cacheHandle)) {
+        return -1;
+    }
+
+    source.data = (unsigned char*)compressedData;
+    source.position = 0;
+
+    int channels;
+    int sampleRate;
+    int sampleCount;
+    SoundDecoder* soundDecoder = soundDecoderInit(soundEffectsCachePcmSoundDecoderReadHandler, &source, &channels, &sampleRate, &sampleCount);
+    if (soundDecoder == nullptr) {
+        cacheUnlock(gSoundEffectsCache, cacheHandle);
+        gSoundEffectsPcmCacheFailedTags.insert(tag);
+        return -1;
+    }
+
+    size_t bytesRead = soundDecoderDecode(soundDecoder, data, dataSize);
+    soundDecoderFree(soundDecoder);
+
+    cacheUnlock(gSoundEffectsCache, cacheHandle);
+
+    if (bytesRead != static_cast<size_t>(dataSize)) {
+        gSoundEffectsPcmCacheFailedTags.insert(tag);
+        return -1;
+    }
+
+    gSoundEffectsPcmCacheMisses++;
+
+    *sizePtr = dataSize;
+
+    return 0;
+}
+
+static int soundEffectsCachePcmSoundDecoderReadHandler(void* data, void* buf, unsigned int size)
+{
+    SoundEffectsCacheDecodeSource* source = reinterpret_cast<SoundEffectsCacheDecodeSource*>(data);
+
+    unsigned int bytesToRead = source->size - source->position;
+    if (size <= bytesToRead) {
+        bytesToRead = size;
+    }
+
+    memcpy(buf, source->data + source->position, bytesToRead);
+
+    source->position += bytesToRead;
+
+    return bytesToRead;
+}
+
 } // namespace fallout
@@ -1,6 +1,8 @@
 #ifndef SOUND_EFFECTS_CACHE_H
 #define SOUND_EFFECTS_CACHE_H
 
+#include <stddef.h>
+
 namespace fallout {
 
 // The maximum number of sound effects that can be loaded and played
@@ -18,6 +20,7 @@ int soundEffectsCacheFileWrite(int handle, const void* buf, unsigned int size);
 long soundEffectsCacheFileSeek(int handle, long offset, int origin);
 long soundEffectsCacheFileTell(int handle);
 long soundEffectsCacheFileLength(int handle);
+bool soundEffectsCachePrintStats(char* dest, size_t size);
 
 } // namespace fallout
 
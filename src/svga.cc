@@ -3,13 +3,17 @@
 #include <limits.h>
 #include <string.h>
 
+#include <algorithm>
+
 #include <SDL.h>
 
 #include "config.h"
+#include "debug.h"
 #include "draw.h"
 #include "interface.h"
 #include "memory.h"
 #include "mouse.h"
+#include "palette_expand.h"
 #include "win32.h"
 #include "window_manager.h"
 #include "window_manager_private.h"
@@ -18,6 +22,8 @@ namespace fallout {
 
 static bool createRenderer(int width, int height);
 static void destroyRenderer();
+static void texturePaletteUpdate(int start, int count);
+static void textureMarkDirty(int x, int y, int width, int height);
 
 // screen rect
 Rect _scr_size;
@@ -32,7 +38,18 @@ SDL_Window* gSdlWindow = nullptr;
 SDL_Surface* gSdlSurface = nullptr;
 SDL_Renderer* gSdlRenderer = nullptr;
 SDL_Texture* gSdlTexture = nullptr;
-SDL_Surface* gSdlTextureSurface = nullptr;
+
+// Pixel format of `gSdlTexture` (always 4 bytes per pixel).
+static SDL_PixelFormat* gSdlTextureFormat = nullptr;
+
+// Palette of `gSdlSurface` mapped to `gSdlTextureFormat`.
+static PaletteExpandTable gSdlTexturePalette;
+
+// Area of `gSdlSurface` which was changed since last `renderPresent`.
+static SDL_Rect gSdlTextureDirtyRect;
+static bool gSdlTextureDirty = false;
+
+static PaletteExpandProc* gPaletteExpandProc = nullptr;
 
 // TODO: Remove once migration to update-render cycle is completed.
 FpsLimiter sharedFpsLimiter;
@@ -226,6 +243,8 @@ int directDrawInit(int width, int height, int bpp)
     }
 
     SDL_SetPaletteColors(gSdlSurface->format->palette, colors, 0, 256);
+    texturePaletteUpdate(0, 256);
+    textureMarkDirty(0, 0, width, height);
 
     return 0;
 }
@@ -255,7 +274,8 @@ void directDrawSetPaletteInRange(unsigned char* palette, int start, int count)
         }
 
         SDL_SetPaletteColors(gSdlSurface->format->palette, colors, start, count);
-        SDL_BlitSurface(gSdlSurface, nullptr, gSdlTextureSurface, nullptr);
+        texturePaletteUpdate(start, count);
+        textureMarkDirty(0, 0, gSdlSurface->w, gSdlSurface->h);
     }
 }
 
@@ -273,7 +293,8 @@ void directDrawSetPalette(unsigned char* palette)
         }
 
         SDL_SetPaletteColors(gSdlSurface->format->palette, colors, 0, 256);
-        SDL_BlitSurface(gSdlSurface, nullptr, gSdlTextureSurface, nullptr);
+        texturePaletteUpdate(0, 256);
+        textureMarkDirty(0, 0, gSdlSurface->w, gSdlSurface->h);
     }
 }
 
@@ -302,16 +323,8 @@ void _GNW95_ShowRect(unsigned char* src, int srcPitch, int a3, int srcX, int src
 {
     blitBufferToBuffer(src + srcPitch * srcY + srcX, srcWidth, srcHeight, srcPitch, (unsigned char*)gSdlSurface->pixels + gSdlSurface->pitch * destY + destX, gSdlSurface->pitch);
 
-    SDL_Rect srcRect;
-    srcRect.x = destX;
-    srcRect.y = destY;
-    srcRect.w = srcWidth;
-    srcRect.h = srcHeight;
-
-    SDL_Rect destRect;
-    destRect.x = destX;
-    destRect.y = destY;
-    SDL_BlitSurface(gSdlSurface, &srcRect, gSdlTextureSurface, &destRect);
+    // CE: Texture is updated from 8-bit surface in `renderPresent`.
+    textureMarkDirty(destX, destY, srcWidth, srcHeight);
 }
 
 // Clears drawing surface.
@@ -329,7 +342,7 @@ void _GNW95_zero_vid_mem()
         surface += gSdlSurface->pitch;
     }
 
-    SDL_BlitSurface(gSdlSurface, nullptr, gSdlTextureSurface, nullptr);
+    textureMarkDirty(0, 0, gSdlSurface->w, gSdlSurface->h);
 }
 
 int screenGetWidth()
@@ -375,19 +388,37 @@ static bool createRenderer(int width, int height)
         return false;
     }
 
-    gSdlTextureSurface = SDL_CreateRGBSurfaceWithFormat(0, width, height, SDL_BITSPERPIXEL(format), format);
-    if (gSdlTextureSurface == nullptr) {
+    // CE: Texture is updated directly from 8-bit surface using palette
+    // expanded into texture format, which requires 4 bytes per pixel (note
+    // that `SDL_PIXELFORMAT_RGB888` has 24 bits per pixel stored in 32).
+    if (SDL_BYTESPERPIXEL(format) != 4) {
         return false;
     }
 
+    gSdlTextureFormat = SDL_AllocFormat(format);
+    if (gSdlTextureFormat == nullptr) {
+        return false;
+    }
+
+    if (gPaletteExpandProc == nullptr) {
+        gPaletteExpandProc = paletteExpandGetProc();
+    }
+
+    // New texture has undefined contents, refresh palette (which depends on
+    // texture format) and entire screen.
+    if (gSdlSurface != nullptr) {
+        texturePaletteUpdate(0, 256);
+        textureMarkDirty(0, 0, gSdlSurface->w, gSdlSurface->h);
+    }
+
     return true;
 }
 
 static void destroyRenderer()
 {
-    if (gSdlTextureSurface != nullptr) {
-        SDL_FreeSurface(gSdlTextureSurface);
-        gSdlTextureSurface = nullptr;
+    if (gSdlTextureFormat != nullptr) {
+        SDL_FreeFormat(gSdlTextureFormat);
+        gSdlTextureFormat = nullptr;
     }
 
     if (gSdlTexture != nullptr) {
@@ -404,15 +435,87 @@ static void destroyRenderer()
 void handleWindowSizeChanged()
 {
     destroyRenderer();
-    createRenderer(screenGetWidth(), screenGetHeight());
+
+    // CE: Leave no partially created renderer behind, `renderPresent` skips
+    // presenting until renderer is created on the next window size change.
+    if (!createRenderer(screenGetWidth(), screenGetHeight())) {
+        debugPrint("handleWindowSizeChanged: failed to create renderer: %s\n", SDL_GetError());
+        destroyRenderer();
+    }
 }
 
 void renderPresent()
 {
-    SDL_UpdateTexture(gSdlTexture, nullptr, gSdlTextureSurface->pixels, gSdlTextureSurface->pitch);
+    if (gSdlRenderer == nullptr || gSdlTexture == nullptr) {
+        return;
+    }
+
+    // CE: Expand changed area of 8-bit surface directly into streaming
+    // texture.
+    if (gSdlTextureDirty) {
+        void* pixels;
+        int pitch;
+        if (SDL_LockTexture(gSdlTexture, &gSdlTextureDirtyRect, &pixels, &pitch) == 0) {
+            gPaletteExpandProc(&gSdlTexturePalette,
+                (unsigned char*)gSdlSurface->pixels + gSdlSurface->pitch * gSdlTextureDirtyRect.y + gSdlTextureDirtyRect.x,
+                gSdlSurface->pitch,
+                (unsigned char*)pixels,
+                pitch,
+                gSdlTextureDirtyRect.w,
+                gSdlTextureDirtyRect.h);
+            SDL_UnlockTexture(gSdlTexture);
+        }
+
+        gSdlTextureDirty = false;
+    }
+
     SDL_RenderClear(gSdlRenderer);
     SDL_RenderCopy(gSdlRenderer, gSdlTexture, nullptr, nullptr);
     SDL_RenderPresent(gSdlRenderer);
 }
 
+static void texturePaletteUpdate(int start, int count)
+{
+    if (gSdlSurface == nullptr || gSdlSurface->format->palette == nullptr || gSdlTextureFormat == nullptr) {
+        return;
+    }
+
+    SDL_Color* colors = gSdlSurface->format->palette->colors;
+    for (int index = start; index < start + count; index++) {
+        Uint32 color = SDL_MapRGB(gSdlTextureFormat, colors[index].r, colors[index].g, colors[index].b);
+        paletteExpandTableSetColor(&gSdlTexturePalette, index, color);
+    }
+}
+
+static void textureMarkDirty(int x, int y, int width, int height)
+{
+    if (gSdlSurface == nullptr) {
+        return;
+    }
+
+    Rect rect;
+    rect.left = std::max(x, 0);
+    rect.top = std::max(y, 0);
+    rect.right = std::min(x + width, gSdlSurface->w) - 1;
+    rect.bottom = std::min(y + height, gSdlSurface->h) - 1;
+    if (rect.right < rect.left || rect.bottom < rect.top) {
+        return;
+    }
+
+    if (gSdlTextureDirty) {
+        Rect dirtyRect;
+        dirtyRect.left = gSdlTextureDirtyRect.x;
+        dirtyRect.top = gSdlTextureDirtyRect.y;
+        dirtyRect.right = gSdlTextureDirtyRect.x + gSdlTextureDirtyRect.w - 1;
+        dirtyRect.bottom = gSdlTextureDirtyRect.y + gSdlTextureDirtyRect.h - 1;
+        rectUnion(&rect, &dirtyRect, &rect);
+    }
+
+    gSdlTextureDirtyRect.x = rect.left;
+    gSdlTextureDirtyRect.y = rect.top;
+    gSdlTextureDirtyRect.w = rectGetWidth(&rect);
+    gSdlTextureDirtyRect.h = rectGetHeight(&rect);
+    gSdlTextureDirty = true;
+}
+
 } // namespace fallout
@@ -16,7 +16,6 @@ extern SDL_Window* gSdlWindow;
 extern SDL_Surface* gSdlSurface;
 extern SDL_Renderer* gSdlRenderer;
 extern SDL_Texture* gSdlTexture;
-extern SDL_Surface* gSdlTextureSurface;
 extern FpsLimiter sharedFpsLimiter;
 
 int _init_mode_320_200();
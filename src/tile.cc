@@ -58,6 +58,7 @@ struct roof_fill_task {
 static void tileSetBorder(int windowWidth, int windowHeight, int hexGridWidth, int hexGridHeight);
 static void tileRefreshMapper(Rect* rect, int elevation);
 static void tileRefreshGame(Rect* rect, int elevation);
+static void tileWindowScroll(int dx, int dy);
 static void roof_fill_push_task_if_in_bounds(std::stack<roof_fill_task>& tasks_stack, int x, int y);
 static void roof_fill_off_process_task(std::stack<roof_fill_task>& tasks_stack, int elevation, bool on);
 static void tileRenderRoof(int fid, int x, int y, Rect* rect, int light);
@@ -89,6 +90,13 @@ static TileWindowRefreshElevationProc* gTileWindowRefreshElevationProc = tileRef
 // 0x51D968
 static bool gTileEnabled = true;
 
+// CE: Denotes tile window buffer holds complete image of `gTileWindowElevation`
+// for current center (i.e. it's safe to shift it when scrolling).
+static bool gTileWindowValid = false;
+
+// CE: Elevation the tile window buffer was last fully rendered at.
+static int gTileWindowElevation = -1;
+
 // 0x51D96C
 const int _off_tile[6] = {
     16,
@@ -507,6 +515,10 @@ void tileExit()
 void tileDisable()
 {
     gTileEnabled = false;
+
+    // CE: Refreshes are ignored while tile is disabled so buffer contents can
+    // no longer be reused for scrolling.
+    gTileWindowValid = false;
 }
 
 // 0x4B12B4
@@ -530,9 +542,98 @@ void tileWindowRefresh()
 {
     if (gTileEnabled) {
         gTileWindowRefreshElevationProc(&gTileWindowRect, gElevation);
+        gTileWindowValid = true;
+        gTileWindowElevation = gElevation;
     }
 }
 
+// CE: Moves tile window contents by `dx`, `dy` (in screen pixels) and renders
+// only exposed strips. Falls back to full refresh when contents cannot be
+// reused.
+static void tileWindowScroll(int dx, int dy)
+{
+    if (!gTileEnabled) {
+        return;
+    }
+
+    int width = rectGetWidth(&gTileWindowRect);
+    int height = rectGetHeight(&gTileWindowRect);
+
+    if (!gTileWindowValid
+        || gTileWindowElevation != gElevation
+        || abs(dx) >= width
+        || abs(dy) >= height) {
+        // NOTE: Uninline.
+        tileWindowRefresh();
+        return;
+    }
+
+    if (dx == 0 && dy == 0) {
+        return;
+    }
+
+    int copyWidth = width - abs(dx);
+    int copyHeight = height - abs(dy);
+
+    unsigned char* src = gTileWindowBuffer + gTileWindowPitch * std::max(-dy, 0) + std::max(-dx, 0);
+    unsigned char* dest = gTileWindowBuffer + gTileWindowPitch * std::max(dy, 0) + std::max(dx, 0);
+    int step = gTileWindowPitch;
+
+    // When moving down destination rows are below source rows, copy them
+    // bottom-up to avoid overwriting rows not yet moved.
+    if (dy > 0) {
+        src += gTileWindowPitch * (copyHeight - 1);
+        dest += gTileWindowPitch * (copyHeight - 1);
+        step = -gTileWindowPitch;
+    }
+
+    for (int y = 0; y < copyHeight; y++) {
+        memmove(dest, src, copyWidth);
+        src += step;
+        dest += step;
+    }
+
+    // Horizontal strip exposed at the top or bottom edge.
+    Rect rowsRect = gTileWindowRect;
+    if (dy > 0) {
+        rowsRect.bottom = rowsRect.top + dy - 1;
+    } else if (dy < 0) {
+        rowsRect.top = rowsRect.bottom + dy + 1;
+    }
+
+    // Vertical strip exposed at the left or right edge, excluding rows
+    // already covered by horizontal strip.
+    Rect columnsRect = gTileWindowRect;
+    if (dx > 0) {
+        columnsRect.right = columnsRect.left + dx - 1;
+    } else if (dx < 0) {
+        columnsRect.left = columnsRect.right + dx + 1;
+    }
+
+    if (dy > 0) {
+        columnsRect.top += dy;
+    } else if (dy < 0) {
+        columnsRect.bottom += dy;
+    }
+
+    // Exposed strips are rendered and copied to the screen by refresh proc,
+    // only shifted contents are left to be copied.
+    if (dy != 0) {
+        gTileWindowRefreshElevationProc(&rowsRect, gElevation);
+    }
+
+    if (dx != 0) {
+        gTileWindowRefreshElevationProc(&columnsRect, gElevation);
+    }
+
+    Rect shiftedRect;
+    shiftedRect.left = gTileWindowRect.left + std::max(dx, 0);
+    shiftedRect.top = gTileWindowRect.top + std::max(dy, 0);
+    shiftedRect.right = shiftedRect.left + copyWidth - 1;
+    shiftedRect.bottom = shiftedRect.top + copyHeight - 1;
+    gTileWindowRefreshProc(&shiftedRect);
+}
+
 // 0x4B12F8
 int tileSetCenter(int tile, int flags)
 {
@@ -709,6 +810,19 @@ int tileToScreenXY(int tile, int* screenX, int* screenY, int elevation)
     return 0;
 }
 
+// CE: Returns `true` if hex at `tile` is (at least partially) within tile
+// window.
+bool tileIsOnScreen(int tile)
+{
+    int x;
+    int y;
+    if (tileToScreenXY(tile, &x, &y, gElevation) != 0) {
+        return false;
+    }
+
+    return x > -32 && x < gTileWindowWidth && y > -16 && y < gTileWindowHeight;
+}
+
 // CE: Added optional `ignoreBounds` param to return tile number without
 // validating hex grid bounds. The resulting invalid tile number serves as an
 // origin for calculations using prepared offsets table during objects
@@ -1952,6 +2066,12 @@ int _tile_scroll_to(int tile, int flags)
 
     int oldCenterTile = gCenterTile;
 
+    // CE: Track how far old center moves on screen to scroll window contents
+    // instead of redrawing everything.
+    int oldCenterScreenX;
+    int oldCenterScreenY;
+    tileToScreenXY(oldCenterTile, &oldCenterScreenX, &oldCenterScreenY, gElevation);
+
     int v9[200];
     int count = _tile_make_line(gCenterTile, tile, v9, 200);
     if (count == 0) {
@@ -1974,8 +2094,10 @@ int _tile_scroll_to(int tile, int flags)
     }
 
     if ((flags & 0x02) != 0) {
-        // NOTE: Uninline.
-        tileWindowRefresh();
+        int centerScreenX;
+        int centerScreenY;
+        tileToScreenXY(oldCenterTile, &centerScreenX, &centerScreenY, gElevation);
+        tileWindowScroll(centerScreenX - oldCenterScreenX, centerScreenY - oldCenterScreenY);
     }
 
     return rc;
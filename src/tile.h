@@ -29,6 +29,7 @@ int tileSetCenter(int tile, int flags);
 void tile_toggle_roof(bool refresh);
 int tileRoofIsVisible();
 int tileToScreenXY(int tile, int* x, int* y, int elevation);
+bool tileIsOnScreen(int tile);
 int tileFromScreenXY(int x, int y, int elevation, bool ignoreBounds = false);
 int tileDistanceBetween(int a1, int a2);
 bool tileIsInFrontOf(int tile1, int tile2);
@@ -3,6 +3,7 @@
 #include <string.h>
 
 #include <algorithm>
+#include <vector>
 
 #include <SDL.h>
 
@@ -42,6 +43,7 @@ static int _win_group_check_buttons(int buttonCount, int* btns, int maxChecked,
 static int _button_check_group(Button* button);
 static void _button_draw(Button* button, Window* window, unsigned char* data, bool draw, Rect* bound, bool sound);
 static void _GNW_button_refresh(Window* window, Rect* rect);
+static unsigned char* windowManagerGetBackgroundRow(int width);
 
 // 0x50FA30
 static char _path_patches[] = "";
@@ -109,6 +111,10 @@ static void* _GNW_texture;
 // 0x6ADF40
 static ButtonGroup gButtonGroups[BUTTON_GROUP_LIST_CAPACITY];
 
+// CE: Row of `_bk_color` pixels used to fill background when blitting
+// directly to screen.
+static std::vector<unsigned char> gWindowBackgroundRow;
+
 // 0x4D5C30
 int windowManagerInit(VideoSystemInitProc* videoSystemInitProc, VideoSystemExitProc* videoSystemExitProc, int a3)
 {
@@ -828,6 +834,9 @@ void _GNW_win_refresh(Window* window, Rect* rect, unsigned char* a3)
 
             _win_clip(window, &v26, a3);
 
+            // CE: Join bands produced by clipping to reduce number of blits.
+            rectListMerge(&v26);
+
             if (window->id) {
                 v20 = v26;
                 while (v20) {
@@ -886,35 +895,29 @@ void _GNW_win_refresh(Window* window, Rect* rect, unsigned char* a3)
                     v20 = v20->next;
                 }
             } else {
+                // CE: Fill background directly in destination instead of
+                // allocating temporary buffer for every rect.
                 RectListNode* v16 = v26;
                 while (v16 != nullptr) {
                     int width = v16->rect.right - v16->rect.left + 1;
                     int height = v16->rect.bottom - v16->rect.top + 1;
-                    unsigned char* buf = (unsigned char*)internal_malloc(width * height);
-                    if (buf != nullptr) {
-                        bufferFill(buf, width, height, width, _bk_color);
-                        if (dest_pitch != 0) {
-                            blitBufferToBuffer(
-                                buf,
+                    if (dest_pitch != 0) {
+                        bufferFill(a3 + dest_pitch * (v16->rect.top - rect->top) + v16->rect.left - rect->left,
+                            width,
+                            height,
+                            dest_pitch,
+                            _bk_color);
+                    } else {
+                        if (_buffering) {
+                            bufferFill(_screen_buffer + v16->rect.top * (_scr_size.right - _scr_size.left + 1) + v16->rect.left,
                                 width,
                                 height,
-                                width,
-                                a3 + dest_pitch * (v16->rect.top - rect->top) + v16->rect.left - rect->left,
-                                dest_pitch);
+                                _scr_size.right - _scr_size.left + 1,
+                                _bk_color);
                         } else {
-                            if (_buffering) {
-                                blitBufferToBuffer(buf,
-                                    width,
-                                    height,
-                                    width,
-                                    _screen_buffer + v16->rect.top * (_scr_size.right - _scr_size.left + 1) + v16->rect.left,
-                                    _scr_size.right - _scr_size.left + 1);
-                            } else {
-                                _scr_blit(buf, width, height, 0, 0, width, height, v16->rect.left, v16->rect.top);
-                            }
+                            // Blit single background row with zero pitch.
+                            _scr_blit(windowManagerGetBackgroundRow(width), 0, height, 0, 0, width, height, v16->rect.left, v16->rect.top);
                         }
-
-                        internal_free(buf);
                     }
                     v16 = v16->next;
                 }
@@ -953,6 +956,15 @@ void _GNW_win_refresh(Window* window, Rect* rect, unsigned char* a3)
     }
 }
 
+static unsigned char* windowManagerGetBackgroundRow(int width)
+{
+    if (gWindowBackgroundRow.size() < static_cast<size_t>(width) || gWindowBackgroundRow[0] != static_cast<unsigned char>(_bk_color)) {
+        gWindowBackgroundRow.assign(std::max(gWindowBackgroundRow.size(), static_cast<size_t>(width)), static_cast<unsigned char>(_bk_color));
+    }
+
+    return gWindowBackgroundRow.data();
+}
+
 // 0x4D759C
 void windowRefreshAll(Rect* rect)
 {